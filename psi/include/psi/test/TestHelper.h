@@ -1,38 +1,178 @@
 #pragma once
 
 #include <chrono>
+#include <iomanip>
 #include <iostream>
+#include <source_location>
+#include <sstream>
+
+#include "psi/test/psi_bench.h"
+#include "psi/test/psi_histogram.h"
+#include "psi/test/psi_zone.h"
 
 namespace psi::test {
 
 class TestHelper
 {
 public:
+    /// The N calls run in detail::kNoiseChunks chunks timed separately; chunk means varying by more than
+    /// detail::kDefaultMaxCv mark the result [NOISY].
     static void timeFn(const auto &name, auto &&fn, int N)
+    {
+        const auto zones_before = ZoneProfiler::snapshot();
+        const auto timing = detail::time_in_chunks(fn, static_cast<uint64_t>(std::max(N, 0)), detail::kDefaultMaxCv);
+        printEnvironment(name);
+        std::cout << "[" << name << "] average fn() us: " << std::fixed << std::setprecision(3)
+                  << timing.m_ns_per_call / 1000.0 << detail::format_noise(timing.m_cv, timing.m_noisy) << std::endl;
+        printZones(name, zones_before);
+    }
+
+    static void timeFn_nano(const auto &name, auto &&fn, int N)
+    {
+        const auto zones_before = ZoneProfiler::snapshot();
+        const auto timing = detail::time_in_chunks(fn, static_cast<uint64_t>(std::max(N, 0)), detail::kDefaultMaxCv);
+        printEnvironment(name);
+        std::cout << "[" << name << "] average fn() ns: " << std::fixed << std::setprecision(3) << timing.m_ns_per_call
+                  << detail::format_noise(timing.m_cv, timing.m_noisy) << std::endl;
+        printZones(name, zones_before);
+    }
+
+    /// Times every iteration separately and prints min/p50/p90/p99/p99.9/max in ns.
+    /// The returned histogram can be merged with those of other threads or runs.
+    static LatencyHistogram timeFn_latency(const auto &name, auto &&fn, int N, int precision = 7)
     {
         using namespace std::chrono;
 
-        const auto &start = high_resolution_clock::now();
-        for (int i = 0; i < N; ++i) {
-            fn();
+        LatencyHistogram histogram(precision);
+        const auto zones_before = ZoneProfiler::snapshot();
+        const auto calls = static_cast<uint64_t>(std::max(N, 0));
+        double total_ns = 0.0;
+        std::vector<double> chunk_means;
+        for (uint64_t c = 0; c < detail::kNoiseChunks; ++c) {
+            const auto begin = detail::chunk_begin(c, calls);
+            const auto end = detail::chunk_begin(c + 1, calls);
+            uint64_t chunk_ns = 0;
+            for (auto i = begin; i < end; ++i) {
+                const auto start = steady_clock::now();
+                fn();
+                const auto ns = static_cast<uint64_t>(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+                histogram.record(ns);
+                chunk_ns += ns;
+            }
+            if (end > begin) {
+                total_ns += static_cast<double>(chunk_ns);
+                chunk_means.push_back(static_cast<double>(chunk_ns) / static_cast<double>(end - begin));
+            }
         }
-        const auto &end = high_resolution_clock::now();
-        const double totalTime = static_cast<double>((end - start).count()) / 1000.0 / N;
-        std::cout << "[" << name << "] average fn() us: " << std::fixed << std::setprecision(3) << totalTime << std::endl;
+        const auto noise = detail::summarize_chunks(total_ns, calls, std::move(chunk_means), detail::kDefaultMaxCv);
+        std::ostringstream label;
+        label << name;
+        printEnvironment(name);
+        histogram.print(std::cout, label.str());
+        std::cout << "[" << name << "] chunk means" << detail::format_noise(noise.m_cv, noise.m_noisy) << std::endl;
+        printZones(name, zones_before);
+        return histogram;
     }
 
-    static void timeFn_nano(const auto &name, auto &&fn, int N)
+    /// Runs fn(thread_index) on every thread count of `opts`, all threads released together by a spin barrier,
+    /// and prints aggregate throughput, fairness and scaling efficiency per thread count.
+    static std::vector<ThroughputResult> timeFn_threads(const auto &name, auto &&fn, const ThroughputOptions &opts = {})
     {
-        using namespace std::chrono;
+        std::vector<ThroughputResult> results;
+        for (const int threads : detail::throughput_thread_counts(opts)) {
+            results.push_back(
+                detail::measure_throughput(fn, threads, opts, results.empty() ? nullptr : &results.front()));
+        }
+        std::ostringstream label;
+        label << name;
+        printEnvironment(name);
+        detail::print_throughput(std::cout, label.str(), results);
+        return results;
+    }
+
+    /// Times fn(n) for every n of `range` (see BenchRange) and fits the complexity class.
+    /// When fn returns a callable, fn(n) is untimed setup and the returned callable is measured.
+    static std::vector<SweepResult> timeFn_sweep(const auto &name,
+                                                 const std::vector<int64_t> &range,
+                                                 auto &&fn,
+                                                 const SweepOptions &opts = {},
+                                                 const std::source_location &location = std::source_location::current())
+    {
+        auto unpack = [&fn](const std::vector<int64_t> &args) { return fn(args.front()); };
+        std::vector<std::vector<int64_t>> combinations;
+        for (const auto n : range) {
+            combinations.push_back({n});
+        }
+        return timeFn_sweep(name, combinations, unpack, opts, location);
+    }
 
-        const auto &start = high_resolution_clock::now();
-        for (int i = 0; i < N; ++i) {
-            fn();
+    /// Multi-argument form: every combination (e.g. from BenchRange::product) is reported as its own row,
+    /// the fit uses the first argument.
+    static std::vector<SweepResult> timeFn_sweep(const auto &name,
+                                                 const std::vector<std::vector<int64_t>> &combinations,
+                                                 auto &&fn,
+                                                 const SweepOptions &opts = {},
+                                                 const std::source_location &location = std::source_location::current())
+    {
+        std::vector<SweepResult> results;
+        for (const auto &args : combinations) {
+            results.push_back(detail::run_sweep_point(fn, args, opts));
         }
-        const auto &end = high_resolution_clock::now();
-        const double totalTime = static_cast<double>((end - start).count()) / N;
-        std::cout << "[" << name << "] average fn() ns: " << std::fixed << std::setprecision(3) << totalTime << std::endl;
+        std::ostringstream label;
+        label << name;
+        printEnvironment(name);
+        detail::report_sweep(std::cout, label.str(), results, opts, location);
+        return results;
+    }
+
+    /// Measures fn warm (back to back), cold (caches polluted and opts.flush_ranges flushed before every
+    /// call) and, with opts.input_copies, with fn(copy) rotating over input copies, and prints them side by
+    /// side. Each call is timed on its own, so keep fn well above the ~20 ns clock overhead.
+    static CacheComparison timeFn_cache(const auto &name, auto &&fn, int N, const CacheOptions &opts = {})
+    {
+        const auto zones_before = ZoneProfiler::snapshot();
+        const auto result = detail::run_cache_modes(fn, N, opts);
+        std::ostringstream label;
+        label << name;
+        printEnvironment(name);
+        detail::print_cache_comparison(std::cout, label.str(), result, opts);
+        printZones(name, zones_before);
+        return result;
+    }
+
+    /// The full environment once per run, then a one-line summary before every result.
+    static void printEnvironment(const auto &name)
+    {
+        std::ostringstream label;
+        label << name;
+        print_environment_line(std::cout, label.str());
+    }
+
+private:
+    static void printZones(const auto &name, const ZoneReport &before)
+    {
+        std::ostringstream prefix;
+        prefix << "[" << name << "] zone";
+        ZoneProfiler::print(std::cout, ZoneProfiler::delta(ZoneProfiler::snapshot(), before), prefix.str());
     }
 };
 
+/// AB_BENCHMARK("parse", old_parse, new_parse) runs opts.rounds rounds, each timing one sample of A and B in
+/// random order, and prints the paired speedup A/B with its confidence interval and a Mann-Whitney U test: B is
+/// significantly faster, slower, or there is no significant difference. With opts.require_b_faster anything
+/// but "faster" fails the running test.
+inline AbResult AB_BENCHMARK(const auto &name,
+                            auto &&fn_a,
+                            auto &&fn_b,
+                            const AbOptions &opts = {},
+                            const std::source_location &location = std::source_location::current())
+{
+    const auto result = detail::run_ab(fn_a, fn_b, opts);
+    std::ostringstream label;
+    label << name;
+    TestHelper::printEnvironment(name);
+    detail::report_ab(std::cout, label.str(), result, opts, location);
+    return result;
+}
+
 } // namespace psi::test
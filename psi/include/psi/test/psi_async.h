@@ -0,0 +1,232 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <future>
+#include <span>
+#include <utility>
+
+#include "psi/test/psi_test.h"
+
+namespace psi::test {
+
+/// Single-threaded executor driving the ASYNC_TESTs of a group concurrently. Every resumption makes the
+/// owning test the current running test, so assertions and EXPECT_CALL are attributed across suspensions.
+struct AsyncExecutor {
+    using Clock = std::chrono::steady_clock;
+    using DoneFn = std::function<void(TestLib::TestCase &test, std::exception_ptr error)>;
+
+    /// Starts every test's coroutine and runs until all have finished. on_done runs on completion of each
+    /// test, with that test current; error is set when its body ended with an exception. Tests still running
+    /// after timeout (zero waits forever) fail and complete; their coroutines are abandoned. Each test is
+    /// recorded as a "test" trace event, from its start to the return of its on_done.
+    static void run(std::span<TestLib::TestCase *const> tests,
+                    const DoneFn &on_done,
+                    Clock::duration timeout = Clock::duration::zero());
+
+    /// Resumes h on the executor. Safe to call from any thread, e.g. from the completion callback of a user
+    /// awaitable: h is the body of an ASYNC_TEST or an AsyncTask it awaits, and the executor looks up the test
+    /// it belongs to. Other coroutine types posted from another thread resume with no current test.
+    static void post(std::coroutine_handle<> h);
+    /// Resumes h once deadline has passed. Executor thread only.
+    static void post_at(Clock::time_point deadline, std::coroutine_handle<> h);
+    /// Resumes h once ready() returns true; polled on every executor iteration. Executor thread only.
+    static void post_when(std::function<bool()> ready, std::coroutine_handle<> h);
+
+    /// Called by AsyncTask on the executor thread: the frame h runs on behalf of the current test until it
+    /// finishes. No-op elsewhere.
+    static void track_task(std::coroutine_handle<> h);
+    static void untrack_task(std::coroutine_handle<> h);
+};
+
+/// Coroutine type of ASYNC_TEST bodies and of helpers they co_await. Starts suspended; awaiting a task
+/// runs it until its first suspension and resumes the awaiter when it finishes (exceptions propagate).
+class AsyncTask
+{
+public:
+    struct promise_type {
+        std::coroutine_handle<> m_continuation;
+        std::exception_ptr m_exception;
+
+        AsyncTask get_return_object() noexcept
+        {
+            return AsyncTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+        auto final_suspend() noexcept
+        {
+            struct FinalAwaiter {
+                bool await_ready() noexcept
+                {
+                    return false;
+                }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
+                {
+                    AsyncExecutor::untrack_task(h);
+                    const auto continuation = h.promise().m_continuation;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+                void await_resume() noexcept {}
+            };
+            return FinalAwaiter {};
+        }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept
+        {
+            m_exception = std::current_exception();
+        }
+    };
+    using Handle = std::coroutine_handle<promise_type>;
+
+    AsyncTask() = default;
+    explicit AsyncTask(Handle h) noexcept
+        : m_handle(h)
+    {
+    }
+    AsyncTask(AsyncTask &&other) noexcept
+        : m_handle(std::exchange(other.m_handle, {}))
+    {
+    }
+    AsyncTask &operator=(AsyncTask &&other) noexcept
+    {
+        if (this != &other) {
+            if (m_handle) {
+                m_handle.destroy();
+            }
+            m_handle = std::exchange(other.m_handle, {});
+        }
+        return *this;
+    }
+    AsyncTask(const AsyncTask &) = delete;
+    AsyncTask &operator=(const AsyncTask &) = delete;
+    ~AsyncTask()
+    {
+        if (m_handle) {
+            m_handle.destroy();
+        }
+    }
+
+    /// Hands the coroutine over to the caller, who becomes responsible for destroying it.
+    Handle release() noexcept
+    {
+        return std::exchange(m_handle, {});
+    }
+
+    auto operator co_await() && noexcept
+    {
+        struct Awaiter {
+            Handle m_child;
+            bool await_ready() noexcept
+            {
+                return !m_child || m_child.done();
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> parent)
+            {
+                AsyncExecutor::track_task(m_child);
+                m_child.promise().m_continuation = parent;
+                return m_child;
+            }
+            void await_resume()
+            {
+                if (m_child && m_child.promise().m_exception) {
+                    std::rethrow_exception(m_child.promise().m_exception);
+                }
+            }
+        };
+        return Awaiter {m_handle};
+    }
+
+private:
+    Handle m_handle;
+};
+
+struct SleepAwaiter {
+    AsyncExecutor::Clock::duration m_delay;
+
+    bool await_ready() const noexcept
+    {
+        return m_delay <= AsyncExecutor::Clock::duration::zero();
+    }
+    void await_suspend(std::coroutine_handle<> h) const
+    {
+        AsyncExecutor::post_at(AsyncExecutor::Clock::now() + m_delay, h);
+    }
+    void await_resume() const noexcept {}
+};
+
+struct YieldAwaiter {
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> h) const
+    {
+        AsyncExecutor::post(h);
+    }
+    void await_resume() const noexcept {}
+};
+
+template <typename T>
+struct FutureAwaiter {
+    std::future<T> m_future;
+
+    bool is_ready() const
+    {
+        return m_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+    bool await_ready() const
+    {
+        return is_ready();
+    }
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        AsyncExecutor::post_when([this] { return is_ready(); }, h);
+    }
+    T await_resume()
+    {
+        return m_future.get();
+    }
+};
+
+/// Suspends the calling test for at least delay; other tests run in the meantime.
+template <typename Rep, typename Period>
+inline SleepAwaiter async_sleep(std::chrono::duration<Rep, Period> delay)
+{
+    return {std::chrono::duration_cast<AsyncExecutor::Clock::duration>(delay)};
+}
+
+/// Lets the other tests run before the calling one continues.
+inline YieldAwaiter async_yield()
+{
+    return {};
+}
+
+/// Suspends the calling test until future is ready and returns its value.
+template <typename T>
+inline FutureAwaiter<T> async_wait(std::future<T> future)
+{
+    return {std::move(future)};
+}
+
+#define ASYNC_TEST(test_group, test_name)                                                                              \
+    static psi::test::AsyncTask test_group##_##test_name##_impl();                                                     \
+    namespace {                                                                                                        \
+    struct test_group##_##test_name##_registrar {                                                                      \
+        test_group##_##test_name##_registrar()                                                                         \
+        {                                                                                                              \
+            psi::test::TestLib::TestCase tc {#test_group, #test_name, {}, {}};                                         \
+            tc.m_async_fn = &test_group##_##test_name##_impl;                                                          \
+            tc.m_location = std::source_location::current();                                                           \
+            psi::test::TestLib::add_test(tc);                                                                          \
+        }                                                                                                              \
+    };                                                                                                                 \
+    static test_group##_##test_name##_registrar test_group##_##test_name##_registrar_instance;                         \
+    }                                                                                                                  \
+    static psi::test::AsyncTask test_group##_##test_name##_impl()
+
+} // namespace psi::test
@@ -0,0 +1,609 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <source_location>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace psi::test {
+
+/// Releases all participants at the same moment without going through the scheduler.
+class SpinBarrier
+{
+public:
+    explicit SpinBarrier(int participants)
+        : m_participants(participants)
+    {
+    }
+
+    void arrive_and_wait() noexcept
+    {
+        const auto generation = m_generation.load(std::memory_order_acquire);
+        if (m_arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == m_participants) {
+            m_arrived.store(0, std::memory_order_relaxed);
+            m_generation.fetch_add(1, std::memory_order_release);
+            return;
+        }
+        while (m_generation.load(std::memory_order_acquire) == generation) {
+        }
+    }
+
+private:
+    const int m_participants;
+    std::atomic<int> m_arrived {0};
+    std::atomic<uint32_t> m_generation {0};
+};
+
+struct ThroughputOptions {
+    /// Thread counts to measure. Empty means 1, 2, 4, ... up to max_threads (always including max_threads).
+    std::vector<int> thread_counts;
+    int max_threads = static_cast<int>(std::thread::hardware_concurrency());
+    /// Pin worker i to cpus[i % cpus.size()], or to core i when cpus is empty.
+    bool pin_threads = false;
+    std::vector<int> cpus;
+    /// Each thread runs for `duration` unless ops_per_thread is set.
+    std::chrono::milliseconds duration {200};
+    uint64_t ops_per_thread = 0;
+    /// The duration (or op count) is split over this many back-to-back samples; a coefficient of variation of
+    /// their throughput above max_cv marks the row noisy.
+    int repetitions = 3;
+    double max_cv = 0.05;
+};
+
+struct ThroughputResult {
+    int m_threads = 0;
+    double m_seconds = 0.0;
+    double m_ops_per_sec = 0.0;
+    /// Slowest thread's op count divided by the fastest one's (1.0 = perfectly fair).
+    double m_fairness = 0.0;
+    /// Per-thread throughput relative to the first (single-thread) row.
+    double m_efficiency = 0.0;
+    std::vector<uint64_t> m_ops_per_thread;
+    /// Coefficient of variation of the samples' throughput.
+    double m_cv = 0.0;
+    bool m_noisy = false;
+};
+
+/// Argument lists for parameterized sweeps.
+struct BenchRange {
+    /// from, from + step, ... <= to
+    static std::vector<int64_t> dense(int64_t from, int64_t to, int64_t step = 1);
+    /// `count` values evenly spaced between from and to (inclusive)
+    static std::vector<int64_t> linear(int64_t from, int64_t to, int count);
+    /// from, 2 * from, 4 * from, ... and always `to`
+    static std::vector<int64_t> pow2(int64_t from, int64_t to);
+    /// Cartesian product of several argument ranges, first range varying slowest.
+    static std::vector<std::vector<int64_t>> product(const std::vector<std::vector<int64_t>> &ranges);
+};
+
+enum class Complexity : uint8_t
+{
+    O1,
+    OLogN,
+    ON,
+    ONLogN,
+    ON2,
+};
+
+struct ComplexityFit {
+    Complexity m_complexity = Complexity::O1;
+    /// Time per unit of f(n), in ns.
+    double m_coefficient = 0.0;
+    /// Root mean square of the residuals relative to the mean time.
+    double m_rms = 0.0;
+};
+
+/// Least-squares fit of t(n) = c * f(n) for every supported f; returns the one with the lowest RMS.
+ComplexityFit fit_complexity(const std::vector<int64_t> &n, const std::vector<double> &ns);
+const char *to_string(Complexity complexity);
+
+/// State of the machine as far as it affects benchmark stability.
+struct BenchEnvironment {
+    int m_online_cpus = 0;
+    /// CPUs the process is allowed to run on.
+    std::vector<int> m_cpus;
+    /// cpufreq scaling governor of the first allowed CPU, empty when unknown.
+    std::string m_governor;
+    std::optional<bool> m_turbo;
+    std::optional<bool> m_smt;
+    bool m_high_priority = false;
+    std::vector<std::string> m_warnings;
+    /// Facts worth knowing that do not make the numbers unreliable by themselves, printed without the warning tag.
+    std::vector<std::string> m_notes;
+};
+
+struct StabilizeOptions {
+    /// Restrict the process (and threads created afterwards) to these CPUs. Empty keeps the current mask.
+    std::vector<int> cpus;
+    bool raise_priority = true;
+};
+
+/// Reads affinity, cpufreq governor, turbo and SMT state. The result is cached until stabilize_environment().
+const BenchEnvironment &probe_environment();
+/// Applies CPU pinning and priority where permitted and returns the updated environment. CPUs the platform cannot
+/// address are dropped with a warning.
+const BenchEnvironment &stabilize_environment(const StabilizeOptions &opts);
+/// Puts back the affinity and priority stabilize_environment() changed; TestLib::run() calls it when it is done,
+/// after which print_environment_once() prints again.
+void restore_environment();
+void print_environment(std::ostream &os, const BenchEnvironment &env);
+/// Prints probe_environment() unless it was already printed since the last stabilize or restore: the benchmark
+/// runners call it so that a run shows the environment once.
+void print_environment_once(std::ostream &os);
+/// print_environment_once() followed by a one-line summary tagged with `name`: every benchmark result carries
+/// the conditions it was measured under, not only the first one of the run.
+void print_environment_line(std::ostream &os, const std::string &name);
+/// Parses "0,2,4-7" into a CPU list.
+std::vector<int> parse_cpu_list(const std::string &list);
+
+struct SweepOptions {
+    /// Every argument combination is repeated until it ran at least this long.
+    std::chrono::milliseconds min_time {50};
+    /// Samples per combination; their coefficient of variation decides whether the row is noisy.
+    int repetitions = 3;
+    double max_cv = 0.05;
+    /// Noisy combinations are measured again up to this many times, keeping the least noisy run.
+    int max_reruns = 2;
+    /// Fit the first argument against the measured times (needs at least 3 rows).
+    bool fit_complexity = true;
+    /// Fail the running test when the fitted complexity is worse than this.
+    std::optional<Complexity> max_complexity;
+};
+
+struct StableMeasurement {
+    /// Median of the samples.
+    double m_ns_per_call = 0.0;
+    /// Standard deviation divided by mean of the samples.
+    double m_cv = 0.0;
+    uint64_t m_iterations = 0;
+    int m_reruns = 0;
+    bool m_noisy = false;
+};
+
+struct SweepResult {
+    std::vector<int64_t> m_args;
+    uint64_t m_iterations = 0;
+    double m_ns_per_call = 0.0;
+    double m_cv = 0.0;
+    int m_reruns = 0;
+    bool m_noisy = false;
+};
+
+struct CacheOptions {
+    /// Bytes streamed over before every cold iteration; 0 means twice the last-level cache.
+    size_t flush_bytes = 0;
+    /// Ranges (typically fn's input) evicted with clflush before every cold iteration. x86 only, elsewhere
+    /// the streaming pass alone evicts them.
+    std::vector<std::pair<const void *, size_t>> flush_ranges;
+    /// Input copies fn(copy) cycles through in the rotated mode, 0 to skip it. Choose enough copies that
+    /// together they are larger than the last-level cache.
+    int input_copies = 0;
+    /// A mode whose consecutive chunks of samples differ by more than this (coefficient of variation of the
+    /// chunk means) is marked noisy.
+    double max_cv = 0.05;
+};
+
+struct CacheModeResult {
+    double m_mean_ns = 0.0;
+    double m_median_ns = 0.0;
+    double m_p90_ns = 0.0;
+    double m_cv = 0.0;
+    bool m_noisy = false;
+};
+
+struct CacheComparison {
+    /// fn repeated back to back on the same input.
+    CacheModeResult m_warm;
+    /// Caches polluted (and flush_ranges flushed) before every iteration.
+    CacheModeResult m_flushed;
+    /// Inputs rotated over CacheOptions::input_copies copies, without flushing.
+    std::optional<CacheModeResult> m_rotated;
+    size_t m_flush_bytes = 0;
+};
+
+struct AbOptions {
+    /// Paired samples: every round times one sample of A and one of B in random order.
+    int rounds = 30;
+    /// Calls per sample are calibrated so one sample of the slower side takes about this long.
+    std::chrono::milliseconds min_time {5};
+    /// Two-sided level of the speedup confidence interval; alpha of the significance test is 1 - confidence.
+    double confidence = 0.95;
+    /// Seed of the round order; 0 draws one from std::random_device.
+    uint64_t seed = 0;
+    /// Fail the running test unless B is significantly faster than A.
+    bool require_b_faster = false;
+    /// A or B samples with a coefficient of variation above this mark the comparison noisy.
+    double max_cv = 0.05;
+};
+
+struct AbResult {
+    /// ns per call of every sample, index = round.
+    std::vector<double> m_a_ns;
+    std::vector<double> m_b_ns;
+    uint64_t m_a_iterations = 0;
+    uint64_t m_b_iterations = 0;
+    /// Seed of the round order, for AbOptions::seed to replay it.
+    uint64_t m_seed = 0;
+    /// Median of the paired ratios A / B: above 1 means B is faster.
+    double m_speedup = 0.0;
+    double m_ci_low = 0.0;
+    double m_ci_high = 0.0;
+    /// Mann-Whitney U of the A samples and its two-sided p-value (normal approximation, ties corrected).
+    double m_u = 0.0;
+    double m_p_value = 1.0;
+    /// p-value below 1 - confidence and a confidence interval that excludes 1.
+    bool m_significant = false;
+    /// Coefficient of variation of the A and of the B samples.
+    double m_a_cv = 0.0;
+    double m_b_cv = 0.0;
+    bool m_noisy = false;
+};
+
+/// Size of the largest (last-level) CPU cache, 32 MiB when it cannot be determined.
+size_t last_level_cache_bytes();
+
+namespace detail {
+
+/// Timing entry points without repeated samples of their own split their calls into this many consecutive
+/// chunks; the spread of the chunk means tells whether the machine was steady while they ran.
+inline constexpr uint64_t kNoiseChunks = 5;
+inline constexpr double kDefaultMaxCv = 0.05;
+
+/// Index of the first of n calls that belongs to chunk c (chunk_begin(kNoiseChunks, n) == n).
+constexpr uint64_t chunk_begin(uint64_t c, uint64_t n)
+{
+    return (c * n + kNoiseChunks - 1) / kNoiseChunks;
+}
+
+/// " +-x.x%", followed by " [NOISY]" when noisy.
+std::string format_noise(double cv, bool noisy);
+
+/// Reads and writes one byte per cache line of a process-wide buffer of `bytes`, evicting whatever the
+/// caches held before.
+void pollute_caches(size_t bytes);
+/// clflush every cache line of [data, data + size) followed by a fence; a no-op without SSE2.
+void flush_cache_lines(const void *data, size_t size);
+/// Mean, median and p90 of the samples, plus the coefficient of variation of the means of kNoiseChunks
+/// consecutive chunks of them.
+CacheModeResult summarize_cache_samples(std::vector<double> samples, double max_cv);
+void print_cache_comparison(std::ostream &os, const std::string &name, const CacheComparison &result,
+                            const CacheOptions &opts);
+
+/// Times each of N calls separately in every mode; the flushing and rotation setup is outside the timed
+/// region. fn takes the input copy index when it accepts an int (always 0 outside the rotated mode).
+template <typename Fn>
+CacheComparison run_cache_modes(Fn &fn, int N, const CacheOptions &opts)
+{
+    using namespace std::chrono;
+
+    auto call = [&fn](int copy) {
+        if constexpr (std::is_invocable_v<Fn &, int>) {
+            fn(copy);
+        } else {
+            static_cast<void>(copy);
+            fn();
+        }
+    };
+    auto timed = [&call](int copy) {
+        const auto start = steady_clock::now();
+        call(copy);
+        return static_cast<double>(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+    };
+    const auto iterations = static_cast<size_t>(std::max(1, N));
+
+    CacheComparison result;
+    result.m_flush_bytes = opts.flush_bytes ? opts.flush_bytes : 2 * last_level_cache_bytes();
+    std::vector<double> samples(iterations);
+
+    call(0);
+    for (auto &s : samples) {
+        s = timed(0);
+    }
+    result.m_warm = summarize_cache_samples(samples, opts.max_cv);
+
+    for (auto &s : samples) {
+        pollute_caches(result.m_flush_bytes);
+        for (const auto &[data, size] : opts.flush_ranges) {
+            flush_cache_lines(data, size);
+        }
+        s = timed(0);
+    }
+    result.m_flushed = summarize_cache_samples(samples, opts.max_cv);
+
+    if (std::is_invocable_v<Fn &, int> && opts.input_copies > 0) {
+        // One untimed pass so first-touch page faults are not counted.
+        for (int copy = 0; copy < opts.input_copies; ++copy) {
+            call(copy);
+        }
+        for (size_t i = 0; i < iterations; ++i) {
+            samples[i] = timed(static_cast<int>(i % static_cast<size_t>(opts.input_copies)));
+        }
+        result.m_rotated = summarize_cache_samples(samples, opts.max_cv);
+    }
+    return result;
+}
+
+struct alignas(64) PaddedCounter {
+    uint64_t m_value = 0;
+};
+
+bool pin_current_thread(int cpu);
+std::vector<int> throughput_thread_counts(const ThroughputOptions &opts);
+ThroughputResult make_throughput_result(int threads,
+                                        const std::vector<PaddedCounter> &ops,
+                                        double seconds,
+                                        const ThroughputResult *baseline);
+void print_throughput(std::ostream &os, const std::string &name, const std::vector<ThroughputResult> &results);
+
+template <typename Fn>
+ThroughputResult run_throughput(Fn &fn, int threads, const ThroughputOptions &opts, const ThroughputResult *baseline)
+{
+    using namespace std::chrono;
+
+    SpinBarrier barrier(threads + 1);
+    std::atomic<bool> stop {false};
+    std::vector<PaddedCounter> ops(static_cast<size_t>(threads));
+    std::vector<std::thread> workers;
+    workers.reserve(static_cast<size_t>(threads));
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            if (opts.pin_threads) {
+                pin_current_thread(opts.cpus.empty() ? t : opts.cpus[static_cast<size_t>(t) % opts.cpus.size()]);
+            }
+            barrier.arrive_and_wait();
+            uint64_t n = 0;
+            if (opts.ops_per_thread) {
+                for (; n < opts.ops_per_thread; ++n) {
+                    fn(t);
+                }
+            } else {
+                while (!stop.load(std::memory_order_relaxed)) {
+                    fn(t);
+                    ++n;
+                }
+            }
+            ops[static_cast<size_t>(t)].m_value = n;
+        });
+    }
+    barrier.arrive_and_wait();
+    const auto start = steady_clock::now();
+    if (!opts.ops_per_thread) {
+        std::this_thread::sleep_for(opts.duration);
+        stop.store(true, std::memory_order_relaxed);
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    const auto seconds = duration<double>(steady_clock::now() - start).count();
+    return make_throughput_result(threads, ops, seconds, baseline);
+}
+
+/// Doubles the iteration count (starting from `iterations`) until `body` ran for at least min_time
+/// and returns ns per call.
+template <typename Body>
+double measure_ns_per_call(Body &body, std::chrono::nanoseconds min_time, uint64_t &iterations)
+{
+    using namespace std::chrono;
+
+    iterations = std::max<uint64_t>(iterations, 1);
+    while (true) {
+        const auto start = steady_clock::now();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            body();
+        }
+        const auto elapsed = steady_clock::now() - start;
+        if (elapsed >= min_time || iterations >= (uint64_t(1) << 40)) {
+            return static_cast<double>(duration_cast<nanoseconds>(elapsed).count()) / static_cast<double>(iterations);
+        }
+        // Aim slightly above min_time based on the current rate, but at least double.
+        const auto elapsed_ns = std::max<int64_t>(1, duration_cast<nanoseconds>(elapsed).count());
+        const auto predicted = static_cast<uint64_t>(1.2 * static_cast<double>(min_time.count()) *
+                                                    static_cast<double>(iterations) / static_cast<double>(elapsed_ns));
+        iterations = std::max(iterations * 2, std::min(predicted, iterations * 100));
+    }
+}
+
+StableMeasurement summarize_samples(std::vector<double> samples);
+
+/// Takes `repetitions` samples and repeats the whole measurement while their coefficient of variation
+/// exceeds max_cv, at most max_reruns times.
+template <typename Body>
+StableMeasurement measure_stable(Body &body, std::chrono::nanoseconds min_time, int repetitions, double max_cv,
+                                 int max_reruns)
+{
+    StableMeasurement best;
+    uint64_t iterations = 0;
+    for (int attempt = 0; attempt <= std::max(0, max_reruns); ++attempt) {
+        std::vector<double> samples;
+        for (int i = 0; i < std::max(1, repetitions); ++i) {
+            samples.push_back(measure_ns_per_call(body, min_time, iterations));
+        }
+        auto m = summarize_samples(std::move(samples));
+        m.m_iterations = iterations;
+        m.m_reruns = attempt;
+        if (attempt == 0 || m.m_cv < best.m_cv) {
+            best = m;
+        }
+        if (best.m_cv <= max_cv) {
+            break;
+        }
+    }
+    best.m_noisy = best.m_cv > max_cv;
+    return best;
+}
+
+struct ChunkedTiming {
+    /// Mean over all calls.
+    double m_ns_per_call = 0.0;
+    /// Standard deviation divided by mean of the chunk means.
+    double m_cv = 0.0;
+    bool m_noisy = false;
+};
+
+ChunkedTiming summarize_chunks(double total_ns, uint64_t calls, std::vector<double> chunk_means, double max_cv);
+
+/// Runs fn n times in kNoiseChunks consecutive chunks, each timed on its own.
+template <typename Fn>
+ChunkedTiming time_in_chunks(Fn &fn, uint64_t n, double max_cv)
+{
+    using namespace std::chrono;
+
+    double total_ns = 0.0;
+    std::vector<double> chunk_means;
+    for (uint64_t c = 0; c < kNoiseChunks; ++c) {
+        const auto begin = chunk_begin(c, n);
+        const auto end = chunk_begin(c + 1, n);
+        if (begin == end) {
+            continue;
+        }
+        const auto start = steady_clock::now();
+        for (auto i = begin; i < end; ++i) {
+            fn();
+        }
+        const auto ns = static_cast<double>(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+        total_ns += ns;
+        chunk_means.push_back(ns / static_cast<double>(end - begin));
+    }
+    return summarize_chunks(total_ns, n, std::move(chunk_means), max_cv);
+}
+
+/// run_throughput() split into opts.repetitions samples of opts.duration / repetitions (or an equal share of
+/// opts.ops_per_thread), summed into one row whose m_cv is the spread of the samples' throughput.
+template <typename Fn>
+ThroughputResult measure_throughput(Fn &fn, int threads, const ThroughputOptions &opts,
+                                    const ThroughputResult *baseline)
+{
+    const auto repetitions = static_cast<uint64_t>(std::max(1, opts.repetitions));
+    std::vector<PaddedCounter> ops(static_cast<size_t>(threads));
+    double seconds = 0.0;
+    std::vector<double> rates;
+    for (uint64_t r = 0; r < repetitions; ++r) {
+        auto slice = opts;
+        slice.duration = std::max(std::chrono::milliseconds(1), opts.duration / static_cast<int>(repetitions));
+        slice.ops_per_thread = opts.ops_per_thread * (r + 1) / repetitions - opts.ops_per_thread * r / repetitions;
+        if (opts.ops_per_thread && !slice.ops_per_thread) {
+            continue; // fewer ops than samples
+        }
+        const auto sample = run_throughput(fn, threads, slice, nullptr);
+        for (size_t t = 0; t < ops.size(); ++t) {
+            ops[t].m_value += sample.m_ops_per_thread[t];
+        }
+        seconds += sample.m_seconds;
+        rates.push_back(sample.m_ops_per_sec);
+    }
+    auto result = make_throughput_result(threads, ops, seconds, baseline);
+    result.m_cv = summarize_samples(std::move(rates)).m_cv;
+    result.m_noisy = result.m_cv > opts.max_cv;
+    return result;
+}
+
+/// Runs body `iterations` times and returns ns per call.
+template <typename Body>
+double time_iterations(Body &body, uint64_t iterations)
+{
+    using namespace std::chrono;
+
+    const auto start = steady_clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        body();
+    }
+    const auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    return static_cast<double>(elapsed) / static_cast<double>(std::max<uint64_t>(iterations, 1));
+}
+
+uint64_t ab_seed(const AbOptions &opts);
+/// Fills the speedup, its confidence interval and the significance test from the samples.
+void analyze_ab(AbResult &result, const AbOptions &opts);
+/// Prints the comparison; a failed opts.require_b_faster is reported at location.
+void report_ab(std::ostream &os,
+               const std::string &name,
+               const AbResult &result,
+               const AbOptions &opts,
+               const std::source_location &location);
+
+struct MannWhitney {
+    double m_u = 0.0;
+    double m_p_value = 1.0;
+};
+MannWhitney mann_whitney_u(const std::vector<double> &a, const std::vector<double> &b);
+/// Distribution-free confidence interval of the median from order statistics (binomial with p = 1/2).
+std::pair<double, double> median_confidence_interval(std::vector<double> samples, double confidence);
+
+/// Interleaves A and B in a random order every round, so drift in clock speed, temperature or background
+/// load lands on both sides instead of biasing whichever ran second.
+template <typename FnA, typename FnB>
+AbResult run_ab(FnA &fn_a, FnB &fn_b, const AbOptions &opts)
+{
+    AbResult result;
+    // Calibration doubles as warm-up; both sides then run the same number of calls per sample.
+    const auto min_time = std::chrono::nanoseconds(opts.min_time);
+    const auto a_ns = measure_ns_per_call(fn_a, min_time, result.m_a_iterations);
+    const auto b_ns = measure_ns_per_call(fn_b, min_time, result.m_b_iterations);
+    const auto iterations = std::max<uint64_t>(
+        1, static_cast<uint64_t>(static_cast<double>(min_time.count()) / std::max({a_ns, b_ns, 1e-3})));
+    result.m_a_iterations = iterations;
+    result.m_b_iterations = iterations;
+
+    result.m_seed = ab_seed(opts);
+    uint64_t state = result.m_seed;
+    const auto rounds = static_cast<size_t>(std::max(1, opts.rounds));
+    result.m_a_ns.resize(rounds);
+    result.m_b_ns.resize(rounds);
+    for (size_t round = 0; round < rounds; ++round) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        if (state >> 63) {
+            result.m_a_ns[round] = time_iterations(fn_a, iterations);
+            result.m_b_ns[round] = time_iterations(fn_b, iterations);
+        } else {
+            result.m_b_ns[round] = time_iterations(fn_b, iterations);
+            result.m_a_ns[round] = time_iterations(fn_a, iterations);
+        }
+    }
+    analyze_ab(result, opts);
+    return result;
+}
+
+/// fn(args) is timed directly, or, when it returns a callable, fn(args) is the untimed setup and the
+/// returned callable is timed.
+template <typename Fn>
+SweepResult run_sweep_point(Fn &fn, const std::vector<int64_t> &args, const SweepOptions &opts)
+{
+    auto measure = [&opts](auto &body) {
+        return measure_stable(body, opts.min_time, opts.repetitions, opts.max_cv, opts.max_reruns);
+    };
+    StableMeasurement m;
+    if constexpr (std::is_invocable_v<std::invoke_result_t<Fn &, const std::vector<int64_t> &>>) {
+        auto body = fn(args);
+        m = measure(body);
+    } else {
+        auto body = [&fn, &args]() { fn(args); };
+        m = measure(body);
+    }
+    SweepResult r;
+    r.m_args = args;
+    r.m_iterations = m.m_iterations;
+    r.m_ns_per_call = m.m_ns_per_call;
+    r.m_cv = m.m_cv;
+    r.m_reruns = m.m_reruns;
+    r.m_noisy = m.m_noisy;
+    return r;
+}
+
+/// Prints the rows and the complexity fit; a fit worse than opts.max_complexity is reported at location.
+void report_sweep(std::ostream &os,
+                  const std::string &name,
+                  const std::vector<SweepResult> &results,
+                  const SweepOptions &opts,
+                  const std::source_location &location);
+
+} // namespace detail
+
+} // namespace psi::test
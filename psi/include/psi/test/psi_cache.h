@@ -0,0 +1,44 @@
+#pragma once
+
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace psi::test {
+
+/// Opt-in cache of passing results (--psi_cache_dir). A test's key hashes the test binary, its full name,
+/// the contents of its declared input files and the options that can change its verdict, so rebuilding
+/// the binary or editing an input invalidates it. Entries are written to a temporary file and renamed into
+/// place, so several processes can share a directory.
+struct ResultCache {
+    /// Declares files whose contents the result of Group.Name depends on (see PSI_TEST_INPUTS).
+    static void declare_inputs(const std::string &full_name, std::initializer_list<const char *> paths);
+
+    /// Enables the cache in dir (created if needed); false if it cannot be created. extra_key is mixed
+    /// into every key.
+    static bool open(const std::string &dir, const std::string &extra_key);
+    static void close();
+    static bool enabled();
+
+    /// Key of Group.Name, as hex. Hashes the binary on first use.
+    static std::string key(const std::string &full_name);
+    static bool has_pass(const std::string &key, const std::string &full_name);
+    static void store_pass(const std::string &key, const std::string &full_name, long long time_ms);
+};
+
+/// 128-bit hash, as 32 hex digits, for cache keys (not cryptographic).
+std::string hash_hex(const void *data, size_t size);
+
+} // namespace psi::test
+
+/// PSI_TEST_INPUTS(Group, Name, "data/a.json", ...) makes cached results of Group.Name depend on those files.
+#define PSI_TEST_INPUTS(test_group, test_name, ...)                                                                    \
+    namespace {                                                                                                        \
+    struct test_group##_##test_name##_inputs_registrar {                                                               \
+        test_group##_##test_name##_inputs_registrar()                                                                  \
+        {                                                                                                              \
+            psi::test::ResultCache::declare_inputs(#test_group "." #test_name, {__VA_ARGS__});                         \
+        }                                                                                                              \
+    };                                                                                                                 \
+    static test_group##_##test_name##_inputs_registrar test_group##_##test_name##_inputs_registrar_instance;           \
+    }
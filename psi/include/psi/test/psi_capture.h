@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace psi::test {
+
+/// Redirects the process' stdout and stderr (fd 1 and 2, so child processes and C stdio are covered too)
+/// into a pipe while a test runs. A reader thread keeps the first and the last keep_bytes of what arrives, so
+/// memory stays within 2 * keep_bytes however much the test prints. The runner keeps duplicates of the
+/// original descriptors and writes its own lines there.
+struct OutputCapture {
+    /// Starts capturing; returns false (and leaves the descriptors alone) when a capture is already running
+    /// or redirection is not possible.
+    static bool start(size_t keep_bytes);
+    /// Restores fd 1 and 2 and returns the captured bytes. Output longer than 2 * keep_bytes comes back as its
+    /// first and last keep_bytes around a line telling how much was omitted.
+    static std::string stop();
+    static bool active();
+    /// Writes to the original stdout, bypassing an active capture.
+    static void write_runner(std::string_view text);
+};
+
+} // namespace psi::test
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <ratio>
+#include <utility>
+
+#include "psi/test/psi_test.h"
+
+namespace psi::test {
+
+/// Virtual clock satisfying the Clock requirements. Time only moves when the test advances it; timers
+/// scheduled on it fire, in deadline order, from inside advance() / advance_to_next(). Code under test
+/// takes the clock as a template parameter (or FakeClock::now as a std::function) instead of a real clock.
+/// The runner resets it (time zero, no timers) at the start of every test.
+struct FakeClock {
+    using rep = int64_t;
+    using period = std::nano;
+    using duration = std::chrono::duration<rep, period>;
+    using time_point = std::chrono::time_point<FakeClock>;
+    static constexpr bool is_steady = true;
+
+    using TimerId = uint64_t;
+
+    static time_point now() noexcept;
+
+    /// Runs fn once now() reaches deadline; a deadline in the past fires on the next advance.
+    static TimerId schedule_at(time_point deadline, std::function<void()> fn);
+    static TimerId schedule_after(duration delay, std::function<void()> fn);
+    /// Returns false if the timer already fired or was cancelled.
+    static bool cancel(TimerId id);
+
+    /// Moves time forward by delta, firing every timer due on the way with now() equal to its deadline.
+    /// Timers scheduled by those callbacks fire too if they fall inside the interval. Returns the number fired.
+    static size_t advance(duration delta);
+    /// Moves time to the earliest pending deadline and fires the timers due then. Returns false if none is pending.
+    static bool advance_to_next();
+    /// Fires timers until none is pending, at most max_timers of them. Returns the number fired.
+    static size_t run_all(size_t max_timers = 1000000);
+
+    static std::optional<time_point> next_deadline();
+    static size_t pending_timers();
+
+    /// Back to time zero, dropping pending timers.
+    static void reset();
+
+    /// Calls the mock with args once delay has elapsed on the clock.
+    template <typename R, typename... Args, typename... CallArgs>
+    static TimerId call_after(duration delay,
+                              const std::shared_ptr<MockedFn<std::function<R(Args...)>>> &mock,
+                              CallArgs &&...args)
+    {
+        return schedule_after(delay, [mock, ... args = std::forward<CallArgs>(args)]() mutable {
+            mock->fn()(std::move(args)...);
+        });
+    }
+};
+
+} // namespace psi::test
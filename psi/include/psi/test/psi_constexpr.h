@@ -0,0 +1,125 @@
+#pragma once
+
+#include <source_location>
+#include <string>
+#include <type_traits>
+
+#include "psi_mock.h"
+
+namespace psi::test {
+
+namespace detail {
+
+/// Deliberately not constexpr: reaching it during constant evaluation makes the static_assert of a
+/// CONSTEXPR_TEST ill-formed, and compilers print the call with its argument values in the note stack.
+template <typename A, typename B>
+void constexpr_check_failed(const char *assertion, const A &actual, const B &expected)
+{
+    static_cast<void>(assertion);
+    static_cast<void>(actual);
+    static_cast<void>(expected);
+}
+
+} // namespace detail
+
+/// Assertions of a CONSTEXPR_TEST body. Evaluated by the compiler, a failing check stops constant evaluation
+/// (a compile error naming the check and its values); at runtime it records a failure like EXPECT_EQ.
+class ConstexprContext
+{
+public:
+    constexpr void expect_true(bool value, const std::source_location &location = std::source_location::current())
+    {
+        check(value, "expect_true", value, true, location);
+    }
+    constexpr void expect_false(bool value, const std::source_location &location = std::source_location::current())
+    {
+        check(!value, "expect_false", value, false, location);
+    }
+    template <typename A, typename B>
+    constexpr void expect_eq(const A &actual,
+                             const B &expected,
+                             const std::source_location &location = std::source_location::current())
+    {
+        check(actual == expected, "expect_eq", actual, expected, location);
+    }
+    template <typename A, typename B>
+    constexpr void expect_ne(const A &actual,
+                             const B &expected,
+                             const std::source_location &location = std::source_location::current())
+    {
+        check(actual != expected, "expect_ne", actual, expected, location);
+    }
+    template <typename A, typename B>
+    constexpr void expect_lt(const A &actual,
+                             const B &expected,
+                             const std::source_location &location = std::source_location::current())
+    {
+        check(actual < expected, "expect_lt", actual, expected, location);
+    }
+    template <typename A, typename B>
+    constexpr void expect_le(const A &actual,
+                             const B &expected,
+                             const std::source_location &location = std::source_location::current())
+    {
+        check(actual <= expected, "expect_le", actual, expected, location);
+    }
+
+private:
+    template <typename A, typename B>
+    constexpr void check(bool ok,
+                         const char *assertion,
+                         const A &actual,
+                         const B &expected,
+                         const std::source_location &location)
+    {
+        if (ok) {
+            return;
+        }
+        if (std::is_constant_evaluated()) {
+            detail::constexpr_check_failed(assertion, actual, expected);
+            return;
+        }
+        if (auto test = TestLib::current_running_test()) {
+            const auto a = detail::to_printable(actual);
+            const auto e = detail::to_printable(expected);
+            test->fail_test(std::string(assertion) + ": actual " + a + ", expected " + e, false, location, assertion,
+                            a, e);
+        }
+    }
+};
+
+namespace detail {
+
+template <typename Ctx>
+consteval bool constexpr_test_passes(void (*body)(Ctx &))
+{
+    Ctx ctx;
+    body(ctx);
+    return true;
+}
+
+} // namespace detail
+
+} // namespace psi::test
+
+/// CONSTEXPR_TEST(Group, Name) { ctx.expect_eq(f(3), 9); } checks the body twice: in a static_assert, so a
+/// failing check breaks the build, and as a regular TEST, so the run reports it and coverage and sanitizer
+/// builds execute it. The body is a function template whose static_assert sits in another template: both
+/// are instantiated at the end of the translation unit, once the body below the macro has been defined.
+#define CONSTEXPR_TEST(test_group, test_name)                                                                          \
+    template <typename Ctx>                                                                                            \
+    static constexpr void test_group##_##test_name##_constexpr_body(Ctx &ctx);                                         \
+    template <typename Ctx>                                                                                            \
+    static void test_group##_##test_name##_constexpr_run()                                                             \
+    {                                                                                                                  \
+        static_assert(psi::test::detail::constexpr_test_passes<Ctx>(&test_group##_##test_name##_constexpr_body<Ctx>), \
+                      "CONSTEXPR_TEST " #test_group "." #test_name " failed at compile time");                         \
+        Ctx ctx;                                                                                                       \
+        test_group##_##test_name##_constexpr_body(ctx);                                                                \
+    }                                                                                                                  \
+    TEST(test_group, test_name)                                                                                        \
+    {                                                                                                                  \
+        test_group##_##test_name##_constexpr_run<psi::test::ConstexprContext>();                                       \
+    }                                                                                                                  \
+    template <typename Ctx>                                                                                            \
+    static constexpr void test_group##_##test_name##_constexpr_body([[maybe_unused]] Ctx &ctx)
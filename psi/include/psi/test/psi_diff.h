@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace psi::test {
+
+/// Limits of a failure diff. Whatever the input size, the diff works on at most m_max_window_lines lines
+/// per side and gives up after m_max_edits edits, so its memory stays bounded.
+struct DiffOptions {
+    size_t m_context_lines = 3;
+    size_t m_max_hunks = 4;
+    size_t m_max_output_lines = 60;
+    size_t m_max_line_width = 160;
+    size_t m_max_window_lines = 20000;
+    size_t m_max_edits = 512;
+    size_t m_hex_rows_before = 2;
+    size_t m_hex_rows_after = 4;
+    /// Position of the inputs within larger data, added to the reported lines, offsets and hex row labels.
+    size_t m_line_offset = 0;
+    size_t m_byte_offset = 0;
+    /// false leaves out the leading sizes and first-difference summary, for callers that report their own.
+    bool m_header = true;
+};
+
+/// Line-based Myers diff of a and b as unified hunks, preceded by sizes, the first difference and an
+/// edit summary. Meant for failure messages: call it only once a and b are known to differ.
+std::string diff_text(std::string_view a, std::string_view b, const DiffOptions &options = {});
+
+/// Hex window around the first differing byte, with the number of differing bytes and both sizes.
+std::string diff_bytes(const void *a, size_t size_a, const void *b, size_t size_b, const DiffOptions &options = {});
+
+/// git's heuristic: data with a NUL byte in its first 8000 bytes (or around `around`) is binary.
+bool looks_binary(std::string_view data, size_t around = 0) noexcept;
+
+namespace detail {
+
+/// Failure message for two differing strings: the plain "a not equal to b" for short single-line values,
+/// otherwise diff_text or diff_bytes.
+std::string describe_string_mismatch(std::string_view a, std::string_view b);
+
+} // namespace detail
+
+} // namespace psi::test
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+#include "psi/test/psi_test.h"
+
+namespace psi::test {
+
+/// Runs the filtered tests on worker processes over TCP. The coordinator hands out batches of test names,
+/// sized down as the queue drains so fast workers keep pulling work; workers run each test of a batch and
+/// stream back its console output and verdict. The batch of a worker that disconnects is re-queued, and a
+/// test that takes down two workers is reported as failed. POSIX only.
+struct DistributedRunner {
+    /// --psi_coordinator=host:port (port 0 picks a free one), with --psi_spawn_workers=N local workers.
+    static int coordinate(const TestLib::CmdOptions &opts);
+    /// --psi_worker=host:port: runs batches until the coordinator is done. Returns 1 if it cannot connect.
+    static int work(const std::string &address);
+};
+
+} // namespace psi::test
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <source_location>
+#include <span>
+#include <string>
+#include <type_traits>
+
+#include "psi_test.h"
+
+namespace psi::test {
+
+namespace detail {
+
+struct FloatCompareSummary {
+    size_t m_count = 0;
+    size_t m_failures = 0;
+    size_t m_first_failure = 0;
+    size_t m_nan_mismatches = 0;
+    size_t m_inf_mismatches = 0;
+    double m_max_abs_error = 0.0;
+    size_t m_max_abs_index = 0;
+    uint64_t m_max_ulps = 0;
+    size_t m_max_ulp_index = 0;
+    // criterion the values were checked against
+    bool m_is_ulp_check = false;
+    double m_abs_error = 0.0;
+    double m_rel_error = 0.0;
+    uint64_t m_allowed_ulps = 0;
+};
+
+/// Element i passes when |a - b| <= max(abs_error, rel_error * max(|a|, |b|)), both are the same infinity
+/// or both are NaN. Failures are counted with SIMD kernels where available; error maxima and locations
+/// are computed only when something failed.
+FloatCompareSummary compare_near(std::span<const float> a, std::span<const float> b, double abs_error, double rel_error);
+FloatCompareSummary compare_near(std::span<const double> a, std::span<const double> b, double abs_error, double rel_error);
+/// Element i passes when a and b are at most max_ulps representable values apart (or both NaN).
+FloatCompareSummary compare_ulps(std::span<const float> a, std::span<const float> b, uint64_t max_ulps);
+FloatCompareSummary compare_ulps(std::span<const double> a, std::span<const double> b, uint64_t max_ulps);
+
+uint64_t ulp_distance(float a, float b);
+uint64_t ulp_distance(double a, double b);
+
+std::string describe_float_failure(const char *assertion,
+                                   const FloatCompareSummary &s,
+                                   std::span<const double> a,
+                                   std::span<const double> b);
+std::string describe_float_failure(const char *assertion,
+                                   const FloatCompareSummary &s,
+                                   std::span<const float> a,
+                                   std::span<const float> b);
+
+template <typename T>
+void check_float_summary(const char *assertion,
+                         const FloatCompareSummary &s,
+                         std::span<const T> a,
+                         std::span<const T> b,
+                         bool is_assert,
+                         const std::source_location &location)
+{
+    if (s.m_failures == 0 && a.size() == b.size()) {
+        return;
+    }
+    if (auto test = TestLib::current_running_test()) {
+        test->fail_test(describe_float_failure(assertion, s, a, b), is_assert, location, assertion);
+    }
+}
+
+} // namespace detail
+
+/// Compares in the common type of the arguments, so EXPECT_NEAR(float_value, 0.1, 1e-6) checks in double
+/// (long double is compared as double).
+template <typename T1, typename T2>
+    requires std::is_arithmetic_v<T1> && std::is_arithmetic_v<T2> && (std::floating_point<T1> || std::floating_point<T2>)
+inline void EXPECT_NEAR(T1 arg1,
+                        T2 arg2,
+                        double abs_error,
+                        const std::source_location &location = std::source_location::current())
+{
+    using T = std::conditional_t<std::is_same_v<std::common_type_t<T1, T2>, float>, float, double>;
+    const auto a = static_cast<T>(arg1);
+    const auto b = static_cast<T>(arg2);
+    const auto s = detail::compare_near(std::span<const T>(&a, 1), std::span<const T>(&b, 1), abs_error, 0.0);
+    detail::check_float_summary<T>("EXPECT_NEAR", s, {&a, 1}, {&b, 1}, false, location);
+}
+
+template <typename T>
+    requires std::floating_point<T>
+inline void EXPECT_FLOAT_ULP_EQ(T a,
+                                T b,
+                                uint64_t max_ulps = 4,
+                                const std::source_location &location = std::source_location::current())
+{
+    const auto s = detail::compare_ulps(std::span<const T>(&a, 1), std::span<const T>(&b, 1), max_ulps);
+    detail::check_float_summary<T>("EXPECT_FLOAT_ULP_EQ", s, {&a, 1}, {&b, 1}, false, location);
+}
+
+inline void EXPECT_ALL_NEAR(std::span<const float> a,
+                            std::span<const float> b,
+                            double abs_error,
+                            double rel_error = 0.0,
+                            const std::source_location &location = std::source_location::current())
+{
+    const auto s = detail::compare_near(a, b, abs_error, rel_error);
+    detail::check_float_summary<float>("EXPECT_ALL_NEAR", s, a, b, false, location);
+}
+
+inline void EXPECT_ALL_NEAR(std::span<const double> a,
+                            std::span<const double> b,
+                            double abs_error,
+                            double rel_error = 0.0,
+                            const std::source_location &location = std::source_location::current())
+{
+    const auto s = detail::compare_near(a, b, abs_error, rel_error);
+    detail::check_float_summary<double>("EXPECT_ALL_NEAR", s, a, b, false, location);
+}
+
+inline void EXPECT_ALL_ULP(std::span<const float> a,
+                           std::span<const float> b,
+                           uint64_t max_ulps,
+                           const std::source_location &location = std::source_location::current())
+{
+    const auto s = detail::compare_ulps(a, b, max_ulps);
+    detail::check_float_summary<float>("EXPECT_ALL_ULP", s, a, b, false, location);
+}
+
+inline void EXPECT_ALL_ULP(std::span<const double> a,
+                           std::span<const double> b,
+                           uint64_t max_ulps,
+                           const std::source_location &location = std::source_location::current())
+{
+    const auto s = detail::compare_ulps(a, b, max_ulps);
+    detail::check_float_summary<double>("EXPECT_ALL_ULP", s, a, b, false, location);
+}
+
+} // namespace psi::test
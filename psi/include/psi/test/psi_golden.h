@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <source_location>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "psi_test.h"
+
+namespace psi::test {
+
+/// Golden-file comparisons. The golden file is memory-mapped and compared chunk by chunk, so large outputs
+/// are checked without reading the file into memory; a mismatch reports the first differing byte (with its
+/// line) and a diff or hex window around it. With --psi_update_golden differing or missing golden files are
+/// rewritten instead: the new contents go to a temporary file in the same directory that is renamed over it.
+struct GoldenFile {
+    static void set_update(bool update);
+    static bool update_enabled();
+};
+
+namespace detail {
+
+/// Compares actual with the golden file at path, or rewrites it in update mode. Empty when they match.
+std::string check_golden(const std::string &path, std::string_view actual);
+/// Same, streaming actual in chunks; the stream is read to its end.
+std::string check_golden(const std::string &path, std::istream &actual);
+
+inline void report_golden(const std::string &error,
+                          bool is_assert,
+                          const std::source_location &location,
+                          const char *assertion,
+                          const std::string &path)
+{
+    if (error.empty()) {
+        return;
+    }
+    if (auto test = TestLib::current_running_test()) {
+        test->fail_test(error, is_assert, location, assertion, {}, path);
+    }
+}
+
+} // namespace detail
+
+inline void EXPECT_MATCHES_GOLDEN(const std::string &path,
+                                  std::string_view actual,
+                                  const std::source_location &location = std::source_location::current())
+{
+    detail::report_golden(detail::check_golden(path, actual), false, location, "EXPECT_MATCHES_GOLDEN", path);
+}
+
+inline void EXPECT_MATCHES_GOLDEN(const std::string &path,
+                                  std::span<const std::byte> actual,
+                                  const std::source_location &location = std::source_location::current())
+{
+    const std::string_view bytes(reinterpret_cast<const char *>(actual.data()), actual.size());
+    detail::report_golden(detail::check_golden(path, bytes), false, location, "EXPECT_MATCHES_GOLDEN", path);
+}
+
+inline void EXPECT_MATCHES_GOLDEN(const std::string &path,
+                                  std::istream &actual,
+                                  const std::source_location &location = std::source_location::current())
+{
+    detail::report_golden(detail::check_golden(path, actual), false, location, "EXPECT_MATCHES_GOLDEN", path);
+}
+
+inline void ASSERT_MATCHES_GOLDEN(const std::string &path,
+                                  std::string_view actual,
+                                  const std::source_location &location = std::source_location::current())
+{
+    detail::report_golden(detail::check_golden(path, actual), true, location, "ASSERT_MATCHES_GOLDEN", path);
+}
+
+inline void ASSERT_MATCHES_GOLDEN(const std::string &path,
+                                  std::span<const std::byte> actual,
+                                  const std::source_location &location = std::source_location::current())
+{
+    const std::string_view bytes(reinterpret_cast<const char *>(actual.data()), actual.size());
+    detail::report_golden(detail::check_golden(path, bytes), true, location, "ASSERT_MATCHES_GOLDEN", path);
+}
+
+inline void ASSERT_MATCHES_GOLDEN(const std::string &path,
+                                  std::istream &actual,
+                                  const std::source_location &location = std::source_location::current())
+{
+    detail::report_golden(detail::check_golden(path, actual), true, location, "ASSERT_MATCHES_GOLDEN", path);
+}
+
+} // namespace psi::test
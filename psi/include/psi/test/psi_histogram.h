@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <iosfwd>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace psi::test {
+
+/// HDR-style log-linear histogram of non-negative integer values (e.g. nanoseconds).
+/// Values below 2^precision are counted exactly; above that each power-of-two range is split into
+/// 2^(precision - 1) buckets, so the relative error stays below 2^(1 - precision).
+/// Memory is fixed at construction and record() neither allocates nor branches on the value range.
+class LatencyHistogram
+{
+public:
+    static constexpr int kMinPrecision = 2;
+    static constexpr int kMaxPrecision = 16;
+
+    explicit LatencyHistogram(int precision = 7);
+
+    void record(uint64_t value) noexcept
+    {
+        ++m_counts[bucket_index(value)];
+        ++m_total_count;
+        m_sum += value;
+        m_min = std::min(m_min, value);
+        m_max = std::max(m_max, value);
+    }
+
+    /// Adds all samples of `other`. Histograms of different precision are merged bucket by bucket.
+    void merge(const LatencyHistogram &other);
+    void reset();
+
+    int precision() const
+    {
+        return m_precision;
+    }
+    uint64_t count() const
+    {
+        return m_total_count;
+    }
+    uint64_t min() const
+    {
+        return m_total_count ? m_min : 0;
+    }
+    uint64_t max() const
+    {
+        return m_max;
+    }
+    double mean() const;
+    /// Highest value equivalent to the sample at `percentile` (0..100), clamped to max().
+    uint64_t value_at_percentile(double percentile) const;
+
+    /// Prints "[name] count/min/p50/p90/p99/p99.9/max" with values in `unit`.
+    void print(std::ostream &os, const std::string &name, const char *unit = "ns") const;
+
+private:
+    size_t bucket_index(uint64_t value) const noexcept
+    {
+        // Exact values are the shift == 0 case of the log-linear formula, so no branch on value < 2^precision.
+        const auto shift = std::max(static_cast<int>(std::bit_width(value)) - m_precision, 0);
+        const auto half = uint64_t(1) << (m_precision - 1);
+        return static_cast<size_t>(static_cast<uint64_t>(shift) * half + (value >> shift));
+    }
+    uint64_t bucket_lowest(size_t index) const;
+    uint64_t bucket_highest(size_t index) const;
+
+    int m_precision;
+    std::vector<uint64_t> m_counts;
+    uint64_t m_total_count = 0;
+    uint64_t m_sum = 0;
+    uint64_t m_min = std::numeric_limits<uint64_t>::max();
+    uint64_t m_max = 0;
+};
+
+} // namespace psi::test
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace psi::test {
+
+/// Heap usage is tracked by the global operator new/delete replacements defined in psi_memory.cpp, including
+/// the std::align_val_t overloads. Configure with -DPSI_TEST_HEAP_TRACKING=OFF (which defines
+/// PSI_TEST_NO_HEAP_TRACKING) to keep the default allocator; AddressSanitizer builds always keep it.
+struct MemoryTracker {
+    static bool heap_tracking_enabled();
+    static size_t current_heap_bytes();
+    static size_t peak_heap_bytes();
+    /// Starts a new high-water window: peak becomes the current heap usage.
+    static void reset_peak();
+
+    /// Current resident set size of the process, 0 if unavailable.
+    static size_t rss_bytes();
+    /// Resident set size high-water mark of the process, 0 if unavailable.
+    static size_t peak_rss_bytes();
+};
+
+/// Parses a byte count with an optional B/K/M/G suffix ("512", "64K", "1M"). Empty when malformed or too large.
+std::optional<size_t> parse_byte_size(std::string_view str);
+
+} // namespace psi::test
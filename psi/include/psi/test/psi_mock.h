@@ -1,16 +1,21 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstdio>
 #include <functional>
 #include <map>
 #include <memory>
+#include <ranges>
+#include <source_location>
 #include <string>
 #include <string_view>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "psi_diff.h"
+#include "psi_float.h"
 #include "psi_test.h"
 
 namespace psi::test {
@@ -41,119 +46,127 @@ concept bool_integral = std::integral<T> && std::same_as<T, bool>;
 
 template <typename T1, typename T2>
     requires non_bool_integral<std::remove_cvref_t<T1>> && non_bool_integral<std::remove_cvref_t<T2>>
-inline void COMPARE(T1 &&arg1, T2 &&arg2, ComparisonOperation op, bool is_assert = false)
+inline void COMPARE(T1 &&arg1,
+                    T2 &&arg2,
+                    ComparisonOperation op,
+                    bool is_assert = false,
+                    const std::source_location &location = std::source_location::current(),
+                    std::string_view assertion = "COMPARE")
 {
     bool res = false;
-    std::string error;
+    const char *relation = "";
 
     switch (op) {
     case ComparisonOperation::Equal:
         res = std::cmp_equal(arg1, arg2);
-        error = "[PSI-TEST] arg1 (" + std::to_string(arg1) + ") MUST be equal to arg2 (" + std::to_string(arg2) + ")";
+        relation = "equal to";
         break;
     case ComparisonOperation::Greater:
         res = std::cmp_greater(arg1, arg2);
-        error = "[PSI-TEST] arg1 (" + std::to_string(arg1) + ") MUST be greater than arg2 (" + std::to_string(arg2) + ")";
+        relation = "greater than";
         break;
     case ComparisonOperation::GreaterOrEqual:
         res = std::cmp_greater_equal(arg1, arg2);
-        error = "[PSI-TEST] arg1 (" + std::to_string(arg1) + ") MUST be greater than or equal to arg2 (" + std::to_string(arg2) + ")";
+        relation = "greater than or equal to";
         break;
     case ComparisonOperation::Less:
         res = std::cmp_less(arg1, arg2);
-        error = "[PSI-TEST] arg1 (" + std::to_string(arg1) + ") MUST be less than arg2 (" + std::to_string(arg2) + ")";
+        relation = "less than";
         break;
     case ComparisonOperation::LessOrEqual:
         res = std::cmp_less_equal(arg1, arg2);
-        error = "[PSI-TEST] arg1 (" + std::to_string(arg1) + ") MUST be less than or equal to arg2 (" + std::to_string(arg2) + ")";
+        relation = "less than or equal to";
         break;
     }
 
     if (!res) {
         if (auto test = TestLib::current_running_test()) {
-            test->fail_test(error, is_assert);
+            const auto actual = std::to_string(arg1);
+            const auto expected = std::to_string(arg2);
+            const auto error = "[PSI-TEST] arg1 (" + actual + ") MUST be " + relation + " arg2 (" + expected + ")";
+            test->fail_test(error, is_assert, location, assertion, actual, expected);
         }
     }
 }
 
 template <typename T1, typename T2>
     requires non_bool_integral<std::remove_cvref_t<T1>> && non_bool_integral<std::remove_cvref_t<T2>>
-inline void EXPECT_EQ(T1 &&arg1, T2 &&arg2)
+inline void EXPECT_EQ(T1 &&arg1, T2 &&arg2, const std::source_location &location = std::source_location::current())
 {
-    COMPARE(std::forward<T1>(arg1), std::forward<T2>(arg2), ComparisonOperation::Equal);
+    COMPARE(std::forward<T1>(arg1), std::forward<T2>(arg2), ComparisonOperation::Equal, false, location, "EXPECT_EQ");
 }
 
 template <typename T1, typename T2>
     requires bool_integral<std::remove_cvref_t<T1>> && bool_integral<std::remove_cvref_t<T2>>
-inline void EXPECT_EQ(T1 &&a1, T2 &&a2)
+inline void EXPECT_EQ(T1 &&a1, T2 &&a2, const std::source_location &location = std::source_location::current())
 {
     if (a1 != a2) {
         if (auto test = TestLib::current_running_test()) {
             const auto error = std::string(a1 ? "true" : "false") + " not equal to " + (a2 ? "true" : "false");
-            test->fail_test(error);
+            test->fail_test(error, false, location, "EXPECT_EQ", a1 ? "true" : "false", a2 ? "true" : "false");
         }
     }
 }
 
 template <typename T>
-inline void EXPECT_TRUE(T arg)
+inline void EXPECT_TRUE(T arg, const std::source_location &location = std::source_location::current())
 {
     if (!arg) {
         if (auto test = TestLib::current_running_test()) {
-            const auto error = std::to_string(arg) + " not TRUE";
-            test->fail_test(error);
+            const auto actual = std::to_string(arg);
+            test->fail_test(actual + " not TRUE", false, location, "EXPECT_TRUE", actual, "true");
         }
     }
 }
 
 template <typename T>
-inline void EXPECT_FALSE(T arg)
+inline void EXPECT_FALSE(T arg, const std::source_location &location = std::source_location::current())
 {
     if (arg) {
         if (auto test = TestLib::current_running_test()) {
-            const auto error = std::to_string(arg) + " not FALSE";
-            test->fail_test(error);
+            const auto actual = std::to_string(arg);
+            test->fail_test(actual + " not FALSE", false, location, "EXPECT_FALSE", actual, "false");
         }
     }
 }
 
 template <typename T>
-inline void ASSERT_TRUE(T arg)
+inline void ASSERT_TRUE(T arg, const std::source_location &location = std::source_location::current())
 {
     if (!arg) {
         if (auto test = TestLib::current_running_test()) {
-            const auto error = std::to_string(arg) + " not TRUE";
-            test->fail_test(error, true);
+            const auto actual = std::to_string(arg);
+            test->fail_test(actual + " not TRUE", true, location, "ASSERT_TRUE", actual, "true");
         }
     }
 }
 
 template <typename T>
-inline void ASSERT_FALSE(T arg)
+inline void ASSERT_FALSE(T arg, const std::source_location &location = std::source_location::current())
 {
     if (arg) {
         if (auto test = TestLib::current_running_test()) {
-            const auto error = std::to_string(arg) + " not FALSE";
-            test->fail_test(error, true);
+            const auto actual = std::to_string(arg);
+            test->fail_test(actual + " not FALSE", true, location, "ASSERT_FALSE", actual, "false");
         }
     }
 }
 
 template <typename T1, typename T2>
     requires non_bool_integral<std::remove_cvref_t<T1>> && non_bool_integral<std::remove_cvref_t<T2>>
-inline void ASSERT_EQ(T1 &&arg1, T2 &&arg2)
+inline void ASSERT_EQ(T1 &&arg1, T2 &&arg2, const std::source_location &location = std::source_location::current())
 {
-    COMPARE(std::forward<T1>(arg1), std::forward<T2>(arg2), ComparisonOperation::Equal, true);
+    COMPARE(std::forward<T1>(arg1), std::forward<T2>(arg2), ComparisonOperation::Equal, true, location, "ASSERT_EQ");
 }
 
 template <typename T1, typename T2>
     requires bool_integral<std::remove_cvref_t<T1>> && bool_integral<std::remove_cvref_t<T2>>
-inline void ASSERT_EQ(T1 &&a1, T2 &&a2)
+inline void ASSERT_EQ(T1 &&a1, T2 &&a2, const std::source_location &location = std::source_location::current())
 {
     if (a1 != a2) {
         if (auto test = TestLib::current_running_test()) {
             const auto error = std::string(a1 ? "true" : "false") + " not equal to " + (a2 ? "true" : "false");
-            test->fail_test(error, true);
+            test->fail_test(error, true, location, "ASSERT_EQ", a1 ? "true" : "false", a2 ? "true" : "false");
         }
     }
 }
@@ -161,55 +174,76 @@ inline void ASSERT_EQ(T1 &&a1, T2 &&a2)
 template <typename T1, typename T2>
     requires std::is_pointer_v<std::remove_cvref_t<T1>>
              && (std::is_pointer_v<std::remove_cvref_t<T2>> || std::same_as<std::remove_cvref_t<T2>, std::nullptr_t>)
-inline void EXPECT_EQ(T1 ptr1, T2 ptr2)
+inline void EXPECT_EQ(T1 ptr1, T2 ptr2, const std::source_location &location = std::source_location::current())
 {
     const auto res = ptr1 == ptr2;
     if (!res) {
         if (auto test = TestLib::current_running_test()) {
             const void *p1 = ptr1;
             const void *p2 = ptr2;
-            const auto error = detail::ptr_to_str(p1) + " not equal to " + detail::ptr_to_str(p2);
-            test->fail_test(error);
+            const auto actual = detail::ptr_to_str(p1);
+            const auto expected = detail::ptr_to_str(p2);
+            test->fail_test(actual + " not equal to " + expected, false, location, "EXPECT_EQ", actual, expected);
         }
     }
 }
 
 template <typename T1, typename T2>
     requires std::convertible_to<T1, std::string_view> && std::convertible_to<T2, std::string_view>
-inline void EXPECT_EQ(T1 &&s1, T2 &&s2)
+inline void EXPECT_EQ(T1 &&s1, T2 &&s2, const std::source_location &location = std::source_location::current())
 {
     const auto res = std::string_view {s1} == std::string_view {s2};
     if (!res) {
         if (auto test = TestLib::current_running_test()) {
-            const auto error = std::string(std::string_view(s1)) + " not equal to " + std::string(std::string_view(s2));
-            test->fail_test(error);
+            test->fail_test(detail::describe_string_mismatch(s1, s2), false, location, "EXPECT_EQ", s1, s2);
         }
     }
 }
 
 template <typename T1, typename T2>
     requires std::convertible_to<T1, std::string_view> && std::convertible_to<T2, std::string_view>
-inline void EXPECT_CONTAINS(T1 &&haystack, T2 &&needle)
+inline void EXPECT_CONTAINS(T1 &&haystack,
+                            T2 &&needle,
+                            const std::source_location &location = std::source_location::current())
 {
     const std::string_view h {haystack};
     const std::string_view n {needle};
-    if (h.find(n) == std::string_view::npos) {
+    if (find_substring(h, n) == std::string_view::npos) {
         if (auto test = TestLib::current_running_test()) {
-            const auto error = std::string("\"" ) + std::string(h) + "\" does not contain \"" + std::string(n) + "\"";
-            test->fail_test(error);
+            const auto error = detail::quote_excerpt(h) + " does not contain \"" + std::string(n) + "\"";
+            test->fail_test(error, false, location, "EXPECT_CONTAINS", h, n);
         }
     }
 }
 
+/// Passes when pattern matches somewhere in text (see Regex); the pattern is compiled once per process.
+template <typename T>
+    requires std::convertible_to<T, std::string_view>
+inline void EXPECT_MATCHES_REGEX(T &&text,
+                                 std::string_view pattern,
+                                 const std::source_location &location = std::source_location::current())
+{
+    const std::string_view t {text};
+    const auto &regex = Regex::cached(pattern);
+    if (regex.valid() && regex.search(t)) {
+        return;
+    }
+    if (auto test = TestLib::current_running_test()) {
+        const auto error = regex.valid()
+                               ? detail::quote_excerpt(t) + " does not match /" + regex.pattern() + "/"
+                               : "[PSI-TEST] invalid regex /" + regex.pattern() + "/: " + regex.error();
+        test->fail_test(error, false, location, "EXPECT_MATCHES_REGEX", t, pattern);
+    }
+}
+
 template <typename T1, typename T2>
     requires std::convertible_to<T1, std::string_view> && std::convertible_to<T2, std::string_view>
-inline void ASSERT_EQ(T1 &&s1, T2 &&s2)
+inline void ASSERT_EQ(T1 &&s1, T2 &&s2, const std::source_location &location = std::source_location::current())
 {
     const auto res = std::string_view {s1} == std::string_view {s2};
     if (!res) {
         if (auto test = TestLib::current_running_test()) {
-            const auto error = std::string(std::string_view(s1)) + " not equal to " + std::string(std::string_view(s2));
-            test->fail_test(error, true);
+            test->fail_test(detail::describe_string_mismatch(s1, s2), true, location, "ASSERT_EQ", s1, s2);
         }
     }
 }
@@ -217,42 +251,44 @@ inline void ASSERT_EQ(T1 &&s1, T2 &&s2)
 template <typename T1, typename T2>
     requires std::convertible_to<T1, std::basic_string_view<char8_t>>
              && std::convertible_to<T2, std::basic_string_view<char8_t>>
-inline void EXPECT_EQ(T1 &&a, T2 &&b)
+inline void EXPECT_EQ(T1 &&a, T2 &&b, const std::source_location &location = std::source_location::current())
 {
     const auto res = std::basic_string_view<char8_t> {a} == std::basic_string_view<char8_t> {b};
     if (!res) {
         if (auto test = TestLib::current_running_test()) {
-            const auto s1 = std::string(reinterpret_cast<const char *>(a.data()), a.size());
-            const auto s2 = std::string(reinterpret_cast<const char *>(b.data()), b.size());
-            const auto error = s1 + " not equal to " + s2;
-            test->fail_test(error);
+            const std::basic_string_view<char8_t> u1 {a};
+            const std::basic_string_view<char8_t> u2 {b};
+            const std::string_view s1 {reinterpret_cast<const char *>(u1.data()), u1.size()};
+            const std::string_view s2 {reinterpret_cast<const char *>(u2.data()), u2.size()};
+            test->fail_test(detail::describe_string_mismatch(s1, s2), false, location, "EXPECT_EQ", s1, s2);
         }
     }
 }
 
 template <typename T1, typename T2>
     requires std::convertible_to<T1, std::wstring_view> && std::convertible_to<T2, std::wstring_view>
-inline void EXPECT_EQ(const T1 &a, const T2 &b)
+inline void EXPECT_EQ(const T1 &a, const T2 &b, const std::source_location &location = std::source_location::current())
 {
     const auto res = std::wstring_view {a} == std::wstring_view {b};
     if (!res) {
         if (auto test = TestLib::current_running_test()) {
-            const auto s1 = std::wstring(std::wstring_view {a});
-            const auto s2 = std::wstring(std::wstring_view {b});
-            test->fail_test(s1 + L" not equal to " + s2);
+            const auto s1 = detail::to_utf8(std::wstring_view {a});
+            const auto s2 = detail::to_utf8(std::wstring_view {b});
+            test->fail_test(detail::describe_string_mismatch(s1, s2), false, location, "EXPECT_EQ", s1, s2);
         }
     }
 }
 
 template <typename T1, typename T2>
     requires std::convertible_to<T1, std::wstring_view> && std::convertible_to<T2, std::wstring_view>
-inline void ASSERT_EQ(T1 &&s1, T2 &&s2)
+inline void ASSERT_EQ(T1 &&a, T2 &&b, const std::source_location &location = std::source_location::current())
 {
-    const auto res = std::wstring_view {s1} == std::wstring_view {s2};
+    const auto res = std::wstring_view {a} == std::wstring_view {b};
     if (!res) {
         if (auto test = TestLib::current_running_test()) {
-            const auto error = std::wstring(s1) + L" not equal to " + std::wstring(s2);
-            test->fail_test(error, true);
+            const auto s1 = detail::to_utf8(std::wstring_view {a});
+            const auto s2 = detail::to_utf8(std::wstring_view {b});
+            test->fail_test(detail::describe_string_mismatch(s1, s2), true, location, "ASSERT_EQ", s1, s2);
         }
     }
 }
@@ -260,7 +296,7 @@ inline void ASSERT_EQ(T1 &&s1, T2 &&s2)
 template <typename T1, typename T2>
     requires std::is_pointer_v<std::remove_cvref_t<T1>>
              && (std::is_pointer_v<std::remove_cvref_t<T2>> || std::same_as<std::remove_cvref_t<T2>, std::nullptr_t>)
-inline void EXPECT_NE(T1 ptr1, T2 ptr2)
+inline void EXPECT_NE(T1 ptr1, T2 ptr2, const std::source_location &location = std::source_location::current())
 {
     const auto res = ptr1 != ptr2;
     if (!res) {
@@ -268,13 +304,15 @@ inline void EXPECT_NE(T1 ptr1, T2 ptr2)
             const void *p1 = ptr1;
             const void *p2 = ptr2;
             const auto error = detail::ptr_to_str(p1) + " not equal to " + detail::ptr_to_str(p2);
-            test->fail_test(error);
+            test->fail_test(error, false, location, "EXPECT_NE", detail::ptr_to_str(p1));
         }
     }
 }
 
 template <typename T1, typename T2>
-inline void EXPECT_NE(const std::shared_ptr<T1> &ptr1, const std::shared_ptr<T2> &ptr2)
+inline void EXPECT_NE(const std::shared_ptr<T1> &ptr1,
+                      const std::shared_ptr<T2> &ptr2,
+                      const std::source_location &location = std::source_location::current())
 {
     const bool res = ptr1 != ptr2;
 
@@ -283,13 +321,15 @@ inline void EXPECT_NE(const std::shared_ptr<T1> &ptr1, const std::shared_ptr<T2>
             const void *p1 = ptr1.get();
             const void *p2 = ptr2.get();
             const auto error = detail::ptr_to_str(p1) + " not equal to " + detail::ptr_to_str(p2);
-            test->fail_test(error);
+            test->fail_test(error, false, location, "EXPECT_NE", detail::ptr_to_str(p1));
         }
     }
 }
 
 template <typename T>
-inline void EXPECT_NE(const std::shared_ptr<T> &ptr, std::nullptr_t)
+inline void EXPECT_NE(const std::shared_ptr<T> &ptr,
+                      std::nullptr_t,
+                      const std::source_location &location = std::source_location::current())
 {
     const bool res = ptr != nullptr;
 
@@ -297,77 +337,227 @@ inline void EXPECT_NE(const std::shared_ptr<T> &ptr, std::nullptr_t)
         if (auto test = TestLib::current_running_test()) {
             const void *p = ptr.get();
             const auto error = detail::ptr_to_str(p) + " not equal to nullptr";
-            test->fail_test(error);
+            test->fail_test(error, false, location, "EXPECT_NE", detail::ptr_to_str(p), "nullptr");
         }
     }
 }
 
 template <typename T>
-inline void EXPECT_NE(std::nullptr_t, const std::shared_ptr<T> &ptr)
+inline void EXPECT_NE(std::nullptr_t,
+                      const std::shared_ptr<T> &ptr,
+                      const std::source_location &location = std::source_location::current())
 {
-    EXPECT_NE(ptr, nullptr);
+    EXPECT_NE(ptr, nullptr, location);
 }
 
 template <typename T>
     requires std::integral<T>
-inline void EXPECT_GE(T &&arg1, T &&arg2)
+inline void EXPECT_GE(T &&arg1, T &&arg2, const std::source_location &location = std::source_location::current())
 {
-    COMPARE(std::forward<T>(arg1), std::forward<T>(arg2), ComparisonOperation::GreaterOrEqual);
+    COMPARE(std::forward<T>(arg1),
+            std::forward<T>(arg2),
+            ComparisonOperation::GreaterOrEqual,
+            false,
+            location,
+            "EXPECT_GE");
 }
 
 template <typename T>
     requires std::integral<T>
-inline void ASSERT_GE(T &&arg1, T &&arg2)
+inline void ASSERT_GE(T &&arg1, T &&arg2, const std::source_location &location = std::source_location::current())
 {
-    COMPARE(std::forward<T>(arg1), std::forward<T>(arg2), ComparisonOperation::GreaterOrEqual, true);
+    COMPARE(std::forward<T>(arg1),
+            std::forward<T>(arg2),
+            ComparisonOperation::GreaterOrEqual,
+            true,
+            location,
+            "ASSERT_GE");
 }
 
 template <typename T1, typename T2>
     requires std::integral<std::remove_cvref_t<T1>> && std::integral<std::remove_cvref_t<T2>>
-inline void EXPECT_LE(T1 &&arg1, T2 &&arg2)
+inline void EXPECT_LE(T1 &&arg1, T2 &&arg2, const std::source_location &location = std::source_location::current())
 {
-    COMPARE(std::forward<T1>(arg1), std::forward<T2>(arg2), ComparisonOperation::LessOrEqual);
+    COMPARE(
+        std::forward<T1>(arg1), std::forward<T2>(arg2), ComparisonOperation::LessOrEqual, false, location, "EXPECT_LE");
 }
 
 template <typename T1, typename T2>
     requires std::floating_point<std::remove_cvref_t<T1>> && std::floating_point<std::remove_cvref_t<T2>>
-inline void EXPECT_EQ(T1 &&arg1, T2 &&arg2)
+inline void EXPECT_EQ(T1 &&arg1, T2 &&arg2, const std::source_location &location = std::source_location::current())
 {
     if (arg1 != arg2) {
         if (auto test = TestLib::current_running_test()) {
-            const auto error = std::to_string(arg1) + " not equal to " + std::to_string(arg2);
-            test->fail_test(error);
+            const auto actual = std::to_string(arg1);
+            const auto expected = std::to_string(arg2);
+            test->fail_test(actual + " not equal to " + expected, false, location, "EXPECT_EQ", actual, expected);
         }
     }
 }
 
-template <typename T1, typename T2>
-    requires std::equality_comparable_with<T1, T2>
-inline void EXPECT_EQ(const std::vector<T1> &a, const std::vector<T2> &b)
+namespace detail {
+
+template <typename R>
+concept string_like = std::convertible_to<const R &, std::string_view> || std::convertible_to<const R &, std::wstring_view>
+                      || std::convertible_to<const R &, std::basic_string_view<char8_t>>;
+
+/// Random-access ranges compared element-wise: std::vector, std::array, std::span, C arrays...
+template <typename R1, typename R2>
+concept comparable_ranges = std::ranges::random_access_range<const R1> && std::ranges::sized_range<const R1>
+                            && std::ranges::random_access_range<const R2> && std::ranges::sized_range<const R2>
+                            && !string_like<R1> && !string_like<R2>
+                            && std::equality_comparable_with<std::ranges::range_value_t<R1>, std::ranges::range_value_t<R2>>;
+
+/// Ranges whose equality is byte equality, so they can be scanned with memcmp. Only scalars qualify: a class
+/// without padding may still define operator== to ignore some of its members.
+template <typename R1, typename R2>
+concept bytewise_comparable_ranges = std::ranges::contiguous_range<const R1> && std::ranges::contiguous_range<const R2>
+                                     && std::same_as<std::ranges::range_value_t<R1>, std::ranges::range_value_t<R2>>
+                                     && std::is_scalar_v<std::ranges::range_value_t<R1>>
+                                     && std::has_unique_object_representations_v<std::ranges::range_value_t<R1>>;
+
+inline constexpr size_t kMaxReportedMismatches = 8;
+inline constexpr size_t kMismatchContext = 3;
+
+/// Byte offset of the first difference in [a, a + size) or `size` when equal. Scans with memcmp in blocks.
+size_t find_first_difference(const void *a, const void *b, size_t size) noexcept;
+std::string bytes_to_hex(const void *data, size_t size);
+
+template <typename T>
+std::string to_printable(const T &value)
 {
-    auto test = TestLib::current_running_test();
+    if constexpr (std::same_as<T, bool>) {
+        return value ? "true" : "false";
+    } else if constexpr (std::is_arithmetic_v<T>) {
+        return std::to_string(value);
+    } else if constexpr (std::is_enum_v<T>) {
+        return std::to_string(static_cast<std::underlying_type_t<T>>(value));
+    } else if constexpr (std::convertible_to<const T &, std::string_view>) {
+        return "\"" + std::string(std::string_view(value)) + "\"";
+    } else if constexpr (std::is_trivially_copyable_v<T>) {
+        return "0x" + bytes_to_hex(&value, sizeof(T));
+    } else {
+        return "<" + std::to_string(sizeof(T)) + "-byte object>";
+    }
+}
 
-    if (a.size() != b.size()) {
-        if (test) {
-            test->fail_test("std::vector<T1> and std::vector<T2> sizes are not equal");
+template <typename R1, typename R2>
+size_t first_range_mismatch(const R1 &a, const R2 &b, size_t size)
+{
+    if constexpr (bytewise_comparable_ranges<R1, R2>) {
+        using T = std::ranges::range_value_t<R1>;
+        return find_first_difference(std::ranges::data(a), std::ranges::data(b), size * sizeof(T)) / sizeof(T);
+    } else {
+        const auto first_a = std::ranges::begin(a);
+        const auto first_b = std::ranges::begin(b);
+        for (size_t i = 0; i < size; ++i) {
+            if (!(first_a[static_cast<std::ptrdiff_t>(i)] == first_b[static_cast<std::ptrdiff_t>(i)])) {
+                return i;
+            }
         }
+        return size;
+    }
+}
+
+/// Compares two ranges without building any string unless they differ. The failure lists the total
+/// mismatch count, the first kMaxReportedMismatches indices and a window around the first one.
+template <typename R1, typename R2>
+void compare_ranges(
+    const R1 &a, const R2 &b, bool is_assert, const std::source_location &location, std::string_view assertion)
+{
+    const size_t size_a = std::ranges::size(a);
+    const size_t size_b = std::ranges::size(b);
+    const size_t common = std::min(size_a, size_b);
+    const size_t first = first_range_mismatch(a, b, common);
+    if (first == common && size_a == size_b) {
+        return;
+    }
+    auto test = TestLib::current_running_test();
+    if (!test) {
+        return;
+    }
+    if constexpr (bytewise_comparable_ranges<R1, R2> && sizeof(std::ranges::range_value_t<R1>) == 1) {
+        const auto error = diff_bytes(std::ranges::data(a), size_a, std::ranges::data(b), size_b);
+        test->fail_test(error, is_assert, location, assertion);
         return;
     }
 
-    for (size_t i = 0; i < a.size(); ++i) {
-        EXPECT_EQ(a[i], b[i]);
+    const auto first_a = std::ranges::begin(a);
+    const auto first_b = std::ranges::begin(b);
+    auto at_a = [&](size_t i) -> decltype(auto) { return first_a[static_cast<std::ptrdiff_t>(i)]; };
+    auto at_b = [&](size_t i) -> decltype(auto) { return first_b[static_cast<std::ptrdiff_t>(i)]; };
+
+    size_t mismatches = 0;
+    std::string listed;
+    for (size_t i = first; i < common; ++i) {
+        if (!(at_a(i) == at_b(i))) {
+            if (mismatches < kMaxReportedMismatches) {
+                listed += "\n  [" + std::to_string(i) + "] " + to_printable(at_a(i)) + " != " + to_printable(at_b(i));
+            }
+            ++mismatches;
+        }
+    }
+
+    std::string error = "[PSI-TEST] ranges differ";
+    if (size_a != size_b) {
+        error += ": sizes " + std::to_string(size_a) + " and " + std::to_string(size_b);
     }
+    error += "\n  " + std::to_string(mismatches) + " of " + std::to_string(common) + " compared elements mismatch";
+    if (mismatches) {
+        error += ", first at index " + std::to_string(first) + listed;
+        if (mismatches > kMaxReportedMismatches) {
+            error += "\n  ... " + std::to_string(mismatches - kMaxReportedMismatches) + " more";
+        }
+        const size_t from = first > kMismatchContext ? first - kMismatchContext : 0;
+        const size_t to = std::min(common, first + kMismatchContext + 1);
+        std::string window_a;
+        std::string window_b;
+        for (size_t i = from; i < to; ++i) {
+            window_a += (i == from ? "" : ", ") + to_printable(at_a(i));
+            window_b += (i == from ? "" : ", ") + to_printable(at_b(i));
+        }
+        error += "\n  window [" + std::to_string(from) + ", " + std::to_string(to) + "):";
+        error += "\n    arg1: " + window_a + "\n    arg2: " + window_b;
+    }
+    if (mismatches) {
+        test->fail_test(error, is_assert, location, assertion, to_printable(at_a(first)), to_printable(at_b(first)));
+    } else {
+        test->fail_test(error, is_assert, location, assertion, std::to_string(size_a), std::to_string(size_b));
+    }
+}
+
+} // namespace detail
+
+template <typename R1, typename R2>
+    requires detail::comparable_ranges<R1, R2>
+inline void EXPECT_EQ(const R1 &a, const R2 &b, const std::source_location &location = std::source_location::current())
+{
+    detail::compare_ranges(a, b, false, location, "EXPECT_EQ");
+}
+
+template <typename R1, typename R2>
+    requires detail::comparable_ranges<R1, R2>
+inline void ASSERT_EQ(const R1 &a, const R2 &b, const std::source_location &location = std::source_location::current())
+{
+    detail::compare_ranges(a, b, true, location, "ASSERT_EQ");
 }
 
 template <typename K1, typename V1, typename K2, typename V2>
     requires std::equality_comparable_with<K1, K2> && std::equality_comparable_with<V1, V2>
-inline void EXPECT_EQ(const std::map<K1, V1> &a, const std::map<K2, V2> &b)
+inline void EXPECT_EQ(const std::map<K1, V1> &a,
+                      const std::map<K2, V2> &b,
+                      const std::source_location &location = std::source_location::current())
 {
     auto test = TestLib::current_running_test();
 
     if (a.size() != b.size()) {
         if (test) {
-            test->fail_test("std::map<K1, V1> and std::map<K2, V2> sizes are not equal");
+            test->fail_test("std::map<K1, V1> and std::map<K2, V2> sizes are not equal",
+                            false,
+                            location,
+                            "EXPECT_EQ",
+                            std::to_string(a.size()),
+                            std::to_string(b.size()));
         }
         return;
     }
@@ -375,8 +565,8 @@ inline void EXPECT_EQ(const std::map<K1, V1> &a, const std::map<K2, V2> &b)
     auto it1 = a.begin();
     auto it2 = b.begin();
     while (it1 != a.end() && it2 != b.end()) {
-        EXPECT_EQ(it1->first, it2->first);
-        EXPECT_EQ(it1->second, it2->second);
+        EXPECT_EQ(it1->first, it2->first, location);
+        EXPECT_EQ(it1->second, it2->second, location);
         ++it1;
         ++it2;
     }
@@ -384,9 +574,10 @@ inline void EXPECT_EQ(const std::map<K1, V1> &a, const std::map<K2, V2> &b)
 
 template <typename R, typename... Args>
 inline FnExpectation<R, Args...> &EXPECT_CALL(std::shared_ptr<MockedFn<std::function<R(Args...)>>> fn,
-                                              int expected_calls_number)
+                                              int expected_calls_number,
+                                              const std::source_location &location = std::source_location::current())
 {
-    auto exp = std::make_shared<FnExpectation<R, Args...>>(expected_calls_number, fn);
+    auto exp = std::make_shared<FnExpectation<R, Args...>>(expected_calls_number, fn, location);
     auto exp_ptr = exp.get();
     if (auto ptr = TestLib::fn_expectations()) {
         ptr->emplace_back(std::move(exp));
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace psi::test {
+
+/// Statistical CPU profiler for --psi_profile. SIGPROF fires `hz` times per second of CPU time consumed by the
+/// process (setitimer ITIMER_PROF), interrupting whichever thread is running; the handler stores its stack and
+/// TestLib::current_running_test() in a preallocated ring that a background thread drains. POSIX systems with
+/// <execinfo.h> only.
+struct SamplingProfiler {
+    static bool supported();
+    /// False when unsupported, already running, or the timer cannot be set.
+    static bool start(int hz = 1000);
+    /// Stops the timer and collects the samples still in the ring.
+    static void stop();
+    static bool running();
+    /// Samples collected since the last write(), and those lost because the ring was full.
+    static size_t sample_count();
+    static size_t dropped_count();
+    /// Writes the samples as folded stacks ("Group.Name;outer;...;leaf count"), one section per test introduced by
+    /// a "# Group.Name: N samples" comment line, and clears them. Frames are named with dladdr, so functions
+    /// of the executable need -rdynamic (ENABLE_EXPORTS) and are shown as module+offset otherwise.
+    static bool write(const std::string &path);
+};
+
+} // namespace psi::test
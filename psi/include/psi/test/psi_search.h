@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace psi::test {
+
+/// Offset of the first occurrence of needle in haystack, npos if there is none. Candidates are found 16
+/// positions at a time by matching the needle's first and last bytes with SSE2 where available, and only
+/// those are compared in full.
+size_t find_substring(std::string_view haystack, std::string_view needle) noexcept;
+
+namespace detail {
+
+struct RegexInst {
+    enum class Op : uint8_t {
+        byte,
+        byte_class,
+        match,
+        jump,
+        split,
+        text_begin,
+        text_end,
+        word_boundary,
+        not_word_boundary,
+    };
+    Op m_op = Op::match;
+    uint8_t m_byte = 0;
+    uint32_t m_x = 0; // jump / split target, or class index
+    uint32_t m_y = 0; // second split target
+};
+
+/// Set of bytes, one bit each.
+struct ByteClass {
+    uint64_t m_bits[4] {};
+    void add(unsigned char c)
+    {
+        m_bits[c >> 6] |= uint64_t(1) << (c & 63);
+    }
+    bool contains(unsigned char c) const
+    {
+        return (m_bits[c >> 6] >> (c & 63)) & 1;
+    }
+};
+
+} // namespace detail
+
+/// Byte-oriented regular expression run as a Thompson NFA simulation (a Pike VM without capture slots):
+/// matching is linear in the text whatever the pattern, so there is no catastrophic backtracking.
+/// Syntax: literals, `.`, `[...]` / `[^...]` with ranges, `\d \w \s \D \W \S`, escapes, `^ $ \b \B`,
+/// `( )`, `(?: )`, `|`, `* + ?`, `{m}`, `{m,}`, `{m,n}` (lazy forms are accepted and match the same).
+/// Backreferences and lookaround are not supported.
+class Regex
+{
+public:
+    explicit Regex(std::string_view pattern);
+
+    /// Compiled once per pattern for the whole process; the reference stays valid. Thread-safe.
+    static const Regex &cached(std::string_view pattern);
+
+    bool valid() const
+    {
+        return m_error.empty();
+    }
+    const std::string &error() const
+    {
+        return m_error;
+    }
+    const std::string &pattern() const
+    {
+        return m_pattern;
+    }
+    /// True if the pattern matches somewhere in text (like std::regex_search). Does not allocate once the
+    /// calling thread has run a program of this size; false for an invalid pattern.
+    bool search(std::string_view text) const;
+
+private:
+    std::string m_pattern;
+    std::string m_error;
+    std::vector<detail::RegexInst> m_program;
+    std::vector<detail::ByteClass> m_classes;
+    /// Bytes every match starts with; used to skip to candidate positions with find_substring.
+    std::string m_prefix;
+    bool m_anchored = false;
+};
+
+} // namespace psi::test
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace psi::test {
+
+/// Resident mode: the test binary keeps its registry and static fixtures alive and runs requests sent over a
+/// local socket. A request is the list of command-line arguments of a normal run (filter, options); the
+/// server runs it through TestLib::run with stdout / stderr redirected to the connection, then sends a
+/// "[PSI-SERVE] exit N" trailer. Addresses have the form unix:/path. POSIX only.
+struct TestServer {
+    /// Accepts requests on address one at a time, forever, or until max_requests were served when non-zero.
+    /// Returns non-zero if the socket cannot be set up.
+    static int serve(const std::string &address, size_t max_requests = 0);
+    /// Sends args to the server at address and streams its output to stdout. Returns the run's exit code,
+    /// or 1 if the server cannot be reached.
+    static int request(const std::string &address, const std::vector<std::string> &args);
+};
+
+} // namespace psi::test
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <source_location>
+
+#include "psi/test/psi_test.h"
+
+namespace psi::test {
+
+/// What a STRESS_TEST body knows about the run it is part of.
+struct StressContext {
+    size_t m_thread_index = 0;
+    size_t m_threads = 0;
+    uint64_t m_iteration = 0;
+    /// Seeds the PSI_YIELD_POINT perturbations of this iteration on every thread.
+    uint64_t m_seed = 0;
+};
+
+/// Runs a body on a fixed pool of threads; each iteration releases all of them from a barrier at once and
+/// waits for all to finish. The first iteration that records a failure stops the run and is reported with its
+/// seed, also when the test had already failed before.
+/// Assertions may fail from any thread; MockedFn is not thread-safe and should only be used from one.
+struct StressRunner {
+    using Body = void (*)(const StressContext &ctx);
+
+    /// Returns the number of iterations run, including the failing one. Exceptions leaving the body are
+    /// reported at location.
+    static uint64_t run(size_t threads,
+                        uint64_t iterations,
+                        Body body,
+                        const std::source_location &location = std::source_location::current());
+    /// Seed used for every iteration instead of fresh ones (--psi_stress_seed), 0 picks random seeds.
+    static void set_replay_seed(uint64_t seed);
+    static uint64_t replay_seed();
+};
+
+namespace detail {
+
+/// Perturbs the calling thread's timing if it is running a stress iteration, does nothing otherwise.
+void stress_yield_point() noexcept;
+
+} // namespace detail
+
+/// STRESS_TEST(Group, Name, threads, iterations) { ... } runs its body on `threads` threads `iterations` times.
+/// The body sees the current StressContext as `ctx`.
+#define STRESS_TEST(test_group, test_name, threads, iterations)                                                        \
+    static void test_group##_##test_name##_stress_body(const psi::test::StressContext &ctx);                           \
+    TEST(test_group, test_name)                                                                                        \
+    {                                                                                                                  \
+        psi::test::StressRunner::run(threads, iterations, &test_group##_##test_name##_stress_body);                    \
+    }                                                                                                                  \
+    static void test_group##_##test_name##_stress_body([[maybe_unused]] const psi::test::StressContext &ctx)
+
+} // namespace psi::test
+
+/// PSI_YIELD_POINT() marks a spot in code under test where a STRESS_TEST may yield or spin for a while,
+/// chosen from the iteration seed. Outside a stress iteration it costs a thread-local check.
+/// Define PSI_DISABLE_YIELD_POINTS to compile the points out.
+#ifdef PSI_DISABLE_YIELD_POINTS
+#define PSI_YIELD_POINT() static_cast<void>(0)
+#else
+#define PSI_YIELD_POINT() ::psi::test::detail::stress_yield_point()
+#endif
@@ -1,15 +1,23 @@
 
 #pragma once
 
+#include <cstdint>
 #include <deque>
 #include <functional>
 #include <map>
 #include <memory>
 #include <optional>
+#include <source_location>
 #include <span>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <utility>
+#include <vector>
+
+#include "psi/test/psi_search.h"
+#include "psi/test/psi_zone.h"
 
 namespace psi::test {
 
@@ -53,6 +61,40 @@ private:
 
 using FnExpectationsList = std::vector<std::shared_ptr<IFnExpectation>>;
 
+class AsyncTask;
+
+namespace detail {
+
+/// Bump allocator for the strings of a test's failure records: a test failing in a loop fills a few
+/// large blocks instead of allocating one string per field per failure.
+class FailureArena
+{
+public:
+    std::string_view store(std::string_view s);
+    size_t bytes_used() const noexcept
+    {
+        return m_bytes_used;
+    }
+
+private:
+    static constexpr size_t kBlockSize = 64 * 1024;
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    char *m_block = nullptr;
+    size_t m_block_used = kBlockSize;
+    size_t m_bytes_used = 0;
+};
+
+/// UTF-8 encoding of a wide string (UTF-16 or UTF-32 depending on wchar_t); invalid units become U+FFFD.
+std::string to_utf8(std::wstring_view text);
+
+/// Text searched by a failed check is quoted whole up to this size, and as its head and tail beyond it.
+inline constexpr size_t kMaxExcerptBytes = 200;
+/// "text" in quotes, or for longer text "head" ... "tail" (N bytes) with about kMaxExcerptBytes / 2 bytes of
+/// each end, cut on UTF-8 character boundaries.
+std::string quote_excerpt(std::string_view text);
+
+} // namespace detail
+
 struct TestLib {
     static void init();
     static void destroy();
@@ -62,17 +104,33 @@ struct TestLib {
     static void verify_expectations();
     static void verify_and_clear_expectations();
 
+    /// One failed check. File names and expressions are interned for the whole run; the other strings live
+    /// in the test's failure arena. Unlocated failures (mock verification, budgets) have an empty m_file.
     struct TestFailure {
-        std::string m_file;
-        int m_line;
-        std::string m_expression;
-        std::string m_actual;
-        std::string m_expected;
+        std::string_view m_file;
+        int m_line = 0;
+        std::string_view m_expression;
+        std::string_view m_actual;
+        std::string_view m_expected;
+        std::string_view m_message;
+    };
+    /// Thrown by failing ASSERT_* checks to leave the test body.
+    struct AssertionFailure : std::runtime_error {
+        using std::runtime_error::runtime_error;
     };
     struct TestResult {
         std::string m_test_name;
         bool m_is_failed = false;
+        /// Passed in an earlier run with the same binary and inputs, not run (--psi_cache_dir).
+        bool m_cached = false;
         std::vector<TestFailure> m_failures;
+        size_t m_suppressed_failures = 0;
+        std::shared_ptr<detail::FailureArena> m_failure_arena;
+        long long m_time_ms = 0;
+        size_t m_heap_peak_bytes = 0;
+        int64_t m_rss_delta_bytes = 0;
+        size_t m_peak_rss_bytes = 0;
+        ZoneReport m_zones;
     };
     struct TestCase {
         std::string m_test_group;
@@ -80,26 +138,78 @@ struct TestLib {
         std::function<void()> m_fn;
         FnExpectationsList m_fn_expectations;
         TestResult m_test_result = {};
+        size_t m_max_heap_bytes = 0;
+        /// Coroutine body of an ASYNC_TEST (see psi_async.h); set instead of m_fn.
+        std::function<AsyncTask()> m_async_fn {};
+        /// Where the test is defined. Failures no check reports (uncaught exceptions, heap budget) point here.
+        std::source_location m_location {};
         void fail_test(const std::string &msg, bool is_assert = false);
+        /// Records the message as UTF-8.
         void fail_test(const std::wstring &msg, bool is_assert = false);
+        /// Structured failure of `assertion` called at location; actual / expected are clipped when recorded.
+        void fail_test(const std::string &msg,
+                       bool is_assert,
+                       const std::source_location &location,
+                       std::string_view assertion,
+                       std::string_view actual = {},
+                       std::string_view expected = {});
     };
     static void add_test(const TestCase &tc);
     static TestCase *current_running_test();
+    /// Runs fn with test as the running test, so that failing checks are recorded on it, silently, instead of
+    /// failing the caller; an ASSERT_* leaving fn is caught. For testing what assertions record.
+    static void run_as(TestCase &test, const std::function<void()> &fn);
+    /// Failures recorded per test before the rest are only counted (--psi_max_failures_per_test); 0 keeps all.
+    static size_t max_failures_per_test();
+    static void set_max_failures_per_test(size_t count);
+    /// Heap budget of the running test, overrides --psi_max_test_heap. 0 disables the check.
+    static void set_max_test_heap(size_t bytes);
 
     struct CmdOptions {
         std::string filter;
         bool list_tests = false;
         bool color = true;
         bool also_run_disabled = false;
+        std::string output_json {};
+        bool report_memory = false;
+        size_t max_test_heap = 0;
+        std::string trace_path {};
+        std::string bench_cpus {};
+        bool bench_high_priority = false;
+        size_t max_failures_per_test = 0;
+        bool capture_output = false;
+        size_t capture_output_keep = 32 * 1024;
+        uint64_t stress_seed = 0;
+        /// Async tests still running this long after their group started fail; 0 waits forever.
+        size_t async_timeout_ms = 60000;
+        std::string serve {};
+        std::string connect {};
+        /// With connect set, the other arguments, sent to the server as the request.
+        std::vector<std::string> connect_args {};
+        std::string coordinator {};
+        size_t spawn_workers = 0;
+        std::string worker {};
+        /// With coordinator set, the other arguments, sent to every worker.
+        std::vector<std::string> worker_args {};
+        std::string cache_dir {};
+        bool no_cache = false;
+        bool update_golden = false;
+        std::string profile_path {};
+        int profile_hz = 1000;
+        /// Malformed arguments; run() reports them and returns 1 without running anything.
+        std::vector<std::string> errors {};
     };
 
     static int run(const CmdOptions &opts);
     static CmdOptions parse_args(std::span<char *> argv);
+    /// Clears results, expectations and heap budgets of every registered test, for runs in a resident process.
+    static void reset_test_state();
 
 private:
     struct Tests {
         using TestsHolder = std::deque<std::vector<TestCase>>;
-        using TestsIndices = std::map<std::string, TestsHolder::reverse_iterator>;
+        /// Groups by name. Deque iterators are invalidated by emplace_back, references to elements are not.
+        using TestsIndices = std::map<std::string, std::vector<TestCase> *>;
         TestsHolder m_tests_list;
         TestsIndices m_tests_indices;
         size_t m_total_tests_number = 0;
@@ -109,19 +219,33 @@ private:
     static Tests get_filtered_tests(const std::string &filter, bool also_run_disabled = false);
     static void verify_expectations(TestCase &tc);
     static void verify_and_clear_expectations(TestCase &tc);
+    static bool run_test_case(TestCase &tc, const CmdOptions &opts);
+    /// Heap budgets and output capture do not apply to async tests (see the note in the implementation).
+    static int run_async_tests(const std::vector<TestCase *> &async_tests, const CmdOptions &opts);
+    static void print_run_header(const Tests &filtered);
+    /// Summary lines, JSON report and trace of a finished run.
+    static void report_run(const Tests &filtered, int failed, long long total_time, const CmdOptions &opts);
+    /// Runs the registered test Group.Name in place, leaving its result until reset_test_state(); false if there
+    /// is none.
+    static bool run_named_test(const std::string &full_name, const CmdOptions &opts, bool &failed);
 
 private:
     static Tests &tests();
     static TestCase *m_current_running_test;
+
+    friend struct AsyncExecutor;
+    friend struct DistributedRunner;
+    friend struct SelfBenchmark;
 };
 
 template <typename R, typename... Args>
 struct FnExpectation : public IFnExpectation {
     using Fn = MockedFn<std::function<R(Args...)>>;
 
-    FnExpectation(int expected_calls, std::shared_ptr<Fn> fn)
+    FnExpectation(int expected_calls, std::shared_ptr<Fn> fn, const std::source_location &location = {})
         : m_expected_calls(expected_calls)
         , m_function(fn)
+        , m_location(location)
     {
     }
 
@@ -142,6 +266,13 @@ struct FnExpectation : public IFnExpectation {
         return *this;
     }
 
+    /// Every call's string argument arg_index must match pattern (see Regex), compiled once per pattern.
+    FnExpectation &WithArgMatches(size_t arg_index, std::string_view pattern)
+    {
+        m_arg_matches_checks.emplace_back(arg_index, &Regex::cached(pattern));
+        return *this;
+    }
+
     void verify() const override
     {
         if (!m_function) {
@@ -155,11 +286,17 @@ struct FnExpectation : public IFnExpectation {
 
         if (!m_expected_calls_args.empty()) {
             if (m_function->m_calls.size() != m_expected_calls_args.size()) {
-                test->fail_test("[PSI-TEST] Args count mismatch");
+                test->fail_test("[PSI-TEST] Args count mismatch",
+                                false,
+                                m_location,
+                                "EXPECT_CALL",
+                                std::to_string(m_function->m_calls.size()),
+                                std::to_string(m_expected_calls_args.size()));
             } else {
                 for (size_t i = 0; i < m_expected_calls_args.size(); ++i) {
                     if (m_function->m_calls[i] != m_expected_calls_args[i]) {
-                        test->fail_test("[PSI-TEST] Args mismatch at call " + std::to_string(i));
+                        test->fail_test(
+                            "[PSI-TEST] Args mismatch at call " + std::to_string(i), false, m_location, "WithArgs");
                     }
                 }
             }
@@ -170,17 +307,57 @@ struct FnExpectation : public IFnExpectation {
                 for (const auto &[arg_index, substring] : m_arg_contains_checks) {
                     const auto str = get_string_arg(m_function->m_calls[call_i], arg_index);
                     if (!str.has_value()) {
-                        test->fail_test("[PSI-TEST] WithArgContains: arg " + std::to_string(arg_index) + " is not a string");
-                    } else if (str->find(substring) == std::string::npos) {
-                        test->fail_test("[PSI-TEST] WithArgContains: \"" + *str + "\" does not contain \"" + substring + "\"");
+                        test->fail_test("[PSI-TEST] WithArgContains: arg " + std::to_string(arg_index) + " is not a string",
+                                        false,
+                                        m_location,
+                                        "WithArgContains");
+                    } else if (find_substring(*str, substring) == std::string_view::npos) {
+                        test->fail_test("[PSI-TEST] WithArgContains: " + detail::quote_excerpt(*str) +
+                                            " does not contain \"" + substring + "\"",
+                                        false,
+                                        m_location,
+                                        "WithArgContains",
+                                        *str,
+                                        substring);
                     }
                 }
             }
         }
 
+        for (size_t call_i = 0; call_i < m_function->m_calls.size(); ++call_i) {
+            for (const auto &[arg_index, regex] : m_arg_matches_checks) {
+                const auto str = get_string_arg(m_function->m_calls[call_i], arg_index);
+                if (!str.has_value()) {
+                    test->fail_test("[PSI-TEST] WithArgMatches: arg " + std::to_string(arg_index) + " is not a string",
+                                    false,
+                                    m_location,
+                                    "WithArgMatches");
+                } else if (!regex->valid()) {
+                    test->fail_test("[PSI-TEST] WithArgMatches: invalid regex /" + regex->pattern()
+                                        + "/: " + regex->error(),
+                                    false,
+                                    m_location,
+                                    "WithArgMatches");
+                } else if (!regex->search(*str)) {
+                    test->fail_test("[PSI-TEST] WithArgMatches: " + detail::quote_excerpt(*str) + " does not match /"
+                                        + regex->pattern() + "/",
+                                    false,
+                                    m_location,
+                                    "WithArgMatches",
+                                    *str,
+                                    regex->pattern());
+                }
+            }
+        }
+
         if (m_expected_calls != m_function->m_calls_count) {
             test->fail_test("[PSI-TEST] m_expected_calls (" + std::to_string(m_expected_calls) +
-                            ") MUST be equal to m_function.m_calls_count (" + std::to_string(m_function->m_calls_count) + ")");
+                                ") MUST be equal to m_function.m_calls_count (" + std::to_string(m_function->m_calls_count) + ")",
+                            false,
+                            m_location,
+                            "EXPECT_CALL",
+                            std::to_string(m_function->m_calls_count),
+                            std::to_string(m_expected_calls));
         }
     }
 
@@ -195,16 +372,16 @@ struct FnExpectation : public IFnExpectation {
 
 private:
     template <typename Tuple>
-    static std::optional<std::string> get_string_arg(const Tuple &t, size_t index)
+    static std::optional<std::string_view> get_string_arg(const Tuple &t, size_t index)
     {
-        std::optional<std::string> result;
+        std::optional<std::string_view> result;
         size_t i = 0;
         std::apply(
             [&](const auto &...args) {
                 auto check = [&](const auto &arg) {
                     if (i == index) {
                         if constexpr (std::convertible_to<std::decay_t<decltype(arg)>, std::string_view>) {
-                            result = std::string(std::string_view(arg));
+                            result = std::string_view(arg);
                         }
                     }
                     ++i;
@@ -217,8 +394,10 @@ private:
 
     int m_expected_calls = 0;
     std::shared_ptr<Fn> m_function;
+    std::source_location m_location;
     std::vector<std::tuple<std::decay_t<Args>...>> m_expected_calls_args;
     std::vector<std::pair<size_t, std::string>> m_arg_contains_checks;
+    std::vector<std::pair<size_t, const Regex *>> m_arg_matches_checks;
 };
 
 template <typename R, typename... Args>
@@ -249,7 +428,9 @@ private:
     struct test_group##_##test_name##_registrar {                                                                      \
         test_group##_##test_name##_registrar()                                                                         \
         {                                                                                                              \
-            psi::test::TestLib::add_test({#test_group, #test_name, &test_group##_##test_name##_impl, {}});             \
+            psi::test::TestLib::TestCase tc {#test_group, #test_name, &test_group##_##test_name##_impl, {}};           \
+            tc.m_location = std::source_location::current();                                                           \
+            psi::test::TestLib::add_test(tc);                                                                          \
         }                                                                                                              \
     };                                                                                                                 \
     static test_group##_##test_name##_registrar test_group##_##test_name##_registrar_instance;                         \
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace psi::test {
+
+/// Records Chrome/Perfetto trace events ("ph": "X") into preallocated per-thread buffers.
+/// Names are stored as views and must stay alive until write() is called.
+struct TraceRecorder {
+    /// events_per_thread sizes the buffers of threads that record for the first time afterwards.
+    static void enable(size_t events_per_thread = 1 << 16);
+    static void disable();
+    static bool enabled();
+    static int64_t now_ns();
+    static void record(std::string_view category, std::string_view name, std::string_view name_suffix,
+                       int64_t start_ns, int64_t end_ns);
+    /// Writes all recorded events, and those added with add_events(), as trace-event JSON and clears them.
+    static bool write(const std::string &path);
+
+    /// Start of the now_ns() timeline on the steady clock, which processes of one host share.
+    static int64_t origin_ns();
+    /// Hands the recorded events over as ",\n"-separated trace-event objects of this process, with timestamps
+    /// moved by shift_ns onto another process's timeline, and clears the buffers.
+    static std::string take_events(int64_t shift_ns = 0);
+    /// Adds events taken from another process (e.g. a --psi_worker) to the next write().
+    static void add_events(std::string_view events);
+
+    struct Scope {
+        Scope(std::string_view category, std::string_view name, std::string_view name_suffix = {})
+            : m_category(category)
+            , m_name(name)
+            , m_name_suffix(name_suffix)
+            , m_start_ns(enabled() ? now_ns() : -1)
+        {
+        }
+        ~Scope()
+        {
+            if (m_start_ns >= 0) {
+                record(m_category, m_name, m_name_suffix, m_start_ns, now_ns());
+            }
+        }
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        std::string_view m_category;
+        std::string_view m_name;
+        std::string_view m_name_suffix;
+        int64_t m_start_ns;
+    };
+};
+
+} // namespace psi::test
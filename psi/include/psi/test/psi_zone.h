@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <string>
+
+namespace psi::test {
+
+struct ZoneStats {
+    uint64_t m_count = 0;
+    uint64_t m_total_ns = 0;
+    uint64_t m_max_ns = 0;
+
+    double mean_ns() const
+    {
+        return m_count ? static_cast<double>(m_total_ns) / static_cast<double>(m_count) : 0.0;
+    }
+};
+
+using ZoneReport = std::map<std::string, ZoneStats>;
+
+/// Collects PSI_ZONE timings. Every thread writes enter/exit timestamps into its own lock-free ring;
+/// the rings are drained into an aggregate that the runner resets at the start of each test.
+struct ZoneProfiler {
+    static int64_t now_ns() noexcept;
+    static void record(const char *name, int64_t start_ns, int64_t end_ns) noexcept;
+
+    /// Drops everything recorded so far.
+    static void reset();
+    /// Drains all thread rings and returns the aggregate since the last reset().
+    static ZoneReport snapshot();
+    /// Zones recorded between two snapshots. m_max_ns is taken from `after`.
+    static ZoneReport delta(const ZoneReport &after, const ZoneReport &before);
+    /// Events lost because a ring and its overflow table were full.
+    static uint64_t dropped();
+    static void print(std::ostream &os, const ZoneReport &report, const std::string &prefix);
+};
+
+struct ZoneScope {
+    explicit ZoneScope(const char *name) noexcept
+        : m_name(name)
+        , m_start_ns(ZoneProfiler::now_ns())
+    {
+    }
+    ~ZoneScope()
+    {
+        ZoneProfiler::record(m_name, m_start_ns, ZoneProfiler::now_ns());
+    }
+    ZoneScope(const ZoneScope &) = delete;
+    ZoneScope &operator=(const ZoneScope &) = delete;
+
+private:
+    const char *m_name;
+    int64_t m_start_ns;
+};
+
+} // namespace psi::test
+
+#define PSI_ZONE_CONCAT_IMPL(a, b) a##b
+#define PSI_ZONE_CONCAT(a, b) PSI_ZONE_CONCAT_IMPL(a, b)
+
+/// PSI_ZONE("name") times the enclosing scope. It compiles to nothing unless PSI_ENABLE_ZONES is defined.
+/// `name` must be a string literal (or otherwise outlive the test).
+#ifdef PSI_ENABLE_ZONES
+#define PSI_ZONE(name) const ::psi::test::ZoneScope PSI_ZONE_CONCAT(psi_zone_, __LINE__)(name)
+#else
+#define PSI_ZONE(name) static_cast<void>(0)
+#endif
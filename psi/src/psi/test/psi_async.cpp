@@ -0,0 +1,250 @@
+#include "psi/test/psi_async.h"
+
+#include "psi/test/psi_trace.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <format>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace psi::test {
+
+namespace {
+
+struct Entry {
+    std::coroutine_handle<> m_handle;
+    TestLib::TestCase *m_test = nullptr;
+};
+
+struct Timer {
+    AsyncExecutor::Clock::time_point m_deadline;
+    uint64_t m_seq = 0;
+    Entry m_entry;
+
+    bool operator>(const Timer &other) const noexcept
+    {
+        return m_deadline != other.m_deadline ? m_deadline > other.m_deadline : m_seq > other.m_seq;
+    }
+};
+
+struct Poll {
+    std::function<bool()> m_ready;
+    Entry m_entry;
+};
+
+struct ExecutorState {
+    // Read by post() on other threads.
+    std::atomic<std::thread::id> m_thread;
+    std::atomic<bool> m_running {false};
+    std::deque<Entry> m_ready;
+    /// Unfinished AsyncTask frames (test bodies and the tasks they await) and the test they belong to.
+    std::unordered_map<void *, TestLib::TestCase *> m_frames;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<>> m_timers;
+    uint64_t m_timer_seq = 0;
+    std::vector<Poll> m_polls;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::vector<Entry> m_injected;
+};
+
+ExecutorState &state()
+{
+    static auto *s = new ExecutorState();
+    return *s;
+}
+
+/// Futures complete without telling the executor, so pending polls bound how long it sleeps.
+constexpr auto kPollInterval = std::chrono::microseconds(200);
+constexpr auto kIdleWait = std::chrono::milliseconds(100);
+
+bool on_executor_thread(const ExecutorState &s)
+{
+    return s.m_running.load() && std::this_thread::get_id() == s.m_thread.load();
+}
+
+} // namespace
+
+void AsyncExecutor::post(std::coroutine_handle<> h)
+{
+    auto &s = state();
+    if (on_executor_thread(s)) {
+        s.m_ready.push_back({h, TestLib::current_running_test()});
+        return;
+    }
+    // The current test is the executor's; the owner of h is looked up when it is resumed.
+    {
+        std::lock_guard lock(s.m_mutex);
+        s.m_injected.push_back({h, nullptr});
+    }
+    s.m_wakeup.notify_one();
+}
+
+void AsyncExecutor::track_task(std::coroutine_handle<> h)
+{
+    auto &s = state();
+    if (on_executor_thread(s)) {
+        s.m_frames[h.address()] = TestLib::current_running_test();
+    }
+}
+
+void AsyncExecutor::untrack_task(std::coroutine_handle<> h)
+{
+    auto &s = state();
+    if (on_executor_thread(s)) {
+        s.m_frames.erase(h.address());
+    }
+}
+
+void AsyncExecutor::post_at(Clock::time_point deadline, std::coroutine_handle<> h)
+{
+    auto &s = state();
+    s.m_timers.push({deadline, s.m_timer_seq++, {h, TestLib::current_running_test()}});
+}
+
+void AsyncExecutor::post_when(std::function<bool()> ready, std::coroutine_handle<> h)
+{
+    state().m_polls.push_back({std::move(ready), {h, TestLib::current_running_test()}});
+}
+
+void AsyncExecutor::run(std::span<TestLib::TestCase *const> tests, const DoneFn &on_done, Clock::duration timeout)
+{
+    auto &s = state();
+    s.m_thread = std::this_thread::get_id();
+    s.m_running = true;
+
+    struct Root {
+        AsyncTask::Handle m_handle;
+        int64_t m_trace_start_ns = -1;
+    };
+    std::unordered_map<TestLib::TestCase *, Root> roots;
+    const auto deadline = timeout > Clock::duration::zero() ? Clock::now() + timeout : Clock::time_point::max();
+    for (auto *test : tests) {
+        const auto root = test->m_async_fn().release();
+        roots.emplace(test, Root {root, TraceRecorder::enabled() ? TraceRecorder::now_ns() : -1});
+        s.m_frames[root.address()] = test;
+        s.m_ready.push_back({root, test});
+    }
+
+    auto complete = [&](TestLib::TestCase *test, std::exception_ptr error) {
+        const auto trace_start_ns = roots.at(test).m_trace_start_ns;
+        roots.erase(test);
+        TestLib::m_current_running_test = test;
+        on_done(*test, error);
+        if (trace_start_ns >= 0) {
+            TraceRecorder::record(
+                "test", test->m_test_group, test->m_test_name, trace_start_ns, TraceRecorder::now_ns());
+        }
+    };
+    auto finish_if_done = [&](TestLib::TestCase *test) {
+        const auto it = roots.find(test);
+        if (it == roots.end() || !it->second.m_handle.done()) {
+            return;
+        }
+        const auto root = it->second.m_handle;
+        complete(test, root.promise().m_exception);
+        root.destroy();
+    };
+    auto resume = [&](Entry entry) {
+        if (!entry.m_test) {
+            const auto frame = s.m_frames.find(entry.m_handle.address());
+            entry.m_test = frame != s.m_frames.end() ? frame->second : nullptr;
+        }
+        TestLib::m_current_running_test = entry.m_test;
+        entry.m_handle.resume();
+        if (entry.m_test) {
+            finish_if_done(entry.m_test);
+        } else {
+            // Unknown coroutine type: whichever test it completed is found by checking them all.
+            std::vector<TestLib::TestCase *> done;
+            for (const auto &[test, root] : roots) {
+                if (root.m_handle.done()) {
+                    done.push_back(test);
+                }
+            }
+            for (auto *test : done) {
+                finish_if_done(test);
+            }
+        }
+        TestLib::m_current_running_test = nullptr;
+    };
+
+    while (!roots.empty()) {
+        {
+            std::lock_guard lock(s.m_mutex);
+            s.m_ready.insert(s.m_ready.end(), s.m_injected.begin(), s.m_injected.end());
+            s.m_injected.clear();
+        }
+        const auto now = Clock::now();
+        if (now >= deadline) {
+            // The tests started together, so they all ran out of time. Their coroutines are abandoned rather
+            // than destroyed: a callback on another thread may still hold one of their handles.
+            std::vector<TestLib::TestCase *> late;
+            for (const auto &[test, root] : roots) {
+                late.push_back(test);
+            }
+            for (auto *test : late) {
+                TestLib::m_current_running_test = test;
+                test->fail_test(std::format("[PSI-TEST] async test did not finish within {} ms",
+                                            std::chrono::duration_cast<std::chrono::milliseconds>(timeout).count()),
+                                false,
+                                test->m_location,
+                                "ASYNC_TEST");
+                complete(test, nullptr);
+            }
+            TestLib::m_current_running_test = nullptr;
+            break;
+        }
+        while (!s.m_timers.empty() && s.m_timers.top().m_deadline <= now) {
+            s.m_ready.push_back(s.m_timers.top().m_entry);
+            s.m_timers.pop();
+        }
+        for (size_t i = 0; i < s.m_polls.size();) {
+            if (s.m_polls[i].m_ready()) {
+                s.m_ready.push_back(s.m_polls[i].m_entry);
+                s.m_polls[i] = std::move(s.m_polls.back());
+                s.m_polls.pop_back();
+            } else {
+                ++i;
+            }
+        }
+
+        if (s.m_ready.empty()) {
+            auto wake_at = std::min(now + kIdleWait, deadline);
+            if (!s.m_polls.empty()) {
+                wake_at = std::min(wake_at, now + kPollInterval);
+            }
+            if (!s.m_timers.empty()) {
+                wake_at = std::min(wake_at, s.m_timers.top().m_deadline);
+            }
+            std::unique_lock lock(s.m_mutex);
+            s.m_wakeup.wait_until(lock, wake_at, [&] { return !s.m_injected.empty(); });
+            continue;
+        }
+
+        // Entries posted while draining run in the next round, after timers and polls had their turn.
+        for (auto n = s.m_ready.size(); n > 0; --n) {
+            const auto entry = s.m_ready.front();
+            s.m_ready.pop_front();
+            resume(entry);
+        }
+    }
+
+    // Anything left belongs to abandoned tests.
+    s.m_ready.clear();
+    s.m_timers = {};
+    s.m_polls.clear();
+    {
+        std::lock_guard lock(s.m_mutex);
+        s.m_injected.clear();
+    }
+    s.m_frames.clear();
+    s.m_running = false;
+}
+
+} // namespace psi::test
@@ -0,0 +1,915 @@
+#include "psi/test/psi_bench.h"
+
+#include "psi/test/psi_test.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <utility>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PSI_BENCH_SSE2
+#endif
+
+namespace psi::test {
+
+std::vector<int64_t> BenchRange::dense(int64_t from, int64_t to, int64_t step)
+{
+    std::vector<int64_t> result;
+    for (auto v = from; v <= to && step > 0; v += step) {
+        result.push_back(v);
+    }
+    return result;
+}
+
+std::vector<int64_t> BenchRange::linear(int64_t from, int64_t to, int count)
+{
+    std::vector<int64_t> result;
+    if (count <= 1) {
+        result.push_back(from);
+        return result;
+    }
+    for (int i = 0; i < count; ++i) {
+        const auto v = from + static_cast<int64_t>(std::llround(static_cast<double>(to - from) * i / (count - 1)));
+        if (result.empty() || result.back() != v) {
+            result.push_back(v);
+        }
+    }
+    return result;
+}
+
+std::vector<int64_t> BenchRange::pow2(int64_t from, int64_t to)
+{
+    std::vector<int64_t> result;
+    for (auto v = std::max<int64_t>(from, 1); v < to; v *= 2) {
+        result.push_back(v);
+    }
+    result.push_back(to);
+    return result;
+}
+
+std::vector<std::vector<int64_t>> BenchRange::product(const std::vector<std::vector<int64_t>> &ranges)
+{
+    std::vector<std::vector<int64_t>> result {{}};
+    for (const auto &range : ranges) {
+        std::vector<std::vector<int64_t>> next;
+        next.reserve(result.size() * range.size());
+        for (const auto &prefix : result) {
+            for (const auto v : range) {
+                next.push_back(prefix);
+                next.back().push_back(v);
+            }
+        }
+        result = std::move(next);
+    }
+    return result;
+}
+
+const char *to_string(Complexity complexity)
+{
+    switch (complexity) {
+    case Complexity::O1:
+        return "O(1)";
+    case Complexity::OLogN:
+        return "O(log n)";
+    case Complexity::ON:
+        return "O(n)";
+    case Complexity::ONLogN:
+        return "O(n log n)";
+    case Complexity::ON2:
+        return "O(n^2)";
+    }
+    return "O(?)";
+}
+
+ComplexityFit fit_complexity(const std::vector<int64_t> &n, const std::vector<double> &ns)
+{
+    static constexpr Complexity kCandidates[] = {
+        Complexity::O1, Complexity::OLogN, Complexity::ON, Complexity::ONLogN, Complexity::ON2};
+    auto f = [](Complexity c, double x) {
+        switch (c) {
+        case Complexity::O1:
+            return 1.0;
+        case Complexity::OLogN:
+            return std::log2(std::max(x, 2.0));
+        case Complexity::ON:
+            return x;
+        case Complexity::ONLogN:
+            return x * std::log2(std::max(x, 2.0));
+        case Complexity::ON2:
+            return x * x;
+        }
+        return 1.0;
+    };
+
+    ComplexityFit best;
+    best.m_rms = INFINITY;
+    const auto count = std::min(n.size(), ns.size());
+    if (!count) {
+        return best;
+    }
+    double mean = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        mean += ns[i];
+    }
+    mean /= static_cast<double>(count);
+
+    for (const auto c : kCandidates) {
+        double fx_t = 0.0;
+        double fx_fx = 0.0;
+        for (size_t i = 0; i < count; ++i) {
+            const auto fx = f(c, static_cast<double>(n[i]));
+            fx_t += fx * ns[i];
+            fx_fx += fx * fx;
+        }
+        const auto coefficient = fx_fx > 0.0 ? fx_t / fx_fx : 0.0;
+        double sq = 0.0;
+        for (size_t i = 0; i < count; ++i) {
+            const auto residual = ns[i] - coefficient * f(c, static_cast<double>(n[i]));
+            sq += residual * residual;
+        }
+        const auto rms = mean > 0.0 ? std::sqrt(sq / static_cast<double>(count)) / mean : 0.0;
+        // Prefer the simpler class unless the more complex one is clearly better.
+        if (rms < best.m_rms * 0.9) {
+            best = {c, coefficient, rms};
+        }
+    }
+    return best;
+}
+
+namespace {
+
+[[maybe_unused]] std::string read_sysfs(const std::string &path)
+{
+    std::ifstream in(path);
+    std::string value;
+    std::getline(in, value);
+    return value;
+}
+
+constexpr size_t kCacheLineBytes = 64;
+constexpr size_t kDefaultLastLevelCacheBytes = 32 << 20;
+
+/// "32768K", "8M" or plain bytes, as in /sys/devices/system/cpu/cpu0/cache/index*/size.
+[[maybe_unused]] size_t parse_cache_size(const std::string &text)
+{
+    char *end = nullptr;
+    const auto value = static_cast<size_t>(std::strtoull(text.c_str(), &end, 10));
+    switch (end ? *end : '\0') {
+    case 'K':
+        return value << 10;
+    case 'M':
+        return value << 20;
+    case 'G':
+        return value << 30;
+    default:
+        return value;
+    }
+}
+
+size_t detect_last_level_cache_bytes()
+{
+    size_t bytes = 0;
+#if defined(_WIN32)
+    DWORD length = 0;
+    ::GetLogicalProcessorInformation(nullptr, &length);
+    std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+    if (!info.empty() && ::GetLogicalProcessorInformation(info.data(), &length)) {
+        int level = 0;
+        for (const auto &i : info) {
+            if (i.Relationship == RelationCache && i.Cache.Level >= level) {
+                level = i.Cache.Level;
+                bytes = i.Cache.Size;
+            }
+        }
+    }
+#elif defined(__linux__)
+    int level = 0;
+    for (int index = 0; index < 16; ++index) {
+        const auto dir = std::format("/sys/devices/system/cpu/cpu0/cache/index{}/", index);
+        const auto level_text = read_sysfs(dir + "level");
+        if (level_text.empty()) {
+            break;
+        }
+        if (read_sysfs(dir + "type") != "Instruction" && std::atoi(level_text.c_str()) >= level) {
+            level = std::atoi(level_text.c_str());
+            bytes = parse_cache_size(read_sysfs(dir + "size"));
+        }
+    }
+#if defined(_SC_LEVEL3_CACHE_SIZE)
+    if (!bytes) {
+        bytes = static_cast<size_t>(std::max(0L, sysconf(_SC_LEVEL3_CACHE_SIZE)));
+    }
+#endif
+#elif defined(__APPLE__)
+    for (const char *name : {"hw.l3cachesize", "hw.l2cachesize"}) {
+        int64_t value = 0;
+        size_t size = sizeof(value);
+        if (!bytes && sysctlbyname(name, &value, &size, nullptr, 0) == 0 && value > 0) {
+            bytes = static_cast<size_t>(value);
+        }
+    }
+#endif
+    return bytes ? bytes : kDefaultLastLevelCacheBytes;
+}
+
+std::mutex s_pollute_mutex;
+std::vector<unsigned char> *s_pollute_buffer = nullptr;
+volatile unsigned char s_pollute_sink = 0;
+
+std::mutex s_environment_mutex;
+std::optional<BenchEnvironment> s_environment;
+bool s_environment_printed = false;
+// What stabilize_environment() changed, saved the first time it changes it.
+#if defined(_WIN32)
+std::optional<DWORD_PTR> s_saved_affinity;
+std::optional<DWORD> s_saved_priority_class;
+// Affinity masks address the 64 CPUs of the process's processor group.
+constexpr int kMaxAffinityCpus = 64;
+#elif defined(__linux__)
+std::optional<cpu_set_t> s_saved_affinity;
+std::optional<int> s_saved_nice;
+#endif
+
+BenchEnvironment read_environment(bool high_priority)
+{
+    BenchEnvironment env;
+    env.m_high_priority = high_priority;
+    env.m_online_cpus = static_cast<int>(std::thread::hardware_concurrency());
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(static_cast<size_t>(cpu), &set)) {
+                env.m_cpus.push_back(cpu);
+            }
+        }
+    }
+    const int first_cpu = env.m_cpus.empty() ? 0 : env.m_cpus.front();
+    env.m_governor = read_sysfs(std::format("/sys/devices/system/cpu/cpu{}/cpufreq/scaling_governor", first_cpu));
+    if (const auto no_turbo = read_sysfs("/sys/devices/system/cpu/intel_pstate/no_turbo"); !no_turbo.empty()) {
+        env.m_turbo = no_turbo == "0";
+    } else if (const auto boost = read_sysfs("/sys/devices/system/cpu/cpufreq/boost"); !boost.empty()) {
+        env.m_turbo = boost == "1";
+    }
+    if (const auto smt = read_sysfs("/sys/devices/system/cpu/smt/active"); !smt.empty()) {
+        env.m_smt = smt == "1";
+    }
+#endif
+    if (!env.m_governor.empty() && env.m_governor != "performance") {
+        env.m_warnings.push_back("cpufreq governor is '" + env.m_governor + "', use 'performance'");
+    }
+    if (env.m_turbo.value_or(false)) {
+        env.m_warnings.push_back("turbo boost is enabled");
+    }
+    if (env.m_smt.value_or(false) && !env.m_cpus.empty() && env.m_cpus.size() == static_cast<size_t>(env.m_online_cpus)) {
+        env.m_warnings.push_back("SMT is active and the process is not pinned");
+    }
+    if (!high_priority) {
+        env.m_notes.push_back("normal scheduling priority, --psi_bench_high_priority raises it");
+    }
+    return env;
+}
+
+std::string format_cpu_list(const std::vector<int> &cpus)
+{
+    std::string result;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+            ++j;
+        }
+        if (!result.empty()) {
+            result += ',';
+        }
+        result += j > i ? std::format("{}-{}", cpus[i], cpus[j]) : std::to_string(cpus[i]);
+        i = j + 1;
+    }
+    return result.empty() ? "?" : result;
+}
+
+std::string format_environment(const BenchEnvironment &env)
+{
+    auto tri_state = [](const std::optional<bool> &v) { return v ? (*v ? "on" : "off") : "?"; };
+    return std::format("cpus={} of {} governor={} turbo={} smt={} priority={}",
+                       format_cpu_list(env.m_cpus),
+                       env.m_online_cpus,
+                       env.m_governor.empty() ? "?" : env.m_governor,
+                       tri_state(env.m_turbo),
+                       tri_state(env.m_smt),
+                       env.m_high_priority ? "high" : "normal");
+}
+
+} // namespace
+
+const BenchEnvironment &probe_environment()
+{
+    std::lock_guard lock(s_environment_mutex);
+    if (!s_environment) {
+        s_environment = read_environment(false);
+    }
+    return *s_environment;
+}
+
+const BenchEnvironment &stabilize_environment(const StabilizeOptions &opts)
+{
+    bool high_priority = false;
+    std::vector<std::string> errors;
+    std::lock_guard lock(s_environment_mutex);
+#if defined(_WIN32)
+    if (!opts.cpus.empty()) {
+        DWORD_PTR mask = 0;
+        for (const auto cpu : opts.cpus) {
+            if (cpu < 0 || cpu >= kMaxAffinityCpus) {
+                errors.push_back(std::format("CPU {} is outside the process's processor group, ignored", cpu));
+                continue;
+            }
+            mask |= DWORD_PTR(1) << cpu;
+        }
+        DWORD_PTR process_mask = 0;
+        DWORD_PTR system_mask = 0;
+        if (!s_saved_affinity && GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) {
+            s_saved_affinity = process_mask;
+        }
+        if (mask && !SetProcessAffinityMask(GetCurrentProcess(), mask)) {
+            errors.push_back("SetProcessAffinityMask failed");
+        }
+    }
+    if (opts.raise_priority) {
+        if (!s_saved_priority_class) {
+            s_saved_priority_class = GetPriorityClass(GetCurrentProcess());
+        }
+        high_priority = SetPriorityClass(GetCurrentProcess(), HIGH_PRIORITY_CLASS) != 0;
+    }
+#elif defined(__linux__)
+    if (!opts.cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (const auto cpu : opts.cpus) {
+            if (cpu < 0 || cpu >= CPU_SETSIZE) {
+                errors.push_back(std::format("CPU {} is outside the affinity mask, ignored", cpu));
+                continue;
+            }
+            CPU_SET(static_cast<size_t>(cpu), &set);
+        }
+        cpu_set_t current;
+        if (!s_saved_affinity && sched_getaffinity(0, sizeof(current), &current) == 0) {
+            s_saved_affinity = current;
+        }
+        // Threads created afterwards inherit the calling thread's mask.
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            errors.push_back("sched_setaffinity failed");
+        }
+    }
+    if (opts.raise_priority) {
+        // -1 is a valid nice value, so failure shows in errno only.
+        errno = 0;
+        const int nice = getpriority(PRIO_PROCESS, 0);
+        if (!s_saved_nice && errno == 0) {
+            s_saved_nice = nice;
+        }
+        high_priority = setpriority(PRIO_PROCESS, 0, -10) == 0;
+    }
+#endif
+    s_environment = read_environment(high_priority);
+    s_environment->m_warnings.insert(s_environment->m_warnings.end(), errors.begin(), errors.end());
+    s_environment_printed = false;
+    return *s_environment;
+}
+
+void restore_environment()
+{
+    std::lock_guard lock(s_environment_mutex);
+#if defined(_WIN32)
+    if (s_saved_affinity) {
+        SetProcessAffinityMask(GetCurrentProcess(), *s_saved_affinity);
+    }
+    if (s_saved_priority_class) {
+        SetPriorityClass(GetCurrentProcess(), *s_saved_priority_class);
+    }
+    s_saved_affinity.reset();
+    s_saved_priority_class.reset();
+#elif defined(__linux__)
+    if (s_saved_affinity) {
+        sched_setaffinity(0, sizeof(*s_saved_affinity), &*s_saved_affinity);
+    }
+    if (s_saved_nice) {
+        // Lowering the priority back needs no privilege.
+        setpriority(PRIO_PROCESS, 0, *s_saved_nice);
+    }
+    s_saved_affinity.reset();
+    s_saved_nice.reset();
+#endif
+    s_environment.reset();
+    s_environment_printed = false;
+}
+
+void print_environment(std::ostream &os, const BenchEnvironment &env)
+{
+    os << "[env] " << format_environment(env) << "\n";
+    for (const auto &warning : env.m_warnings) {
+        os << "[env] WARNING: " << warning << "\n";
+    }
+    for (const auto &note : env.m_notes) {
+        os << "[env] note: " << note << "\n";
+    }
+}
+
+void print_environment_once(std::ostream &os)
+{
+    const auto &env = probe_environment();
+    {
+        std::lock_guard lock(s_environment_mutex);
+        if (std::exchange(s_environment_printed, true)) {
+            return;
+        }
+    }
+    print_environment(os, env);
+}
+
+void print_environment_line(std::ostream &os, const std::string &name)
+{
+    print_environment_once(os);
+    const auto &env = probe_environment();
+    const auto warnings = env.m_warnings.size();
+    os << std::format("[{}] env: {}{}\n",
+                      name,
+                      format_environment(env),
+                      warnings ? std::format(" ({} warning{})", warnings, warnings == 1 ? "" : "s") : "");
+}
+
+std::vector<int> parse_cpu_list(const std::string &list)
+{
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        const auto dash = item.find('-');
+        const int first = std::atoi(item.substr(0, dash).c_str());
+        const int last = dash == std::string::npos ? first : std::atoi(item.substr(dash + 1).c_str());
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+size_t last_level_cache_bytes()
+{
+    static const size_t s_bytes = detect_last_level_cache_bytes();
+    return s_bytes;
+}
+
+} // namespace psi::test
+
+namespace psi::test::detail {
+
+StableMeasurement summarize_samples(std::vector<double> samples)
+{
+    StableMeasurement m;
+    if (samples.empty()) {
+        return m;
+    }
+    double mean = 0.0;
+    for (const auto v : samples) {
+        mean += v;
+    }
+    mean /= static_cast<double>(samples.size());
+    double variance = 0.0;
+    for (const auto v : samples) {
+        variance += (v - mean) * (v - mean);
+    }
+    if (samples.size() > 1) {
+        variance /= static_cast<double>(samples.size() - 1);
+    }
+    m.m_cv = mean > 0.0 ? std::sqrt(variance) / mean : 0.0;
+    std::sort(samples.begin(), samples.end());
+    const auto mid = samples.size() / 2;
+    m.m_ns_per_call = samples.size() % 2 ? samples[mid] : (samples[mid - 1] + samples[mid]) / 2.0;
+    return m;
+}
+
+ChunkedTiming summarize_chunks(double total_ns, uint64_t calls, std::vector<double> chunk_means, double max_cv)
+{
+    ChunkedTiming t;
+    t.m_ns_per_call = total_ns / static_cast<double>(std::max<uint64_t>(calls, 1));
+    t.m_cv = summarize_samples(std::move(chunk_means)).m_cv;
+    t.m_noisy = t.m_cv > max_cv;
+    return t;
+}
+
+std::string format_noise(double cv, bool noisy)
+{
+    return std::format(" +-{:.1f}%{}", cv * 100.0, noisy ? " [NOISY]" : "");
+}
+
+void report_sweep(std::ostream &os,
+                  const std::string &name,
+                  const std::vector<SweepResult> &results,
+                  const SweepOptions &opts,
+                  const std::source_location &location)
+{
+    for (const auto &r : results) {
+        std::string label = name;
+        for (const auto a : r.m_args) {
+            label += '/' + std::to_string(a);
+        }
+        os << std::format("[{}] {:.3f} ns/call +-{:.1f}% ({} iterations{}){}\n",
+                          label,
+                          r.m_ns_per_call,
+                          r.m_cv * 100.0,
+                          r.m_iterations,
+                          r.m_reruns ? std::format(", {} reruns", r.m_reruns) : "",
+                          r.m_noisy ? " [NOISY]" : "");
+    }
+    if (!opts.fit_complexity || results.size() < 3) {
+        return;
+    }
+    std::vector<int64_t> n;
+    std::vector<double> ns;
+    for (const auto &r : results) {
+        if (r.m_args.empty()) {
+            return;
+        }
+        n.push_back(r.m_args.front());
+        ns.push_back(r.m_ns_per_call);
+    }
+    const auto fit = fit_complexity(n, ns);
+    os << std::format("[{}] complexity: {} coefficient={:.4f} ns rms={:.1f}%\n",
+                      name,
+                      to_string(fit.m_complexity),
+                      fit.m_coefficient,
+                      fit.m_rms * 100.0);
+    if (opts.max_complexity && fit.m_complexity > *opts.max_complexity) {
+        const auto error = std::format("[PSI-TEST] {} scales as {}, expected at most {}",
+                                       name,
+                                       to_string(fit.m_complexity),
+                                       to_string(*opts.max_complexity));
+        if (auto test = TestLib::current_running_test()) {
+            test->fail_test(error, false, location, "timeFn_sweep");
+        } else {
+            os << error << "\n";
+        }
+    }
+}
+
+bool pin_current_thread(int cpu)
+{
+    if (cpu < 0) {
+        return false;
+    }
+#if defined(_WIN32)
+    if (cpu >= kMaxAffinityCpus) {
+        static std::once_flag s_warned;
+        std::call_once(s_warned, [cpu]() {
+            std::cerr << "[PSI-TEST] cannot pin to CPU " << cpu << ": outside the process's processor group\n";
+        });
+        return false;
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(static_cast<size_t>(cpu), &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+std::vector<int> throughput_thread_counts(const ThroughputOptions &opts)
+{
+    if (!opts.thread_counts.empty()) {
+        return opts.thread_counts;
+    }
+    const int max_threads = std::max(1, opts.max_threads);
+    std::vector<int> counts;
+    for (int n = 1; n < max_threads; n *= 2) {
+        counts.push_back(n);
+    }
+    counts.push_back(max_threads);
+    return counts;
+}
+
+ThroughputResult make_throughput_result(int threads,
+                                        const std::vector<PaddedCounter> &ops,
+                                        double seconds,
+                                        const ThroughputResult *baseline)
+{
+    ThroughputResult r;
+    r.m_threads = threads;
+    r.m_seconds = seconds;
+    uint64_t total = 0;
+    uint64_t min_ops = UINT64_MAX;
+    uint64_t max_ops = 0;
+    for (const auto &c : ops) {
+        r.m_ops_per_thread.push_back(c.m_value);
+        total += c.m_value;
+        min_ops = std::min(min_ops, c.m_value);
+        max_ops = std::max(max_ops, c.m_value);
+    }
+    r.m_ops_per_sec = seconds > 0.0 ? static_cast<double>(total) / seconds : 0.0;
+    r.m_fairness = max_ops ? static_cast<double>(min_ops) / static_cast<double>(max_ops) : 0.0;
+    if (!baseline) {
+        r.m_efficiency = 1.0;
+    } else if (baseline->m_ops_per_sec > 0.0) {
+        const auto base_per_thread = baseline->m_ops_per_sec / baseline->m_threads;
+        r.m_efficiency = r.m_ops_per_sec / threads / base_per_thread;
+    }
+    return r;
+}
+
+void print_throughput(std::ostream &os, const std::string &name, const std::vector<ThroughputResult> &results)
+{
+    os << std::format("[{}] {:>7} {:>14} {:>14} {:>9} {:>10} {:>7}\n",
+                      name,
+                      "threads",
+                      "ops/s",
+                      "ops/s/thread",
+                      "fairness",
+                      "efficiency",
+                      "cv");
+    for (const auto &r : results) {
+        os << std::format("[{}] {:>7} {:>14.0f} {:>14.0f} {:>9.3f} {:>9.1f}% {:>6.1f}%{}\n",
+                          name,
+                          r.m_threads,
+                          r.m_ops_per_sec,
+                          r.m_ops_per_sec / r.m_threads,
+                          r.m_fairness,
+                          r.m_efficiency * 100.0,
+                          r.m_cv * 100.0,
+                          r.m_noisy ? " [NOISY]" : "");
+    }
+}
+
+void pollute_caches(size_t bytes)
+{
+    std::lock_guard lock(s_pollute_mutex);
+    if (!s_pollute_buffer) {
+        s_pollute_buffer = new std::vector<unsigned char>();
+    }
+    if (s_pollute_buffer->size() < bytes) {
+        s_pollute_buffer->resize(bytes);
+    }
+    // Writing as well as reading leaves every line dirty in this buffer, so the evicted data is gone from
+    // all levels and the next access by fn also pays for the write-backs, as after real unrelated work.
+    unsigned char acc = 0;
+    auto *data = s_pollute_buffer->data();
+    for (size_t i = 0; i < bytes; i += kCacheLineBytes) {
+        acc = static_cast<unsigned char>(acc + data[i]);
+        data[i] = static_cast<unsigned char>(acc + 1);
+    }
+    s_pollute_sink = acc;
+}
+
+void flush_cache_lines(const void *data, size_t size)
+{
+#ifdef PSI_BENCH_SSE2
+    if (!data || !size) {
+        return;
+    }
+    const auto begin = reinterpret_cast<uintptr_t>(data) & ~uintptr_t(kCacheLineBytes - 1);
+    const auto end = reinterpret_cast<uintptr_t>(data) + size;
+    for (auto line = begin; line < end; line += kCacheLineBytes) {
+        _mm_clflush(reinterpret_cast<const void *>(line));
+    }
+    _mm_mfence();
+#else
+    static_cast<void>(data);
+    static_cast<void>(size);
+#endif
+}
+
+CacheModeResult summarize_cache_samples(std::vector<double> samples, double max_cv)
+{
+    CacheModeResult r;
+    if (samples.empty()) {
+        return r;
+    }
+    double sum = 0.0;
+    std::vector<double> chunk_means;
+    for (uint64_t c = 0; c < kNoiseChunks; ++c) {
+        const auto begin = chunk_begin(c, samples.size());
+        const auto end = chunk_begin(c + 1, samples.size());
+        if (begin == end) {
+            continue;
+        }
+        double chunk_sum = 0.0;
+        for (auto i = begin; i < end; ++i) {
+            chunk_sum += samples[i];
+        }
+        sum += chunk_sum;
+        chunk_means.push_back(chunk_sum / static_cast<double>(end - begin));
+    }
+    const auto noise = summarize_chunks(sum, samples.size(), std::move(chunk_means), max_cv);
+    r.m_mean_ns = noise.m_ns_per_call;
+    r.m_cv = noise.m_cv;
+    r.m_noisy = noise.m_noisy;
+    std::sort(samples.begin(), samples.end());
+    r.m_median_ns = samples[samples.size() / 2];
+    r.m_p90_ns = samples[std::min(samples.size() - 1, samples.size() * 9 / 10)];
+    return r;
+}
+
+void print_cache_comparison(std::ostream &os, const std::string &name, const CacheComparison &result,
+                            const CacheOptions &opts)
+{
+    auto mib = [](size_t bytes) { return std::format("{:.0f}M", static_cast<double>(bytes) / (1 << 20)); };
+    auto row = [&](const std::string &mode, const CacheModeResult &r) {
+        const auto base = result.m_warm.m_median_ns;
+        os << std::format("[{}] {:<26} {:>12.3f} {:>12.3f} {:>12.3f} {:>8.2f}x{}\n",
+                          name,
+                          mode,
+                          r.m_mean_ns,
+                          r.m_median_ns,
+                          r.m_p90_ns,
+                          base > 0.0 ? r.m_median_ns / base : 0.0,
+                          format_noise(r.m_cv, r.m_noisy));
+    };
+    os << std::format("[{}] {:<26} {:>12} {:>12} {:>12} {:>9}\n", name, "cache", "mean ns", "p50 ns", "p90 ns",
+                      "p50/warm");
+    row("warm", result.m_warm);
+    row(std::format("cold (flush {}{})",
+                    mib(result.m_flush_bytes),
+                    opts.flush_ranges.empty() ? "" : std::format(" +{} ranges", opts.flush_ranges.size())),
+        result.m_flushed);
+    if (result.m_rotated) {
+        row(std::format("cold ({} copies)", opts.input_copies), *result.m_rotated);
+    }
+}
+
+uint64_t ab_seed(const AbOptions &opts)
+{
+    if (opts.seed) {
+        return opts.seed;
+    }
+    std::random_device rd;
+    return (static_cast<uint64_t>(rd()) << 32) | rd() | 1;
+}
+
+MannWhitney mann_whitney_u(const std::vector<double> &a, const std::vector<double> &b)
+{
+    MannWhitney r;
+    const auto na = static_cast<double>(a.size());
+    const auto nb = static_cast<double>(b.size());
+    if (a.empty() || b.empty()) {
+        return r;
+    }
+    std::vector<std::pair<double, bool>> all; // value, from a
+    all.reserve(a.size() + b.size());
+    for (const auto v : a) {
+        all.emplace_back(v, true);
+    }
+    for (const auto v : b) {
+        all.emplace_back(v, false);
+    }
+    std::sort(all.begin(), all.end(), [](const auto &x, const auto &y) { return x.first < y.first; });
+
+    // Tied values share their average rank; tie groups shrink the variance of U.
+    double rank_sum_a = 0.0;
+    double tie_term = 0.0;
+    for (size_t i = 0; i < all.size();) {
+        size_t j = i;
+        while (j + 1 < all.size() && all[j + 1].first == all[i].first) {
+            ++j;
+        }
+        const auto rank = static_cast<double>(i + j) / 2.0 + 1.0;
+        const auto ties = static_cast<double>(j - i + 1);
+        for (size_t k = i; k <= j; ++k) {
+            if (all[k].second) {
+                rank_sum_a += rank;
+            }
+        }
+        tie_term += ties * ties * ties - ties;
+        i = j + 1;
+    }
+    const auto n = na + nb;
+    r.m_u = rank_sum_a - na * (na + 1.0) / 2.0;
+    const auto variance = na * nb / 12.0 * ((n + 1.0) - tie_term / (n * (n - 1.0)));
+    if (variance <= 0.0) {
+        return r;
+    }
+    const auto z = std::max(0.0, std::abs(r.m_u - na * nb / 2.0) - 0.5) / std::sqrt(variance);
+    r.m_p_value = std::min(1.0, std::erfc(z / std::sqrt(2.0)));
+    return r;
+}
+
+std::pair<double, double> median_confidence_interval(std::vector<double> samples, double confidence)
+{
+    if (samples.empty()) {
+        return {0.0, 0.0};
+    }
+    std::sort(samples.begin(), samples.end());
+    const auto n = samples.size();
+    // Largest k with P(Binomial(n, 1/2) < k) <= (1 - confidence) / 2: [x(k), x(n + 1 - k)], 1-based.
+    const double tail = (1.0 - confidence) / 2.0;
+    const auto log_half_n = static_cast<double>(n) * std::log(0.5);
+    double cumulative = 0.0;
+    size_t k = 0;
+    for (size_t i = 0; i <= n / 2; ++i) {
+        const auto dn = static_cast<double>(n);
+        const auto di = static_cast<double>(i);
+        cumulative += std::exp(std::lgamma(dn + 1.0) - std::lgamma(di + 1.0) - std::lgamma(dn - di + 1.0) + log_half_n);
+        if (cumulative > tail) {
+            break;
+        }
+        k = i + 1;
+    }
+    k = std::clamp<size_t>(k, 1, (n + 1) / 2);
+    return {samples[k - 1], samples[n - k]};
+}
+
+void analyze_ab(AbResult &result, const AbOptions &opts)
+{
+    result.m_a_cv = summarize_samples(result.m_a_ns).m_cv;
+    result.m_b_cv = summarize_samples(result.m_b_ns).m_cv;
+    result.m_noisy = std::max(result.m_a_cv, result.m_b_cv) > opts.max_cv;
+    std::vector<double> ratios;
+    for (size_t i = 0; i < std::min(result.m_a_ns.size(), result.m_b_ns.size()); ++i) {
+        if (result.m_b_ns[i] > 0.0) {
+            ratios.push_back(result.m_a_ns[i] / result.m_b_ns[i]);
+        }
+    }
+    if (ratios.empty()) {
+        return;
+    }
+    const auto [low, high] = median_confidence_interval(ratios, opts.confidence);
+    result.m_ci_low = low;
+    result.m_ci_high = high;
+    std::sort(ratios.begin(), ratios.end());
+    const auto mid = ratios.size() / 2;
+    result.m_speedup = ratios.size() % 2 ? ratios[mid] : (ratios[mid - 1] + ratios[mid]) / 2.0;
+    const auto test = mann_whitney_u(result.m_a_ns, result.m_b_ns);
+    result.m_u = test.m_u;
+    result.m_p_value = test.m_p_value;
+    result.m_significant = test.m_p_value < 1.0 - opts.confidence && (low > 1.0 || high < 1.0);
+}
+
+void report_ab(std::ostream &os,
+               const std::string &name,
+               const AbResult &result,
+               const AbOptions &opts,
+               const std::source_location &location)
+{
+    auto median = [](std::vector<double> v) {
+        std::sort(v.begin(), v.end());
+        return v.empty() ? 0.0 : v[v.size() / 2];
+    };
+    os << std::format("[{}] A: {:.3f} ns/call{}, B: {:.3f} ns/call{} (median of {} interleaved rounds, {} calls "
+                      "each, seed {}){}\n",
+                      name,
+                      median(result.m_a_ns),
+                      format_noise(result.m_a_cv, false),
+                      median(result.m_b_ns),
+                      format_noise(result.m_b_cv, false),
+                      result.m_a_ns.size(),
+                      result.m_a_iterations,
+                      result.m_seed,
+                      result.m_noisy ? " [NOISY]" : "");
+    const auto verdict = !result.m_significant ? std::string("no significant difference")
+                         : result.m_speedup > 1.0 ? "B is faster"
+                                                  : "B is slower";
+    os << std::format("[{}] speedup A/B {:.3f}x, {:.0f}% CI [{:.3f}, {:.3f}], Mann-Whitney U={:.0f} p={:.4f}: {}\n",
+                      name,
+                      result.m_speedup,
+                      opts.confidence * 100.0,
+                      result.m_ci_low,
+                      result.m_ci_high,
+                      result.m_u,
+                      result.m_p_value,
+                      verdict);
+    if (opts.require_b_faster && !(result.m_significant && result.m_speedup > 1.0)) {
+        const auto error = std::format("[PSI-TEST] {}: B is not significantly faster than A ({})", name, verdict);
+        if (auto test = TestLib::current_running_test()) {
+            test->fail_test(error, false, location, "AB_BENCHMARK");
+        } else {
+            os << error << "\n";
+        }
+    }
+}
+
+} // namespace psi::test::detail
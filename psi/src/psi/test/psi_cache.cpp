@@ -0,0 +1,231 @@
+#include "psi/test/psi_cache.h"
+
+#include "psi_executable.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+
+namespace psi::test {
+
+namespace {
+
+constexpr uint64_t kPrime1 = 0x9e3779b97f4a7c15ull;
+constexpr uint64_t kPrime2 = 0xc2b2ae3d27d4eb4full;
+constexpr uint64_t kPrime3 = 0xff51afd7ed558ccdull;
+
+uint64_t rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+uint64_t fmix64(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= kPrime3;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+/// Streaming two-lane hash over 8-byte words; inputs are fed in arbitrary pieces.
+class Hasher
+{
+public:
+    void update(const void *data, size_t size)
+    {
+        auto *p = static_cast<const unsigned char *>(data);
+        m_size += size;
+        while (size > 0 && m_tail_size > 0) {
+            m_tail[m_tail_size++] = *p++;
+            --size;
+            if (m_tail_size == 8) {
+                mix(load(m_tail));
+                m_tail_size = 0;
+            }
+        }
+        for (; size >= 8; p += 8, size -= 8) {
+            mix(load(p));
+        }
+        std::memcpy(m_tail + m_tail_size, p, size);
+        m_tail_size += size;
+    }
+    void update(std::string_view s)
+    {
+        update(s.data(), s.size());
+        update("\0", 1); // separator, so ("ab", "c") and ("a", "bc") differ
+    }
+
+    std::string hex()
+    {
+        uint64_t last = m_size;
+        for (size_t i = 0; i < m_tail_size; ++i) {
+            last ^= static_cast<uint64_t>(m_tail[i]) << (8 * i);
+        }
+        mix(last);
+        const auto a = fmix64(m_a + m_b);
+        const auto b = fmix64(m_b ^ rotl(m_a, 17));
+        return std::format("{:016x}{:016x}", a, b);
+    }
+
+private:
+    static uint64_t load(const unsigned char *p)
+    {
+        uint64_t w;
+        std::memcpy(&w, p, 8);
+        return w;
+    }
+    void mix(uint64_t w)
+    {
+        m_a = rotl(m_a ^ (w * kPrime2), 31) * kPrime1;
+        m_b = rotl(m_b + w, 27) * kPrime3 + m_a;
+    }
+
+    uint64_t m_a = kPrime1;
+    uint64_t m_b = kPrime2;
+    uint64_t m_size = 0;
+    unsigned char m_tail[8] {};
+    size_t m_tail_size = 0;
+};
+
+/// Content hash of the file at path, nullopt if it cannot be read.
+std::optional<std::string> hash_file(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return std::nullopt;
+    }
+    Hasher hasher;
+    std::vector<char> buf(1 << 20);
+    while (in) {
+        in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+        hasher.update(buf.data(), static_cast<size_t>(in.gcount()));
+    }
+    return hasher.hex();
+}
+
+struct CacheState {
+    std::filesystem::path m_dir;
+    std::string m_extra_key;
+    std::optional<std::string> m_binary_hash;
+    std::map<std::string, std::vector<std::string>> m_inputs;
+};
+
+CacheState &state()
+{
+    static auto *s = new CacheState();
+    return *s;
+}
+
+std::filesystem::path entry_path(const std::string &key)
+{
+    return state().m_dir / key.substr(0, 2) / key;
+}
+
+} // namespace
+
+std::string hash_hex(const void *data, size_t size)
+{
+    Hasher hasher;
+    hasher.update(data, size);
+    return hasher.hex();
+}
+
+void ResultCache::declare_inputs(const std::string &full_name, std::initializer_list<const char *> paths)
+{
+    auto &inputs = state().m_inputs[full_name];
+    inputs.insert(inputs.end(), paths.begin(), paths.end());
+}
+
+bool ResultCache::open(const std::string &dir, const std::string &extra_key)
+{
+    auto &s = state();
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        std::cerr << "[PSI-TEST] cannot create cache directory " << dir << ": " << ec.message() << std::endl;
+        return false;
+    }
+    if (!s.m_binary_hash) {
+        const auto exe = detail::self_executable();
+        s.m_binary_hash = exe.empty() ? std::nullopt : hash_file(exe);
+        if (!s.m_binary_hash) {
+            std::cerr << "[PSI-TEST] cannot read the test binary, result cache disabled" << std::endl;
+            return false;
+        }
+    }
+    s.m_dir = dir;
+    s.m_extra_key = extra_key;
+    return true;
+}
+
+void ResultCache::close()
+{
+    state().m_dir.clear();
+}
+
+bool ResultCache::enabled()
+{
+    return !state().m_dir.empty();
+}
+
+std::string ResultCache::key(const std::string &full_name)
+{
+    auto &s = state();
+    Hasher hasher;
+    hasher.update(*s.m_binary_hash);
+    hasher.update(full_name);
+    hasher.update(s.m_extra_key);
+    if (const auto it = s.m_inputs.find(full_name); it != s.m_inputs.end()) {
+        for (const auto &path : it->second) {
+            hasher.update(path);
+            hasher.update(hash_file(path).value_or("<missing>"));
+        }
+    }
+    return hasher.hex();
+}
+
+bool ResultCache::has_pass(const std::string &key, const std::string &full_name)
+{
+    std::ifstream in(entry_path(key));
+    std::string verdict;
+    std::string name;
+    long long time_ms = 0;
+    // The name guards against key collisions.
+    return in >> verdict >> time_ms && std::getline(in >> std::ws, name) && verdict == "pass" && name == full_name;
+}
+
+void ResultCache::store_pass(const std::string &key, const std::string &full_name, long long time_ms)
+{
+    static std::atomic<uint64_t> s_counter {0};
+    static const auto s_token = std::random_device {}();
+    const auto path = entry_path(key);
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    auto tmp = path;
+    tmp += std::format(".tmp.{:x}.{}", s_token, s_counter++);
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << "pass " << time_ms << "\n" << full_name << "\n";
+        if (!out.flush()) {
+            out.close();
+            std::filesystem::remove(tmp, ec);
+            return;
+        }
+    }
+    // Readers see either no entry or a complete one; concurrent writers of the same key write the same verdict.
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+    }
+}
+
+} // namespace psi::test
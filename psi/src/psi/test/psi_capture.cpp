@@ -0,0 +1,258 @@
+#include "psi/test/psi_capture.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace psi::test {
+
+namespace {
+
+#if defined(_WIN32)
+int fd_dup(int fd)
+{
+    return _dup(fd);
+}
+int fd_dup2(int from, int to)
+{
+    return _dup2(from, to);
+}
+int fd_close(int fd)
+{
+    return _close(fd);
+}
+int fd_pipe(int fds[2])
+{
+    return _pipe(fds, 64 * 1024, _O_BINARY | _O_NOINHERIT);
+}
+long long fd_read(int fd, char *buf, size_t size)
+{
+    return _read(fd, buf, static_cast<unsigned>(size));
+}
+long long fd_write(int fd, const char *buf, size_t size)
+{
+    return _write(fd, buf, static_cast<unsigned>(size));
+}
+#else
+int fd_dup(int fd)
+{
+    return ::dup(fd);
+}
+int fd_dup2(int from, int to)
+{
+    return ::dup2(from, to);
+}
+int fd_close(int fd)
+{
+    return ::close(fd);
+}
+int fd_pipe(int fds[2])
+{
+    if (::pipe(fds) != 0) {
+        return -1;
+    }
+    // Only fd 1 and 2 are for child processes of the test; the copies made by dup2 are inheritable.
+    ::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    ::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return 0;
+}
+long long fd_read(int fd, char *buf, size_t size)
+{
+    return ::read(fd, buf, size);
+}
+long long fd_write(int fd, const char *buf, size_t size)
+{
+    return ::write(fd, buf, size);
+}
+#endif
+
+constexpr int kStdout = 1;
+constexpr int kStderr = 2;
+
+struct CaptureState {
+    bool m_active = false;
+    int m_saved_out = -1;
+    int m_saved_err = -1;
+    int m_read_fd = -1;
+    std::thread m_reader;
+    std::atomic<bool> m_stopping {false};
+
+    // Written by the reader thread only, read after it is joined. Both buffers are sized by start(), so a
+    // test printing in a loop allocates nothing and the capture never holds more than 2 * keep bytes.
+    size_t m_keep = 0;
+    std::string m_head;
+    /// The last m_keep bytes after the head, as a ring: byte i of the stream past the head is at i % m_keep.
+    std::string m_tail;
+    unsigned long long m_total = 0;
+};
+
+CaptureState &state()
+{
+    static CaptureState s;
+    return s;
+}
+
+void flush_all()
+{
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(stdout);
+    std::fflush(stderr);
+}
+
+void close_saved(CaptureState &s)
+{
+    for (int *fd : {&s.m_saved_out, &s.m_saved_err}) {
+        if (*fd >= 0) {
+            fd_close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+void append_kept(CaptureState &s, const char *data, size_t size)
+{
+    const auto head = std::min(size, s.m_keep - s.m_head.size());
+    s.m_head.append(data, head);
+    for (size_t i = head; i < size && s.m_keep; ++i) {
+        s.m_tail[(s.m_total + i - s.m_keep) % s.m_keep] = data[i];
+    }
+    s.m_total += size;
+}
+
+/// Drains the pipe until every write end is closed. After stop() a child process of the test may still hold
+/// one; then the reader gives up once the pipe has been idle for a poll interval.
+void read_pipe(CaptureState &s)
+{
+    char buf[16384];
+    for (;;) {
+#if !defined(_WIN32)
+        pollfd pfd {s.m_read_fd, POLLIN, 0};
+        const int ready = ::poll(&pfd, 1, 50);
+        if (ready == 0) {
+            if (s.m_stopping.load(std::memory_order_acquire)) {
+                return;
+            }
+            continue;
+        }
+#endif
+        const auto n = fd_read(s.m_read_fd, buf, sizeof(buf));
+        if (n == 0) {
+            return;
+        }
+        if (n < 0) {
+#if !defined(_WIN32)
+            if (errno == EINTR) {
+                continue;
+            }
+#endif
+            return;
+        }
+        append_kept(s, buf, static_cast<size_t>(n));
+    }
+}
+
+} // namespace
+
+bool OutputCapture::start(size_t keep_bytes)
+{
+    auto &s = state();
+    if (s.m_active) {
+        return false;
+    }
+    flush_all();
+    // Duplicated on every start: fd 1 and 2 may point elsewhere between captures (a --psi_serve connection).
+    s.m_saved_out = fd_dup(kStdout);
+    s.m_saved_err = fd_dup(kStderr);
+    int fds[2] = {-1, -1};
+    if (s.m_saved_out < 0 || s.m_saved_err < 0 || fd_pipe(fds) != 0) {
+        close_saved(s);
+        return false;
+    }
+    s.m_read_fd = fds[0];
+    s.m_keep = keep_bytes;
+    s.m_head.clear();
+    s.m_head.reserve(keep_bytes);
+    s.m_tail.assign(keep_bytes, '\0');
+    s.m_total = 0;
+    s.m_stopping.store(false);
+    s.m_reader = std::thread([&s]() { read_pipe(s); });
+
+    fd_dup2(fds[1], kStdout);
+    fd_dup2(fds[1], kStderr);
+    fd_close(fds[1]);
+    s.m_active = true;
+    return true;
+}
+
+std::string OutputCapture::stop()
+{
+    auto &s = state();
+    if (!s.m_active) {
+        return {};
+    }
+    flush_all();
+    // Restoring fd 1 and 2 closes the last write ends the runner holds, so the reader sees end of file.
+    fd_dup2(s.m_saved_out, kStdout);
+    fd_dup2(s.m_saved_err, kStderr);
+    close_saved(s);
+    s.m_stopping.store(true, std::memory_order_release);
+    s.m_reader.join();
+    fd_close(s.m_read_fd);
+    s.m_read_fd = -1;
+    s.m_active = false;
+
+    std::string out = s.m_head;
+    const auto past_head = s.m_total - s.m_head.size();
+    if (past_head == 0) {
+        return out;
+    }
+    if (past_head <= s.m_keep) {
+        out.append(s.m_tail, 0, static_cast<size_t>(past_head));
+        return out;
+    }
+    out += out.ends_with('\n') ? "" : "\n";
+    out += "[PSI-TEST] ... " + std::to_string(past_head - s.m_keep) + " bytes of output omitted ...\n";
+    if (s.m_keep) {
+        // The oldest byte of the tail is the one the next write would have overwritten.
+        const auto oldest = static_cast<size_t>(past_head % s.m_keep);
+        out.append(s.m_tail, oldest);
+        out.append(s.m_tail, 0, oldest);
+    }
+    return out;
+}
+
+bool OutputCapture::active()
+{
+    return state().m_active;
+}
+
+void OutputCapture::write_runner(std::string_view text)
+{
+    const auto &s = state();
+    if (!s.m_active) {
+        std::cout << text << std::flush;
+        return;
+    }
+    while (!text.empty()) {
+        const auto n = fd_write(s.m_saved_out, text.data(), text.size());
+        if (n <= 0) {
+            break;
+        }
+        text.remove_prefix(static_cast<size_t>(n));
+    }
+}
+
+} // namespace psi::test
@@ -0,0 +1,147 @@
+#include "psi/test/psi_clock.h"
+
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace psi::test {
+
+namespace {
+
+using TimerKey = std::pair<FakeClock::time_point, FakeClock::TimerId>;
+
+struct ClockState {
+    std::mutex m_mutex;
+    FakeClock::time_point m_now {};
+    FakeClock::TimerId m_next_id = 1;
+    /// Ordered by deadline, then by scheduling order, so equal deadlines fire first-scheduled first.
+    std::map<TimerKey, std::function<void()>> m_timers;
+    std::unordered_map<FakeClock::TimerId, FakeClock::time_point> m_deadlines;
+};
+
+ClockState &state()
+{
+    static auto *s = new ClockState();
+    return *s;
+}
+
+/// Pops the earliest timer due at or before limit and moves time to its deadline. The callback runs
+/// without the lock held, so it may schedule or cancel timers.
+bool fire_next(FakeClock::time_point limit)
+{
+    auto &s = state();
+    std::function<void()> fn;
+    {
+        std::lock_guard lock(s.m_mutex);
+        if (s.m_timers.empty() || s.m_timers.begin()->first.first > limit) {
+            return false;
+        }
+        auto node = s.m_timers.extract(s.m_timers.begin());
+        s.m_deadlines.erase(node.key().second);
+        s.m_now = std::max(s.m_now, node.key().first);
+        fn = std::move(node.mapped());
+    }
+    fn();
+    return true;
+}
+
+} // namespace
+
+FakeClock::time_point FakeClock::now() noexcept
+{
+    auto &s = state();
+    std::lock_guard lock(s.m_mutex);
+    return s.m_now;
+}
+
+FakeClock::TimerId FakeClock::schedule_at(time_point deadline, std::function<void()> fn)
+{
+    auto &s = state();
+    std::lock_guard lock(s.m_mutex);
+    const auto id = s.m_next_id++;
+    s.m_timers.emplace(TimerKey {deadline, id}, std::move(fn));
+    s.m_deadlines.emplace(id, deadline);
+    return id;
+}
+
+FakeClock::TimerId FakeClock::schedule_after(duration delay, std::function<void()> fn)
+{
+    return schedule_at(now() + delay, std::move(fn));
+}
+
+bool FakeClock::cancel(TimerId id)
+{
+    auto &s = state();
+    std::lock_guard lock(s.m_mutex);
+    const auto it = s.m_deadlines.find(id);
+    if (it == s.m_deadlines.end()) {
+        return false;
+    }
+    s.m_timers.erase({it->second, id});
+    s.m_deadlines.erase(it);
+    return true;
+}
+
+size_t FakeClock::advance(duration delta)
+{
+    const auto target = now() + delta;
+    size_t fired = 0;
+    while (fire_next(target)) {
+        ++fired;
+    }
+    auto &s = state();
+    std::lock_guard lock(s.m_mutex);
+    s.m_now = std::max(s.m_now, target);
+    return fired;
+}
+
+bool FakeClock::advance_to_next()
+{
+    const auto deadline = next_deadline();
+    if (!deadline) {
+        return false;
+    }
+    // Timers scheduled in the past by now fire at the current time rather than moving it backwards.
+    advance(std::max(*deadline - now(), duration::zero()));
+    return true;
+}
+
+size_t FakeClock::run_all(size_t max_timers)
+{
+    size_t fired = 0;
+    while (fired < max_timers && fire_next(time_point::max())) {
+        ++fired;
+    }
+    return fired;
+}
+
+std::optional<FakeClock::time_point> FakeClock::next_deadline()
+{
+    auto &s = state();
+    std::lock_guard lock(s.m_mutex);
+    if (s.m_timers.empty()) {
+        return std::nullopt;
+    }
+    return s.m_timers.begin()->first.first;
+}
+
+size_t FakeClock::pending_timers()
+{
+    auto &s = state();
+    std::lock_guard lock(s.m_mutex);
+    return s.m_timers.size();
+}
+
+void FakeClock::reset()
+{
+    auto &s = state();
+    decltype(s.m_timers) timers; // destroyed after unlocking, callbacks may own mocks and other state
+    {
+        std::lock_guard lock(s.m_mutex);
+        timers.swap(s.m_timers);
+        s.m_deadlines.clear();
+        s.m_now = {};
+    }
+}
+
+} // namespace psi::test
@@ -0,0 +1,398 @@
+#include "psi/test/psi_diff.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "psi/test/psi_mock.h"
+
+namespace psi::test {
+
+namespace {
+
+constexpr size_t kBinaryProbeBytes = 8000;
+constexpr size_t kShortValueBytes = 120;
+
+struct Line {
+    std::string_view m_text;
+    uint64_t m_hash = 0;
+};
+
+inline bool operator==(const Line &a, const Line &b) noexcept
+{
+    return a.m_hash == b.m_hash && a.m_text == b.m_text;
+}
+
+uint64_t fnv1a(std::string_view s) noexcept
+{
+    uint64_t h = 1469598103934665603ull;
+    for (const char c : s) {
+        h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    return h;
+}
+
+/// Splits text into at most max_lines lines (each keeps its '\n'). Sets truncated when lines were left out.
+std::vector<Line> split_lines(std::string_view text, size_t max_lines, bool &truncated)
+{
+    std::vector<Line> lines;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        if (lines.size() == max_lines) {
+            truncated = true;
+            break;
+        }
+        const size_t nl = text.find('\n', pos);
+        const size_t end = nl == std::string_view::npos ? text.size() : nl + 1;
+        const auto line = text.substr(pos, end - pos);
+        lines.push_back({line, fnv1a(line)});
+        pos = end;
+    }
+    return lines;
+}
+
+enum class EditKind : char { keep = ' ', remove = '-', insert = '+' };
+
+struct Edit {
+    EditKind m_kind;
+    uint32_t m_a;
+    uint32_t m_b;
+};
+
+/// Myers' O((N + M) D) diff. Keeps one V slice per edit distance for the backtrack, so memory is
+/// O(D^2) and bounded by max_edits. Returns false when the distance is larger.
+bool myers_diff(const std::vector<Line> &a, const std::vector<Line> &b, size_t max_edits, std::vector<Edit> &script)
+{
+    const auto n = static_cast<int64_t>(a.size());
+    const auto m = static_cast<int64_t>(b.size());
+    const auto max_d = std::min<int64_t>(n + m, static_cast<int64_t>(max_edits));
+    const int64_t offset = max_d + 1;
+    std::vector<int32_t> v(static_cast<size_t>(2 * max_d + 3), 0);
+    std::vector<int32_t> trace;
+    std::vector<size_t> trace_start;
+
+    auto at = [&](std::vector<int32_t> &vec, int64_t k) -> int32_t & { return vec[static_cast<size_t>(k + offset)]; };
+
+    int64_t found_d = -1;
+    for (int64_t d = 0; d <= max_d && found_d < 0; ++d) {
+        trace_start.push_back(trace.size());
+        for (int64_t k = -d; k <= d; ++k) {
+            trace.push_back(at(v, k));
+        }
+        for (int64_t k = -d; k <= d; k += 2) {
+            int64_t x = (k == -d || (k != d && at(v, k - 1) < at(v, k + 1))) ? at(v, k + 1) : at(v, k - 1) + 1;
+            int64_t y = x - k;
+            while (x < n && y < m && a[static_cast<size_t>(x)] == b[static_cast<size_t>(y)]) {
+                ++x;
+                ++y;
+            }
+            at(v, k) = static_cast<int32_t>(x);
+            if (x >= n && y >= m) {
+                found_d = d;
+                break;
+            }
+        }
+    }
+    if (found_d < 0) {
+        return false;
+    }
+
+    script.clear();
+    int64_t x = n;
+    int64_t y = m;
+    for (int64_t d = found_d; d >= 0; --d) {
+        const int32_t *snapshot = trace.data() + trace_start[static_cast<size_t>(d)];
+        auto prev = [&](int64_t k) { return static_cast<int64_t>(snapshot[k + d]); };
+        const int64_t k = x - y;
+        int64_t prev_k = 0;
+        if (d > 0) {
+            prev_k = (k == -d || (k != d && prev(k - 1) < prev(k + 1))) ? k + 1 : k - 1;
+        }
+        const int64_t prev_x = d > 0 ? prev(prev_k) : 0;
+        const int64_t prev_y = prev_x - prev_k;
+        while (x > prev_x && y > prev_y) {
+            --x;
+            --y;
+            script.push_back({EditKind::keep, static_cast<uint32_t>(x), static_cast<uint32_t>(y)});
+        }
+        if (d > 0) {
+            if (x == prev_x) {
+                script.push_back({EditKind::insert, static_cast<uint32_t>(x), static_cast<uint32_t>(prev_y)});
+            } else {
+                script.push_back({EditKind::remove, static_cast<uint32_t>(prev_x), static_cast<uint32_t>(y)});
+            }
+        }
+        x = prev_x;
+        y = prev_y;
+    }
+    std::reverse(script.begin(), script.end());
+    return true;
+}
+
+/// One output line: escapes control characters and clips to width, centered on focus when it is set.
+std::string render_line(std::string_view line, size_t width, size_t focus = std::string_view::npos)
+{
+    if (!line.empty() && line.back() == '\n') {
+        line.remove_suffix(1);
+    }
+    std::string prefix;
+    std::string suffix;
+    if (line.size() > width) {
+        size_t from = 0;
+        if (focus != std::string_view::npos && focus > width / 2) {
+            from = std::min(focus - width / 2, line.size() - width);
+            prefix = "...";
+        }
+        if (from + width < line.size()) {
+            suffix = "...";
+        }
+        line = line.substr(from, width);
+    }
+    std::string out = prefix;
+    out.reserve(line.size() + 6);
+    for (const char c : line) {
+        const auto uc = static_cast<unsigned char>(c);
+        if (c == '\t') {
+            out += "\\t";
+        } else if (c == '\r') {
+            out += "\\r";
+        } else if (uc < 0x20 || uc == 0x7f) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\x%02x", uc);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out + suffix;
+}
+
+size_t common_suffix(std::string_view a, std::string_view b, size_t limit) noexcept
+{
+    size_t n = 0;
+    while (n < limit && a[a.size() - 1 - n] == b[b.size() - 1 - n]) {
+        ++n;
+    }
+    return n;
+}
+
+} // namespace
+
+bool looks_binary(std::string_view data, size_t around) noexcept
+{
+    auto has_nul = [&](size_t from, size_t to) {
+        to = std::min(to, data.size());
+        return from < to && std::memchr(data.data() + from, 0, to - from) != nullptr;
+    };
+    const size_t half = kBinaryProbeBytes / 2;
+    return has_nul(0, kBinaryProbeBytes) || has_nul(around > half ? around - half : 0, around + half);
+}
+
+std::string diff_text(std::string_view a, std::string_view b, const DiffOptions &options)
+{
+    const size_t common = std::min(a.size(), b.size());
+    const size_t first = detail::find_first_difference(a.data(), b.data(), common);
+    const size_t suffix = common_suffix(a, b, common - first);
+
+    // Window: the lines from the first difference to the common suffix, plus context lines on both sides.
+    auto line_begin = [&](size_t pos) {
+        const size_t nl = pos == 0 ? std::string_view::npos : a.rfind('\n', pos - 1);
+        return nl == std::string_view::npos ? size_t(0) : nl + 1;
+    };
+    const size_t first_line_start = line_begin(first);
+    size_t start = first_line_start;
+    size_t lead = 0;
+    for (; lead < options.m_context_lines && start > 0; ++lead) {
+        start = line_begin(start - 1);
+    }
+    size_t end = a.size() - suffix;
+    for (size_t i = 0; i <= options.m_context_lines && end < a.size(); ++i) {
+        const size_t nl = a.find('\n', end);
+        end = nl == std::string_view::npos ? a.size() : nl + 1;
+    }
+    const size_t tail = a.size() - end;
+    const auto newlines_before = std::count(a.begin(), a.begin() + static_cast<std::ptrdiff_t>(start), '\n');
+    const size_t window_line = static_cast<size_t>(newlines_before) + 1 + options.m_line_offset;
+    const size_t first_line = window_line + lead;
+    const size_t focus = first - first_line_start;
+
+    bool truncated = false;
+    const auto lines_a = split_lines(a.substr(start, a.size() - tail - start), options.m_max_window_lines, truncated);
+    const auto lines_b = split_lines(b.substr(start, b.size() - tail - start), options.m_max_window_lines, truncated);
+
+    std::string out;
+    if (options.m_header) {
+        out = "[PSI-TEST] strings differ: sizes " + std::to_string(a.size()) + " and " + std::to_string(b.size())
+              + " bytes, first difference at line " + std::to_string(first_line) + ", column "
+              + std::to_string(focus + 1) + " (byte " + std::to_string(first + options.m_byte_offset) + ")";
+    }
+
+    std::vector<Edit> script;
+    if (!myers_diff(lines_a, lines_b, options.m_max_edits, script)) {
+        out += "\n  more than " + std::to_string(options.m_max_edits)
+               + " line edits, showing the first differing lines";
+        out += "\n  @@ -" + std::to_string(first_line) + " +" + std::to_string(first_line) + " @@";
+        const size_t shown = options.m_context_lines + 1;
+        for (size_t i = lead; i < lead + shown && i < lines_a.size(); ++i) {
+            const size_t line_focus = i == lead ? focus : std::string_view::npos;
+            out += "\n  -" + render_line(lines_a[i].m_text, options.m_max_line_width, line_focus);
+        }
+        for (size_t i = lead; i < lead + shown && i < lines_b.size(); ++i) {
+            const size_t line_focus = i == lead ? focus : std::string_view::npos;
+            out += "\n  +" + render_line(lines_b[i].m_text, options.m_max_line_width, line_focus);
+        }
+        return out;
+    }
+
+    if (truncated) {
+        // Edits after the last common line are an artifact of cutting both windows at the same line count.
+        while (!script.empty() && script.back().m_kind != EditKind::keep) {
+            script.pop_back();
+        }
+    }
+    size_t removed = 0;
+    size_t inserted = 0;
+    for (const auto &e : script) {
+        removed += e.m_kind == EditKind::remove;
+        inserted += e.m_kind == EditKind::insert;
+    }
+    out += "\n  " + std::to_string(removed) + " line(s) removed, " + std::to_string(inserted) + " added";
+    if (truncated) {
+        out += " (within the first " + std::to_string(options.m_max_window_lines) + " lines after the difference)";
+    }
+
+    // Unified hunks: changes merged when fewer than 2 * context unchanged lines separate them.
+    const size_t context = options.m_context_lines;
+    size_t hunks = 0;
+    size_t output_lines = 0;
+    size_t i = 0;
+    while (i < script.size()) {
+        while (i < script.size() && script[i].m_kind == EditKind::keep) {
+            ++i;
+        }
+        if (i == script.size()) {
+            break;
+        }
+        if (hunks == options.m_max_hunks || output_lines >= options.m_max_output_lines) {
+            out += "\n  ... more differences not shown";
+            break;
+        }
+        const size_t hunk_begin = i > context ? i - context : 0;
+        size_t hunk_end = i;
+        size_t unchanged = 0;
+        while (hunk_end < script.size() && unchanged <= 2 * context) {
+            unchanged = script[hunk_end].m_kind == EditKind::keep ? unchanged + 1 : 0;
+            ++hunk_end;
+        }
+        hunk_end -= unchanged > context ? unchanged - context : 0;
+
+        size_t len_a = 0;
+        size_t len_b = 0;
+        for (size_t j = hunk_begin; j < hunk_end; ++j) {
+            len_a += script[j].m_kind != EditKind::insert;
+            len_b += script[j].m_kind != EditKind::remove;
+        }
+        out += "\n  @@ -" + std::to_string(window_line + script[hunk_begin].m_a) + "," + std::to_string(len_a) + " +"
+               + std::to_string(window_line + script[hunk_begin].m_b) + "," + std::to_string(len_b) + " @@";
+        for (size_t j = hunk_begin; j < hunk_end; ++j) {
+            if (++output_lines > options.m_max_output_lines) {
+                out += "\n  ...";
+                break;
+            }
+            const auto &e = script[j];
+            const auto &line = e.m_kind == EditKind::insert ? lines_b[e.m_b] : lines_a[e.m_a];
+            const bool at_first = (e.m_kind == EditKind::insert ? e.m_b : e.m_a) == lead;
+            out += "\n  ";
+            out += static_cast<char>(e.m_kind);
+            out += render_line(line.m_text, options.m_max_line_width, at_first ? focus : std::string_view::npos);
+        }
+        ++hunks;
+        i = hunk_end;
+    }
+    return out;
+}
+
+std::string diff_bytes(const void *a, size_t size_a, const void *b, size_t size_b, const DiffOptions &options)
+{
+    static constexpr size_t kRow = 16;
+    const auto *pa = static_cast<const unsigned char *>(a);
+    const auto *pb = static_cast<const unsigned char *>(b);
+    const size_t common = std::min(size_a, size_b);
+    const size_t first = detail::find_first_difference(a, b, common);
+    size_t differing = 0;
+    for (size_t i = first; i < common; ++i) {
+        differing += pa[i] != pb[i];
+    }
+
+    char buf[96];
+    std::string out;
+    if (options.m_header) {
+        const size_t at = first + options.m_byte_offset;
+        std::snprintf(buf, sizeof(buf), "0x%zx (%zu)", at, at);
+        out = "[PSI-TEST] buffers differ: sizes " + std::to_string(size_a) + " and " + std::to_string(size_b)
+              + " bytes, first difference at offset " + buf + "\n  " + std::to_string(differing) + " of "
+              + std::to_string(common) + " compared bytes differ";
+    }
+
+    auto row = [&](const unsigned char *p, size_t size, size_t offset) {
+        std::string line;
+        std::snprintf(buf, sizeof(buf), "%08zx ", offset + options.m_byte_offset);
+        line += buf;
+        std::string ascii;
+        for (size_t i = 0; i < kRow; ++i) {
+            line += i == kRow / 2 ? "  " : " ";
+            if (offset + i < size) {
+                const unsigned char c = p[offset + i];
+                std::snprintf(buf, sizeof(buf), "%02x", c);
+                line += buf;
+                ascii += c >= 0x20 && c < 0x7f ? static_cast<char>(c) : '.';
+            } else {
+                line += "  ";
+            }
+        }
+        return line + "  |" + ascii + "|";
+    };
+
+    const size_t first_row = first / kRow;
+    const size_t from = first_row > options.m_hex_rows_before ? first_row - options.m_hex_rows_before : 0;
+    const size_t rows = (std::max(size_a, size_b) + kRow - 1) / kRow;
+    const size_t to = std::min(rows, first_row + options.m_hex_rows_after + 1);
+    for (size_t r = from; r < to; ++r) {
+        const size_t offset = r * kRow;
+        const auto line_a = row(pa, size_a, offset);
+        const auto line_b = row(pb, size_b, offset);
+        if (line_a == line_b) {
+            out += "\n   " + line_a;
+        } else {
+            if (offset < size_a) {
+                out += "\n  -" + line_a;
+            }
+            if (offset < size_b) {
+                out += "\n  +" + line_b;
+            }
+        }
+    }
+    return out;
+}
+
+namespace detail {
+
+std::string describe_string_mismatch(std::string_view a, std::string_view b)
+{
+    const size_t first = find_first_difference(a.data(), b.data(), std::min(a.size(), b.size()));
+    if (looks_binary(a, first) || looks_binary(b, first)) {
+        return diff_bytes(a.data(), a.size(), b.data(), b.size());
+    }
+    const bool is_short = a.size() <= kShortValueBytes && b.size() <= kShortValueBytes
+                          && a.find('\n') == std::string_view::npos && b.find('\n') == std::string_view::npos;
+    if (is_short) {
+        return std::string(a) + " not equal to " + std::string(b);
+    }
+    return diff_text(a, b);
+}
+
+} // namespace detail
+
+} // namespace psi::test
@@ -0,0 +1,542 @@
+#include "psi/test/psi_distributed.h"
+#include "psi/test/psi_trace.h"
+
+#include "psi_executable.h"
+#include "psi_socket.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <format>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#if !defined(_WIN32)
+extern char **environ;
+#endif
+
+namespace psi::test {
+
+#if defined(_WIN32)
+
+int DistributedRunner::coordinate(const TestLib::CmdOptions &)
+{
+    std::cerr << "[PSI-TEST] --psi_coordinator is not supported on this platform" << std::endl;
+    return 1;
+}
+
+int DistributedRunner::work(const std::string &)
+{
+    std::cerr << "[PSI-TEST] --psi_worker is not supported on this platform" << std::endl;
+    return 1;
+}
+
+#else
+
+namespace {
+
+// Protocol, one message per line:
+//   coordinator -> worker: "ARGS <n>" + n argument lines and "CLOCK <TraceRecorder::origin_ns()>" (once),
+//                          "BATCH <n>" + n test names, "DONE"
+//   worker -> coordinator: "READY", "RESULT <failed> <ms> <bytes> <Group.Name>" + <bytes> of console output,
+//                          "TRACE <bytes>" + <bytes> of trace events (with --psi_trace, before each RESULT)
+
+/// A test that was in flight on this many lost workers is reported as failed instead of re-queued.
+constexpr int kMaxCrashesPerTest = 2;
+constexpr size_t kMaxBatch = 64;
+
+bool split_address(const std::string &address, std::string &host, std::string &port)
+{
+    const auto colon = address.rfind(':');
+    if (colon == std::string::npos || colon + 1 == address.size()) {
+        std::cerr << "[PSI-TEST] invalid address " << address << ", expected host:port" << std::endl;
+        return false;
+    }
+    host = address.substr(0, colon);
+    port = address.substr(colon + 1);
+    return true;
+}
+
+/// Listening socket on address; port receives the bound port (useful with port 0).
+int listen_tcp(const std::string &address, int &port)
+{
+    std::string host;
+    std::string service;
+    if (!split_address(address, host, service)) {
+        return -1;
+    }
+    addrinfo hints {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo *info = nullptr;
+    if (const int rc = ::getaddrinfo(host.empty() || host == "*" ? nullptr : host.c_str(), service.c_str(), &hints,
+                                     &info);
+        rc != 0) {
+        std::cerr << "[PSI-TEST] cannot resolve " << address << ": " << ::gai_strerror(rc) << std::endl;
+        return -1;
+    }
+    int fd = -1;
+    for (auto *ai = info; ai && fd < 0; ai = ai->ai_next) {
+        fd = detail::close_on_exec(::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol));
+        if (fd < 0) {
+            continue;
+        }
+        const int one = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (::bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 || ::listen(fd, 64) != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    ::freeaddrinfo(info);
+    if (fd < 0) {
+        std::cerr << "[PSI-TEST] cannot listen on " << address << ": " << std::strerror(errno) << std::endl;
+        return -1;
+    }
+    sockaddr_storage bound {};
+    socklen_t size = sizeof(bound);
+    ::getsockname(fd, reinterpret_cast<sockaddr *>(&bound), &size);
+    port = ntohs(bound.ss_family == AF_INET6 ? reinterpret_cast<sockaddr_in6 *>(&bound)->sin6_port
+                                             : reinterpret_cast<sockaddr_in *>(&bound)->sin_port);
+    return fd;
+}
+
+int connect_tcp(const std::string &address)
+{
+    std::string host;
+    std::string service;
+    if (!split_address(address, host, service)) {
+        return -1;
+    }
+    addrinfo hints {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *info = nullptr;
+    if (const int rc = ::getaddrinfo(host.c_str(), service.c_str(), &hints, &info); rc != 0) {
+        std::cerr << "[PSI-TEST] cannot resolve " << address << ": " << ::gai_strerror(rc) << std::endl;
+        return -1;
+    }
+    int fd = -1;
+    for (auto *ai = info; ai && fd < 0; ai = ai->ai_next) {
+        fd = detail::close_on_exec(::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol));
+        if (fd >= 0 && ::connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    ::freeaddrinfo(info);
+    if (fd < 0) {
+        std::cerr << "[PSI-TEST] cannot connect to " << address << ": " << std::strerror(errno) << std::endl;
+    }
+    return fd;
+}
+
+/// Starts this binary as a worker of address, with stdout discarded. Returns the pid or -1.
+pid_t spawn_worker(const std::string &address)
+{
+    const auto exe = detail::self_executable();
+    if (exe.empty()) {
+        std::cerr << "[PSI-TEST] --psi_spawn_workers: cannot locate the test binary" << std::endl;
+        return -1;
+    }
+    auto program = exe;
+    auto flag = "--psi_worker=" + address;
+    char *argv[] = {program.data(), flag.data(), nullptr};
+    posix_spawn_file_actions_t actions;
+    ::posix_spawn_file_actions_init(&actions);
+    ::posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+    pid_t pid = -1;
+    const int rc = ::posix_spawn(&pid, exe.c_str(), &actions, nullptr, argv, environ);
+    ::posix_spawn_file_actions_destroy(&actions);
+    if (rc != 0) {
+        std::cerr << "[PSI-TEST] cannot start worker: " << std::strerror(rc) << std::endl;
+        return -1;
+    }
+    return pid;
+}
+
+struct WorkerConnection {
+    int m_fd = -1;
+    std::string m_buffer;
+    /// Tests of the batch in flight that have not reported yet, in the order the worker runs them.
+    std::deque<std::string> m_batch;
+    bool m_ready = false;
+    bool m_lost = false;
+};
+
+std::string join_batch(const char *kind, const std::vector<std::string> &lines)
+{
+    std::string message = std::format("{} {}\n", kind, lines.size());
+    for (const auto &line : lines) {
+        message += line;
+        message += '\n';
+    }
+    return message;
+}
+
+/// Runs fn with fds 1 and 2 redirected to the temporary file out_fd and returns what was written.
+template <typename Fn>
+std::string run_captured(int out_fd, Fn &&fn)
+{
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+    const int saved_out = ::dup(1);
+    const int saved_err = ::dup(2);
+    ::dup2(out_fd, 1);
+    ::dup2(out_fd, 2);
+    fn();
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+    ::dup2(saved_out, 1);
+    ::dup2(saved_err, 2);
+    ::close(saved_out);
+    ::close(saved_err);
+
+    std::string output;
+    const auto size = ::lseek(out_fd, 0, SEEK_END);
+    if (size > 0) {
+        output.resize(static_cast<size_t>(size));
+        ::lseek(out_fd, 0, SEEK_SET);
+        size_t done = 0;
+        while (done < output.size()) {
+            const auto n = ::read(out_fd, output.data() + done, output.size() - done);
+            if (n <= 0) {
+                break;
+            }
+            done += static_cast<size_t>(n);
+        }
+        output.resize(done);
+    }
+    if (::ftruncate(out_fd, 0) != 0) {
+        std::cerr << "[PSI-TEST] cannot truncate worker output file" << std::endl;
+    }
+    ::lseek(out_fd, 0, SEEK_SET);
+    return output;
+}
+
+} // namespace
+
+int DistributedRunner::coordinate(const TestLib::CmdOptions &opts)
+{
+    auto filtered = TestLib::get_filtered_tests(opts.filter, opts.also_run_disabled);
+    std::deque<std::string> queue;
+    std::map<std::string, TestLib::TestCase *> by_name;
+    for (auto &test_group : filtered.m_tests_list) {
+        for (auto &tc : test_group) {
+            auto name = tc.m_test_group + "." + tc.m_test_name;
+            by_name.emplace(name, &tc);
+            queue.push_back(std::move(name));
+        }
+    }
+
+    int port = 0;
+    const int listen_fd = listen_tcp(opts.coordinator, port);
+    if (listen_fd < 0) {
+        return 1;
+    }
+    // Workers going away mid-write must not kill the coordinator.
+    std::signal(SIGPIPE, SIG_IGN);
+    std::string host;
+    std::string service;
+    split_address(opts.coordinator, host, service);
+    const auto local_host = host.empty() || host == "*" || host == "0.0.0.0" || host == "::" ? "127.0.0.1" : host;
+    const auto worker_address = std::format("{}:{}", local_host, port);
+    std::cout << std::format("[PSI-DIST] coordinator listening on {}:{}", host, port) << std::endl;
+    TestLib::print_run_header(filtered);
+
+    const auto args_message =
+        join_batch("ARGS", opts.worker_args) + std::format("CLOCK {}\n", TraceRecorder::origin_ns());
+    std::vector<WorkerConnection> workers;
+    std::set<pid_t> children;
+    std::map<std::string, int> crashes;
+    size_t spawned = 0;
+    const size_t max_spawns = opts.spawn_workers + kMaxCrashesPerTest * queue.size();
+    const size_t total = queue.size();
+    size_t completed = 0;
+    int failed = 0;
+    bool waiting_reported = false;
+
+    auto complete = [&](const std::string &name, bool is_failed, long long ms) {
+        if (const auto it = by_name.find(name); it != by_name.end()) {
+            it->second->m_test_result.m_is_failed = is_failed;
+            it->second->m_test_result.m_time_ms = ms;
+        }
+        failed += is_failed ? 1 : 0;
+        ++completed;
+    };
+    auto lose = [&](WorkerConnection &worker) {
+        worker.m_lost = true;
+        ::close(worker.m_fd);
+        if (worker.m_batch.empty()) {
+            return;
+        }
+        const auto culprit = worker.m_batch.front();
+        if (++crashes[culprit] >= kMaxCrashesPerTest) {
+            worker.m_batch.pop_front();
+            std::cout << std::format("[  FAILED  ] {} (lost {} workers while running it)", culprit, crashes[culprit])
+                      << std::endl;
+            complete(culprit, true, 0);
+        }
+        if (worker.m_batch.empty()) {
+            return;
+        }
+        std::cout << std::format("[PSI-DIST] worker lost, re-queueing {} test{}",
+                                 worker.m_batch.size(),
+                                 worker.m_batch.size() != 1 ? "s" : "")
+                  << std::endl;
+        queue.insert(queue.begin(), worker.m_batch.begin(), worker.m_batch.end());
+        worker.m_batch.clear();
+    };
+    /// Handles the complete messages at the front of the worker's buffer.
+    auto process = [&](WorkerConnection &worker) {
+        for (;;) {
+            const auto eol = worker.m_buffer.find('\n');
+            if (eol == std::string::npos) {
+                return;
+            }
+            const std::string_view line(worker.m_buffer.data(), eol);
+            if (line == "READY") {
+                worker.m_ready = true;
+                worker.m_buffer.erase(0, eol + 1);
+                continue;
+            }
+            if (line.starts_with("TRACE ")) {
+                const auto bytes = std::strtoull(line.data() + 6, nullptr, 10);
+                if (worker.m_buffer.size() < eol + 1 + bytes) {
+                    return;
+                }
+                TraceRecorder::add_events(std::string_view(worker.m_buffer).substr(eol + 1, bytes));
+                worker.m_buffer.erase(0, eol + 1 + bytes);
+                continue;
+            }
+            if (!line.starts_with("RESULT ")) {
+                lose(worker);
+                return;
+            }
+            std::istringstream header {std::string(line.substr(7))};
+            int is_failed = 0;
+            long long ms = 0;
+            size_t bytes = 0;
+            std::string name;
+            header >> is_failed >> ms >> bytes >> name;
+            if (worker.m_buffer.size() < eol + 1 + bytes) {
+                return;
+            }
+            std::cout << std::string_view(worker.m_buffer).substr(eol + 1, bytes) << std::flush;
+            worker.m_buffer.erase(0, eol + 1 + bytes);
+            if (const auto it = std::find(worker.m_batch.begin(), worker.m_batch.end(), name);
+                it != worker.m_batch.end()) {
+                worker.m_batch.erase(it);
+                complete(name, is_failed != 0, ms);
+            }
+        }
+    };
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    while (completed < total) {
+        while (!children.empty()) {
+            const auto pid = ::waitpid(-1, nullptr, WNOHANG);
+            if (pid <= 0) {
+                break;
+            }
+            children.erase(pid);
+        }
+        while (!queue.empty() && children.size() < opts.spawn_workers && spawned < max_spawns) {
+            const auto pid = spawn_worker(worker_address);
+            ++spawned;
+            if (pid < 0) {
+                break;
+            }
+            children.insert(pid);
+        }
+        if (opts.spawn_workers && spawned >= max_spawns && workers.empty() && children.empty() && !queue.empty()) {
+            // Every worker this run may start is gone: nothing would ever pick up the rest of the queue.
+            std::cout << std::format("[PSI-DIST] no workers left after spawning {}, failing {} remaining test{}",
+                                     spawned,
+                                     queue.size(),
+                                     queue.size() != 1 ? "s" : "")
+                      << std::endl;
+            for (const auto &name : queue) {
+                std::cout << std::format("[  FAILED  ] {} (no worker left to run it)", name) << std::endl;
+                complete(name, true, 0);
+            }
+            queue.clear();
+            continue;
+        }
+        if (workers.empty() && children.empty() && !waiting_reported) {
+            std::cout << std::format("[PSI-DIST] waiting for workers: --psi_worker={}", worker_address) << std::endl;
+            waiting_reported = true;
+        }
+
+        for (auto &worker : workers) {
+            if (!worker.m_ready || queue.empty()) {
+                continue;
+            }
+            // Guided scheduling: big batches while the queue is long, single tests near the end.
+            const auto size = std::clamp<size_t>(queue.size() / (2 * workers.size()), 1, kMaxBatch);
+            std::vector<std::string> batch(queue.begin(), queue.begin() + static_cast<std::ptrdiff_t>(size));
+            queue.erase(queue.begin(), queue.begin() + static_cast<std::ptrdiff_t>(size));
+            worker.m_batch.assign(batch.begin(), batch.end());
+            worker.m_ready = false;
+            if (!detail::write_all(worker.m_fd, join_batch("BATCH", batch))) {
+                lose(worker);
+            }
+        }
+        std::erase_if(workers, [](const WorkerConnection &w) { return w.m_lost; });
+
+        std::vector<pollfd> fds {{listen_fd, POLLIN, 0}};
+        for (const auto &worker : workers) {
+            fds.push_back({worker.m_fd, POLLIN, 0});
+        }
+        if (::poll(fds.data(), fds.size(), 200) <= 0) {
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            if (const int fd = detail::close_on_exec(::accept(listen_fd, nullptr, nullptr)); fd >= 0) {
+                if (detail::write_all(fd, args_message)) {
+                    workers.push_back({fd, {}, {}, false, false});
+                    waiting_reported = false;
+                } else {
+                    ::close(fd);
+                }
+            }
+        }
+        for (size_t i = 1; i < fds.size(); ++i) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            auto &worker = workers[i - 1];
+            char buf[16384];
+            const auto n = ::read(worker.m_fd, buf, sizeof(buf));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                lose(worker);
+                continue;
+            }
+            worker.m_buffer.append(buf, static_cast<size_t>(n));
+            process(worker);
+        }
+        std::erase_if(workers, [](const WorkerConnection &w) { return w.m_lost; });
+    }
+
+    for (auto &worker : workers) {
+        detail::write_all(worker.m_fd, "DONE\n");
+        ::close(worker.m_fd);
+    }
+    ::close(listen_fd);
+    for (const auto pid : children) {
+        ::waitpid(pid, nullptr, 0);
+    }
+    const auto total_end = std::chrono::high_resolution_clock::now();
+    const auto total_time = std::chrono::duration_cast<std::chrono::milliseconds>(total_end - start).count();
+    TestLib::report_run(filtered, failed, total_time, opts);
+    return failed;
+}
+
+int DistributedRunner::work(const std::string &address)
+{
+    const int fd = connect_tcp(address);
+    if (fd < 0) {
+        return 1;
+    }
+    detail::SocketReader reader(fd);
+    std::string line;
+    if (!reader.read_line(line) || !line.starts_with("ARGS ")) {
+        std::cerr << "[PSI-TEST] unexpected greeting from coordinator " << address << std::endl;
+        ::close(fd);
+        return 1;
+    }
+    std::vector<std::string> args;
+    for (auto n = std::strtoull(line.c_str() + 5, nullptr, 10); n > 0 && reader.read_line(line); --n) {
+        // --help exits the process, and a worker never becomes a coordinator, server or client.
+        if (!detail::is_mode_flag(line)) {
+            args.push_back(line);
+        }
+    }
+    std::string program = "psi-worker";
+    std::vector<char *> argv {program.data()};
+    for (auto &arg : args) {
+        argv.push_back(arg.data());
+    }
+    const auto opts = TestLib::parse_args(argv);
+    // Worker events go onto the coordinator's timeline, which is only meaningful on the same host: remote
+    // workers' monotonic clocks have unrelated origins.
+    int64_t trace_shift_ns = 0;
+    if (reader.read_line(line) && line.starts_with("CLOCK ")) {
+        trace_shift_ns = TraceRecorder::origin_ns() - std::strtoll(line.c_str() + 6, nullptr, 10);
+    }
+    if (!opts.trace_path.empty()) {
+        TraceRecorder::enable();
+    }
+
+    std::FILE *out = std::tmpfile();
+    if (!out) {
+        std::cerr << "[PSI-TEST] cannot create worker output file" << std::endl;
+        ::close(fd);
+        return 1;
+    }
+    const int out_fd = ::fileno(out);
+    bool connected = detail::write_all(fd, "READY\n");
+    while (connected && reader.read_line(line) && line.starts_with("BATCH ")) {
+        std::vector<std::string> batch;
+        for (auto n = std::strtoull(line.c_str() + 6, nullptr, 10); n > 0 && reader.read_line(line); --n) {
+            batch.push_back(line);
+        }
+        for (const auto &name : batch) {
+            bool failed = false;
+            const auto start = std::chrono::high_resolution_clock::now();
+            const auto output = run_captured(out_fd, [&] {
+                TestLib::reset_test_state();
+                if (!TestLib::run_named_test(name, opts, failed)) {
+                    std::cout << std::format("[  FAILED  ] {} (not found in the worker binary)", name) << std::endl;
+                    failed = true;
+                }
+            });
+            const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                std::chrono::high_resolution_clock::now() - start)
+                                .count();
+            if (TraceRecorder::enabled()) {
+                const auto events = TraceRecorder::take_events(trace_shift_ns);
+                connected = detail::write_all(fd, std::format("TRACE {}\n", events.size())) &&
+                            detail::write_all(fd, events);
+            }
+            const auto header = std::format("RESULT {} {} {} {}\n", failed ? 1 : 0, ms, output.size(), name);
+            connected = connected && detail::write_all(fd, header) && detail::write_all(fd, output);
+            if (!connected) {
+                break;
+            }
+        }
+        connected = connected && detail::write_all(fd, "READY\n");
+    }
+    TraceRecorder::disable();
+    std::fclose(out);
+    ::close(fd);
+    return 0;
+}
+
+#endif
+
+} // namespace psi::test
@@ -0,0 +1,41 @@
+#pragma once
+
+// Path of the running test binary, for spawning workers and hashing the binary.
+
+#include <cstdint>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach-o/dyld.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace psi::test::detail {
+
+/// Empty if the platform offers no way to find it.
+inline std::string self_executable()
+{
+#if defined(_WIN32)
+    char path[MAX_PATH];
+    const auto n = ::GetModuleFileNameA(nullptr, path, MAX_PATH);
+    return n > 0 && n < MAX_PATH ? std::string(path, n) : std::string();
+#elif defined(__APPLE__)
+    char path[4096];
+    uint32_t size = sizeof(path);
+    return _NSGetExecutablePath(path, &size) == 0 ? std::string(path) : std::string();
+#elif defined(__linux__)
+    char path[4096];
+    const auto n = ::readlink("/proc/self/exe", path, sizeof(path) - 1);
+    return n > 0 ? std::string(path, static_cast<size_t>(n)) : std::string();
+#else
+    return {};
+#endif
+}
+
+} // namespace psi::test::detail
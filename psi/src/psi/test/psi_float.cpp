@@ -0,0 +1,333 @@
+#include "psi/test/psi_float.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PSI_FLOAT_SSE2
+#endif
+
+namespace psi::test::detail {
+
+namespace {
+
+template <typename T>
+using bits_t = std::conditional_t<sizeof(T) == 4, int32_t, int64_t>;
+
+/// Maps the bit pattern to an integer that is monotonic in the float value (-0.0 and +0.0 coincide).
+template <typename T>
+inline int64_t ordered_bits(T v) noexcept
+{
+    using B = bits_t<T>;
+    const auto bits = std::bit_cast<B>(v);
+    return bits < 0 ? static_cast<int64_t>(std::numeric_limits<B>::min()) - static_cast<int64_t>(bits)
+                    : static_cast<int64_t>(bits);
+}
+
+template <typename T>
+inline uint64_t ulps_between(T a, T b) noexcept
+{
+    const auto oa = ordered_bits(a);
+    const auto ob = ordered_bits(b);
+    return oa > ob ? static_cast<uint64_t>(oa) - static_cast<uint64_t>(ob) : static_cast<uint64_t>(ob) - static_cast<uint64_t>(oa);
+}
+
+template <typename T>
+inline bool near_ok(T a, T b, T abs_error, T rel_error) noexcept
+{
+    const T diff = std::abs(a - b);
+    const T tolerance = std::max(abs_error, rel_error * std::max(std::abs(a), std::abs(b)));
+    const bool both_nan = (a != a) & (b != b);
+    // An infinite difference never passes, so a finite value is not "near" an infinity.
+    return ((diff <= tolerance) & (diff < std::numeric_limits<T>::infinity())) | (a == b) | both_nan;
+}
+
+template <typename T>
+inline bool ulp_ok(T a, T b, uint64_t max_ulps) noexcept
+{
+    const bool any_nan = (a != a) | (b != b);
+    const bool both_nan = (a != a) & (b != b);
+    return (!any_nan & (ulps_between(a, b) <= max_ulps)) | both_nan;
+}
+
+template <typename T>
+size_t count_failures_scalar(const T *a, const T *b, size_t from, size_t n, auto &&ok)
+{
+    size_t failures = 0;
+    for (size_t i = from; i < n; ++i) {
+        failures += ok(a[i], b[i]) ? size_t(0) : size_t(1);
+    }
+    return failures;
+}
+
+// Kernels counting failing elements. Passing comparisons only pay for these.
+
+size_t count_near_failures(const float *a, const float *b, size_t n, float abs_error, float rel_error)
+{
+    size_t i = 0;
+    size_t failures = 0;
+#ifdef PSI_FLOAT_SSE2
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 abs_v = _mm_set1_ps(abs_error);
+    const __m128 rel_v = _mm_set1_ps(rel_error);
+    const __m128 inf_v = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    for (; i + 4 <= n; i += 4) {
+        const __m128 va = _mm_loadu_ps(a + i);
+        const __m128 vb = _mm_loadu_ps(b + i);
+        const __m128 diff = _mm_and_ps(_mm_sub_ps(va, vb), abs_mask);
+        const __m128 magnitude = _mm_max_ps(_mm_and_ps(va, abs_mask), _mm_and_ps(vb, abs_mask));
+        const __m128 tolerance = _mm_max_ps(abs_v, _mm_mul_ps(rel_v, magnitude));
+        __m128 ok = _mm_and_ps(_mm_cmple_ps(diff, tolerance), _mm_cmplt_ps(diff, inf_v));
+        ok = _mm_or_ps(ok, _mm_cmpeq_ps(va, vb));
+        ok = _mm_or_ps(ok, _mm_and_ps(_mm_cmpunord_ps(va, va), _mm_cmpunord_ps(vb, vb)));
+        failures += 4 - static_cast<size_t>(std::popcount(static_cast<unsigned>(_mm_movemask_ps(ok))));
+    }
+#endif
+    return failures + count_failures_scalar(a, b, i, n, [=](float x, float y) {
+               return near_ok(x, y, abs_error, rel_error);
+           });
+}
+
+size_t count_near_failures(const double *a, const double *b, size_t n, double abs_error, double rel_error)
+{
+    size_t i = 0;
+    size_t failures = 0;
+#ifdef PSI_FLOAT_SSE2
+    const __m128d abs_mask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+    const __m128d abs_v = _mm_set1_pd(abs_error);
+    const __m128d rel_v = _mm_set1_pd(rel_error);
+    const __m128d inf_v = _mm_set1_pd(std::numeric_limits<double>::infinity());
+    for (; i + 2 <= n; i += 2) {
+        const __m128d va = _mm_loadu_pd(a + i);
+        const __m128d vb = _mm_loadu_pd(b + i);
+        const __m128d diff = _mm_and_pd(_mm_sub_pd(va, vb), abs_mask);
+        const __m128d magnitude = _mm_max_pd(_mm_and_pd(va, abs_mask), _mm_and_pd(vb, abs_mask));
+        const __m128d tolerance = _mm_max_pd(abs_v, _mm_mul_pd(rel_v, magnitude));
+        __m128d ok = _mm_and_pd(_mm_cmple_pd(diff, tolerance), _mm_cmplt_pd(diff, inf_v));
+        ok = _mm_or_pd(ok, _mm_cmpeq_pd(va, vb));
+        ok = _mm_or_pd(ok, _mm_and_pd(_mm_cmpunord_pd(va, va), _mm_cmpunord_pd(vb, vb)));
+        failures += 2 - static_cast<size_t>(std::popcount(static_cast<unsigned>(_mm_movemask_pd(ok))));
+    }
+#endif
+    return failures + count_failures_scalar(a, b, i, n, [=](double x, double y) {
+               return near_ok(x, y, abs_error, rel_error);
+           });
+}
+
+size_t count_ulp_failures(const float *a, const float *b, size_t n, uint64_t max_ulps)
+{
+    size_t i = 0;
+    size_t failures = 0;
+#ifdef PSI_FLOAT_SSE2
+    // Distances fit in 32 bits, so a larger limit only rejects NaN mismatches (handled by the scalar path).
+    if (max_ulps < 0xffffffffULL) {
+        const __m128i magnitude_mask = _mm_set1_epi32(0x7fffffff);
+        const __m128i bias = _mm_set1_epi32(static_cast<int>(0x80000000u));
+        const __m128i limit = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(static_cast<uint32_t>(max_ulps))), bias);
+        auto ordered = [&](__m128i bits) {
+            const __m128i sign = _mm_srai_epi32(bits, 31);
+            const __m128i magnitude = _mm_and_si128(bits, magnitude_mask);
+            return _mm_sub_epi32(_mm_xor_si128(magnitude, sign), sign);
+        };
+        for (; i + 4 <= n; i += 4) {
+            const __m128 va = _mm_loadu_ps(a + i);
+            const __m128 vb = _mm_loadu_ps(b + i);
+            const __m128i oa = ordered(_mm_castps_si128(va));
+            const __m128i ob = ordered(_mm_castps_si128(vb));
+            const __m128i a_greater = _mm_cmpgt_epi32(oa, ob);
+            const __m128i distance = _mm_or_si128(_mm_and_si128(a_greater, _mm_sub_epi32(oa, ob)),
+                                                  _mm_andnot_si128(a_greater, _mm_sub_epi32(ob, oa)));
+            // unsigned distance <= limit
+            const __m128i within = _mm_xor_si128(_mm_cmpgt_epi32(_mm_xor_si128(distance, bias), limit),
+                                                 _mm_set1_epi32(-1));
+            const __m128 nan_a = _mm_cmpunord_ps(va, va);
+            const __m128 nan_b = _mm_cmpunord_ps(vb, vb);
+            __m128 ok = _mm_andnot_ps(_mm_or_ps(nan_a, nan_b), _mm_castsi128_ps(within));
+            ok = _mm_or_ps(ok, _mm_and_ps(nan_a, nan_b));
+            failures += 4 - static_cast<size_t>(std::popcount(static_cast<unsigned>(_mm_movemask_ps(ok))));
+        }
+    }
+#endif
+    return failures + count_failures_scalar(a, b, i, n, [=](float x, float y) { return ulp_ok(x, y, max_ulps); });
+}
+
+size_t count_ulp_failures(const double *a, const double *b, size_t n, uint64_t max_ulps)
+{
+    // 64-bit lane compares need SSE4.2; the branchless scalar loop is left to the compiler.
+    return count_failures_scalar(a, b, 0, n, [=](double x, double y) { return ulp_ok(x, y, max_ulps); });
+}
+
+template <typename T>
+FloatCompareSummary compare_impl(std::span<const T> sa, std::span<const T> sb, auto &&count_failures, auto &&ok)
+{
+    FloatCompareSummary s;
+    const size_t n = std::min(sa.size(), sb.size());
+    const T *a = sa.data();
+    const T *b = sb.data();
+    s.m_count = n;
+
+    const size_t failures = count_failures(a, b, n);
+    s.m_failures = failures;
+    if (!failures && sa.size() == sb.size()) {
+        return s;
+    }
+
+    bool first = true;
+    for (size_t i = 0; i < n; ++i) {
+        const bool nan_a = std::isnan(a[i]);
+        const bool nan_b = std::isnan(b[i]);
+        if (!nan_a && !nan_b) {
+            const double err = std::abs(static_cast<double>(a[i]) - static_cast<double>(b[i]));
+            if (std::isfinite(err) && err > s.m_max_abs_error) {
+                s.m_max_abs_error = err;
+                s.m_max_abs_index = i;
+            }
+            const auto ulps = ulps_between(a[i], b[i]);
+            if (ulps > s.m_max_ulps) {
+                s.m_max_ulps = ulps;
+                s.m_max_ulp_index = i;
+            }
+        }
+        if (ok(a[i], b[i])) {
+            continue;
+        }
+        if (first) {
+            s.m_first_failure = i;
+            first = false;
+        }
+        if (nan_a != nan_b) {
+            ++s.m_nan_mismatches;
+        } else if (std::isinf(a[i]) || std::isinf(b[i])) {
+            ++s.m_inf_mismatches;
+        }
+    }
+    return s;
+}
+
+template <typename T>
+std::string format_value(T v)
+{
+    char buf[40];
+    std::snprintf(buf, sizeof(buf), "%.*g", std::numeric_limits<T>::max_digits10, static_cast<double>(v));
+    return buf;
+}
+
+template <typename T>
+std::string describe_impl(const char *assertion, const FloatCompareSummary &s, std::span<const T> a, std::span<const T> b)
+{
+    char criterion[96];
+    if (s.m_is_ulp_check) {
+        std::snprintf(criterion, sizeof(criterion), "%llu ulps", static_cast<unsigned long long>(s.m_allowed_ulps));
+    } else if (s.m_rel_error > 0.0) {
+        std::snprintf(criterion, sizeof(criterion), "abs %g / rel %g", s.m_abs_error, s.m_rel_error);
+    } else {
+        std::snprintf(criterion, sizeof(criterion), "abs %g", s.m_abs_error);
+    }
+    std::string error = std::string("[PSI-TEST] ") + assertion + ": ";
+    if (a.size() != b.size()) {
+        error += "sizes " + std::to_string(a.size()) + " and " + std::to_string(b.size()) + ", ";
+    }
+    error += std::to_string(s.m_failures) + " of " + std::to_string(s.m_count) + " elements outside " + criterion;
+    if (s.m_failures) {
+        const auto i = s.m_first_failure;
+        error += "\n  first at [" + std::to_string(i) + "]: " + format_value(a[i]) + " vs " + format_value(b[i]);
+    }
+    if (s.m_count) {
+        const auto i = s.m_max_abs_index;
+        const auto j = s.m_max_ulp_index;
+        error += "\n  max abs error " + format_value(s.m_max_abs_error) + " at [" + std::to_string(i)
+                 + "]: " + format_value(a[i]) + " vs " + format_value(b[i]);
+        error += "\n  max ulp distance " + std::to_string(s.m_max_ulps) + " at [" + std::to_string(j)
+                 + "]: " + format_value(a[j]) + " vs " + format_value(b[j]);
+    }
+    if (s.m_nan_mismatches || s.m_inf_mismatches) {
+        error += "\n  NaN mismatches: " + std::to_string(s.m_nan_mismatches)
+                 + ", Inf mismatches: " + std::to_string(s.m_inf_mismatches);
+    }
+    return error;
+}
+
+} // namespace
+
+FloatCompareSummary compare_near(std::span<const float> a, std::span<const float> b, double abs_error, double rel_error)
+{
+    const auto abs_f = static_cast<float>(abs_error);
+    const auto rel_f = static_cast<float>(rel_error);
+    auto s = compare_impl(
+        a,
+        b,
+        [=](const float *x, const float *y, size_t n) { return count_near_failures(x, y, n, abs_f, rel_f); },
+        [=](float x, float y) { return near_ok(x, y, abs_f, rel_f); });
+    s.m_abs_error = abs_error;
+    s.m_rel_error = rel_error;
+    return s;
+}
+
+FloatCompareSummary compare_near(std::span<const double> a, std::span<const double> b, double abs_error, double rel_error)
+{
+    auto s = compare_impl(
+        a,
+        b,
+        [=](const double *x, const double *y, size_t n) { return count_near_failures(x, y, n, abs_error, rel_error); },
+        [=](double x, double y) { return near_ok(x, y, abs_error, rel_error); });
+    s.m_abs_error = abs_error;
+    s.m_rel_error = rel_error;
+    return s;
+}
+
+FloatCompareSummary compare_ulps(std::span<const float> a, std::span<const float> b, uint64_t max_ulps)
+{
+    auto s = compare_impl(
+        a,
+        b,
+        [=](const float *x, const float *y, size_t n) { return count_ulp_failures(x, y, n, max_ulps); },
+        [=](float x, float y) { return ulp_ok(x, y, max_ulps); });
+    s.m_is_ulp_check = true;
+    s.m_allowed_ulps = max_ulps;
+    return s;
+}
+
+FloatCompareSummary compare_ulps(std::span<const double> a, std::span<const double> b, uint64_t max_ulps)
+{
+    auto s = compare_impl(
+        a,
+        b,
+        [=](const double *x, const double *y, size_t n) { return count_ulp_failures(x, y, n, max_ulps); },
+        [=](double x, double y) { return ulp_ok(x, y, max_ulps); });
+    s.m_is_ulp_check = true;
+    s.m_allowed_ulps = max_ulps;
+    return s;
+}
+
+uint64_t ulp_distance(float a, float b)
+{
+    return ulps_between(a, b);
+}
+
+uint64_t ulp_distance(double a, double b)
+{
+    return ulps_between(a, b);
+}
+
+std::string describe_float_failure(const char *assertion,
+                                   const FloatCompareSummary &s,
+                                   std::span<const double> a,
+                                   std::span<const double> b)
+{
+    return describe_impl(assertion, s, a, b);
+}
+
+std::string describe_float_failure(const char *assertion,
+                                   const FloatCompareSummary &s,
+                                   std::span<const float> a,
+                                   std::span<const float> b)
+{
+    return describe_impl(assertion, s, a, b);
+}
+
+} // namespace psi::test::detail
@@ -0,0 +1,332 @@
+#include "psi/test/psi_golden.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "psi/test/psi_diff.h"
+#include "psi/test/psi_mock.h"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace psi::test {
+
+namespace {
+
+constexpr size_t kChunkBytes = 1 << 20;
+// Bytes before and after the first difference handed to the diff.
+constexpr size_t kContextBefore = 4096;
+constexpr size_t kContextAfter = 64 * 1024;
+
+bool s_update = false;
+
+/// Read-only mapping of a whole file. Empty files are open with an empty view.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &path)
+    {
+#if defined(_WIN32)
+        m_file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        LARGE_INTEGER size {};
+        if (m_file == INVALID_HANDLE_VALUE || !::GetFileSizeEx(m_file, &size)) {
+            return;
+        }
+        m_size = static_cast<size_t>(size.QuadPart);
+        if (m_size > 0) {
+            m_mapping = ::CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (m_mapping) {
+                m_data = static_cast<const char *>(::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+            }
+            if (!m_data) {
+                return;
+            }
+        }
+        m_open = true;
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st {};
+        if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            m_size = static_cast<size_t>(st.st_size);
+            if (m_size == 0) {
+                m_open = true;
+            } else if (void *p = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0); p != MAP_FAILED) {
+                ::madvise(p, m_size, MADV_SEQUENTIAL);
+                m_data = static_cast<const char *>(p);
+                m_open = true;
+            }
+        }
+        ::close(fd);
+#endif
+    }
+    ~MappedFile()
+    {
+#if defined(_WIN32)
+        if (m_data) {
+            ::UnmapViewOfFile(m_data);
+        }
+        if (m_mapping) {
+            ::CloseHandle(m_mapping);
+        }
+        if (m_file != INVALID_HANDLE_VALUE) {
+            ::CloseHandle(m_file);
+        }
+#else
+        if (m_data) {
+            ::munmap(const_cast<char *>(m_data), m_size);
+        }
+#endif
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool is_open() const
+    {
+        return m_open;
+    }
+    std::string_view view() const
+    {
+        return {m_data, m_size};
+    }
+
+private:
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+    bool m_open = false;
+#if defined(_WIN32)
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#endif
+};
+
+/// Offset of the first byte where golden and actual differ, the shorter size when one is a prefix of the
+/// other, npos when they are equal. find_first_difference stops at the first differing block, so a mismatch
+/// early in a large file only faults in the pages before it.
+size_t first_difference(std::string_view golden, std::string_view actual)
+{
+    const size_t common = std::min(golden.size(), actual.size());
+    const size_t first = detail::find_first_difference(golden.data(), actual.data(), common);
+    return first == common && golden.size() == actual.size() ? std::string_view::npos : first;
+}
+
+/// Failure message for a golden file whose contents differ from the output at byte first. actual_tail holds
+/// the output from first on (at most kContextAfter bytes), the bytes before it equal the golden file's.
+std::string describe_mismatch(const std::string &path,
+                              std::string_view golden,
+                              size_t first,
+                              std::string_view actual_tail,
+                              size_t actual_size)
+{
+    const bool binary = looks_binary(golden, first) || looks_binary(actual_tail);
+    std::string out = "[PSI-TEST] output differs from golden file " + path + ": golden "
+                      + std::to_string(golden.size()) + " bytes, actual " + std::to_string(actual_size) + " bytes, ";
+
+    DiffOptions options;
+    options.m_header = false;
+    size_t start = first > kContextBefore ? first - kContextBefore : 0;
+    if (binary) {
+        start &= ~size_t(15); // keep hex rows aligned to the file
+        out += std::format("first difference at offset 0x{:x} ({})", first, first);
+    } else {
+        const auto prefix = golden.substr(0, first);
+        const size_t line_start = prefix.rfind('\n') + 1; // npos + 1 == 0 on the first line
+        const auto line = std::count(prefix.begin(), prefix.end(), '\n') + 1;
+        out += std::format("first difference at line {}, column {} (byte {})", line, first - line_start + 1, first);
+        // Start the window on a line boundary so the diff lines up with the file's lines.
+        if (const size_t nl = golden.find('\n', start); start > 0 && nl < first) {
+            start = nl + 1;
+        }
+        options.m_line_offset = static_cast<size_t>(std::count(prefix.begin(), prefix.begin() + start, '\n'));
+    }
+    options.m_byte_offset = start;
+    out += "\n  rerun with --psi_update_golden to accept the new output";
+
+    const auto golden_window = golden.substr(start, first - start + kContextAfter);
+    std::string actual_window(golden.substr(start, first - start));
+    actual_window += actual_tail.substr(0, kContextAfter);
+    if (binary) {
+        out += diff_bytes(golden_window.data(), golden_window.size(), actual_window.data(), actual_window.size(),
+                          options);
+    } else {
+        out += diff_text(golden_window, actual_window, options);
+    }
+    return out;
+}
+
+std::filesystem::path temp_path_for(const std::string &path)
+{
+    static std::atomic<uint64_t> s_counter {0};
+    static const auto s_token = std::random_device {}();
+    std::filesystem::path tmp = path;
+    tmp += std::format(".tmp.{:x}.{}", s_token, s_counter++);
+    return tmp;
+}
+
+/// Renames tmp over path; empty on success, otherwise the error (tmp is removed).
+std::string replace_golden(const std::filesystem::path &tmp, const std::string &path, size_t size)
+{
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+        return "[PSI-TEST] cannot update golden file " + path + ": " + ec.message();
+    }
+    std::cout << "[PSI-TEST] updated golden file " << path << " (" << size << " bytes)" << std::endl;
+    return {};
+}
+
+std::string cannot_write(const std::filesystem::path &tmp, const std::string &path)
+{
+    std::error_code ec;
+    std::filesystem::remove(tmp, ec);
+    return "[PSI-TEST] cannot write golden file " + path;
+}
+
+std::string cannot_open(const std::string &path)
+{
+    return "[PSI-TEST] cannot open golden file " + path + " (run with --psi_update_golden to create it)";
+}
+
+void create_parent_directories(const std::string &path)
+{
+    std::error_code ec;
+    const auto parent = std::filesystem::path(path).parent_path();
+    if (!parent.empty()) {
+        std::filesystem::create_directories(parent, ec);
+    }
+}
+
+} // namespace
+
+void GoldenFile::set_update(bool update)
+{
+    s_update = update;
+}
+
+bool GoldenFile::update_enabled()
+{
+    return s_update;
+}
+
+namespace detail {
+
+std::string check_golden(const std::string &path, std::string_view actual)
+{
+    {
+        const MappedFile golden(path);
+        if (golden.is_open()) {
+            const size_t first = first_difference(golden.view(), actual);
+            if (first == std::string_view::npos) {
+                return {};
+            }
+            if (!s_update) {
+                return describe_mismatch(path, golden.view(), first, actual.substr(first), actual.size());
+            }
+        } else if (!s_update) {
+            return cannot_open(path);
+        }
+    } // unmapped before the rename, which Windows refuses on a mapped file
+
+    create_parent_directories(path);
+    const auto tmp = temp_path_for(path);
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write(actual.data(), static_cast<std::streamsize>(actual.size()));
+        if (!out.flush()) {
+            out.close();
+            return cannot_write(tmp, path);
+        }
+    }
+    return replace_golden(tmp, path, actual.size());
+}
+
+std::string check_golden(const std::string &path, std::istream &actual)
+{
+    std::vector<char> buf(kChunkBytes);
+    auto read_chunk = [&](char *dst, size_t size) {
+        actual.read(dst, static_cast<std::streamsize>(size));
+        return static_cast<size_t>(actual.gcount());
+    };
+
+    if (s_update) {
+        // The output is only known once the stream ends: spool it next to the golden file, then compare.
+        create_parent_directories(path);
+        const auto tmp = temp_path_for(path);
+        size_t size = 0;
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            while (const size_t n = read_chunk(buf.data(), buf.size())) {
+                out.write(buf.data(), static_cast<std::streamsize>(n));
+                size += n;
+            }
+            if (!out.flush()) {
+                out.close();
+                return cannot_write(tmp, path);
+            }
+        }
+        {
+            const MappedFile golden(path);
+            const MappedFile spooled(tmp.string());
+            if (golden.is_open() && spooled.is_open()
+                && first_difference(golden.view(), spooled.view()) == std::string_view::npos) {
+                std::error_code ec;
+                std::filesystem::remove(tmp, ec);
+                return {};
+            }
+        }
+        return replace_golden(tmp, path, size);
+    }
+
+    const MappedFile golden(path);
+    if (!golden.is_open()) {
+        return cannot_open(path);
+    }
+    const auto g = golden.view();
+    size_t pos = 0;
+    while (const size_t n = read_chunk(buf.data(), buf.size())) {
+        const size_t common = std::min(n, g.size() - std::min(pos, g.size()));
+        const size_t d = detail::find_first_difference(g.data() + pos, buf.data(), common);
+        if (d < n) {
+            // Keep up to kContextAfter bytes from the difference on, count the rest.
+            std::string tail(buf.data() + d, n - d);
+            size_t size = pos + n;
+            if (tail.size() < kContextAfter) {
+                const size_t old = tail.size();
+                tail.resize(kContextAfter);
+                const size_t more = read_chunk(tail.data() + old, kContextAfter - old);
+                tail.resize(old + more);
+                size += more;
+            }
+            while (const size_t rest = read_chunk(buf.data(), buf.size())) {
+                size += rest;
+            }
+            return describe_mismatch(path, g, pos + d, tail, size);
+        }
+        pos += n;
+    }
+    return pos == g.size() ? std::string() : describe_mismatch(path, g, pos, {}, pos);
+}
+
+} // namespace detail
+
+} // namespace psi::test
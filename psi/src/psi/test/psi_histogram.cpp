@@ -0,0 +1,106 @@
+#include "psi/test/psi_histogram.h"
+
+#include <format>
+#include <ostream>
+
+namespace psi::test {
+
+LatencyHistogram::LatencyHistogram(int precision)
+    : m_precision(std::clamp(precision, kMinPrecision, kMaxPrecision))
+{
+    const auto linear = size_t(1) << m_precision;
+    m_counts.resize(linear + static_cast<size_t>(64 - m_precision) * (linear >> 1));
+}
+
+uint64_t LatencyHistogram::bucket_lowest(size_t index) const
+{
+    const auto linear = uint64_t(1) << m_precision;
+    if (index < linear) {
+        return index;
+    }
+    const auto half = linear >> 1;
+    const auto shift = (index - linear) / half + 1;
+    const auto mantissa = half + (index - linear) % half;
+    return mantissa << shift;
+}
+
+uint64_t LatencyHistogram::bucket_highest(size_t index) const
+{
+    const auto linear = uint64_t(1) << m_precision;
+    if (index < linear) {
+        return index;
+    }
+    const auto shift = (index - linear) / (linear >> 1) + 1;
+    return bucket_lowest(index) + ((uint64_t(1) << shift) - 1);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    if (!other.m_total_count) {
+        return;
+    }
+    if (other.m_precision == m_precision) {
+        for (size_t i = 0; i < m_counts.size(); ++i) {
+            m_counts[i] += other.m_counts[i];
+        }
+    } else {
+        for (size_t i = 0; i < other.m_counts.size(); ++i) {
+            if (other.m_counts[i]) {
+                m_counts[bucket_index(other.bucket_lowest(i))] += other.m_counts[i];
+            }
+        }
+    }
+    m_total_count += other.m_total_count;
+    m_sum += other.m_sum;
+    m_min = std::min(m_min, other.m_min);
+    m_max = std::max(m_max, other.m_max);
+}
+
+void LatencyHistogram::reset()
+{
+    std::fill(m_counts.begin(), m_counts.end(), 0);
+    m_total_count = 0;
+    m_sum = 0;
+    m_min = std::numeric_limits<uint64_t>::max();
+    m_max = 0;
+}
+
+double LatencyHistogram::mean() const
+{
+    return m_total_count ? static_cast<double>(m_sum) / static_cast<double>(m_total_count) : 0.0;
+}
+
+uint64_t LatencyHistogram::value_at_percentile(double percentile) const
+{
+    if (!m_total_count) {
+        return 0;
+    }
+    const auto clamped = std::clamp(percentile, 0.0, 100.0);
+    auto target = static_cast<uint64_t>(clamped / 100.0 * static_cast<double>(m_total_count) + 0.5);
+    target = std::clamp<uint64_t>(target, 1, m_total_count);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < m_counts.size(); ++i) {
+        seen += m_counts[i];
+        if (seen >= target) {
+            return std::clamp(bucket_highest(i), min(), m_max);
+        }
+    }
+    return m_max;
+}
+
+void LatencyHistogram::print(std::ostream &os, const std::string &name, const char *unit) const
+{
+    os << std::format("[{}] count={} min={} p50={} p90={} p99={} p99.9={} max={} mean={:.1f} ({})\n",
+                      name,
+                      count(),
+                      min(),
+                      value_at_percentile(50.0),
+                      value_at_percentile(90.0),
+                      value_at_percentile(99.0),
+                      value_at_percentile(99.9),
+                      max(),
+                      mean(),
+                      unit);
+}
+
+} // namespace psi::test
@@ -0,0 +1,335 @@
+#include "psi/test/psi_memory.h"
+
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <new>
+
+// AddressSanitizer replaces the allocation functions itself; ours would hide its checks.
+#if defined(__SANITIZE_ADDRESS__)
+#define PSI_TEST_ASAN
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define PSI_TEST_ASAN
+#endif
+#endif
+#if !defined(PSI_TEST_NO_HEAP_TRACKING) && !defined(PSI_TEST_ASAN)
+#define PSI_TEST_HEAP_TRACKING
+#endif
+
+#if defined(_WIN32)
+#include <malloc.h>
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#else
+#include <malloc.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace psi::test {
+
+namespace {
+
+constinit std::atomic<size_t> s_heap_current {0};
+constinit std::atomic<size_t> s_heap_peak {0};
+
+[[maybe_unused]] inline size_t usable_size(void *p) noexcept
+{
+#if defined(_WIN32)
+    return _msize(p);
+#elif defined(__APPLE__)
+    return malloc_size(p);
+#else
+    return malloc_usable_size(p);
+#endif
+}
+
+[[maybe_unused]] inline size_t aligned_usable_size(void *p, std::align_val_t alignment) noexcept
+{
+#if defined(_WIN32)
+    return _aligned_msize(p, static_cast<size_t>(alignment), 0);
+#else
+    static_cast<void>(alignment);
+    return usable_size(p);
+#endif
+}
+
+[[maybe_unused]] inline void on_alloc(size_t size) noexcept
+{
+    const auto current = s_heap_current.fetch_add(size, std::memory_order_relaxed) + size;
+    auto peak = s_heap_peak.load(std::memory_order_relaxed);
+    while (current > peak && !s_heap_peak.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+    }
+}
+
+[[maybe_unused]] inline void on_free(size_t size) noexcept
+{
+    s_heap_current.fetch_sub(size, std::memory_order_relaxed);
+}
+
+/// Over-aligned allocation for the std::align_val_t overloads; nullptr on failure.
+[[maybe_unused]] inline void *aligned_malloc(size_t size, std::align_val_t alignment) noexcept
+{
+    const auto align = static_cast<size_t>(alignment);
+#if defined(_WIN32)
+    return _aligned_malloc(size ? size : 1, align);
+#else
+    void *p = nullptr;
+    return ::posix_memalign(&p, align < sizeof(void *) ? sizeof(void *) : align, size ? size : 1) == 0 ? p : nullptr;
+#endif
+}
+
+[[maybe_unused]] inline void aligned_free(void *p) noexcept
+{
+#if defined(_WIN32)
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+} // namespace
+
+bool MemoryTracker::heap_tracking_enabled()
+{
+#ifdef PSI_TEST_HEAP_TRACKING
+    return true;
+#else
+    return false;
+#endif
+}
+
+size_t MemoryTracker::current_heap_bytes()
+{
+    return s_heap_current.load(std::memory_order_relaxed);
+}
+
+size_t MemoryTracker::peak_heap_bytes()
+{
+    return s_heap_peak.load(std::memory_order_relaxed);
+}
+
+void MemoryTracker::reset_peak()
+{
+    s_heap_peak.store(s_heap_current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+size_t MemoryTracker::rss_bytes()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS pmc {};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return pmc.WorkingSetSize;
+    }
+    return 0;
+#elif defined(__linux__)
+    size_t rss_pages = 0;
+    if (auto f = std::fopen("/proc/self/statm", "r")) {
+        size_t total_pages = 0;
+        if (std::fscanf(f, "%zu %zu", &total_pages, &rss_pages) != 2) {
+            rss_pages = 0;
+        }
+        std::fclose(f);
+    }
+    return rss_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+}
+
+size_t MemoryTracker::peak_rss_bytes()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS pmc {};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return pmc.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    rusage usage {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#if defined(__APPLE__)
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+std::optional<size_t> parse_byte_size(std::string_view str)
+{
+    uint64_t value = 0;
+    const auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (ec != std::errc() || end == str.data()) {
+        return std::nullopt;
+    }
+    const auto suffix = str.substr(static_cast<size_t>(end - str.data()));
+    int shift = 0;
+    if (suffix.size() == 1) {
+        switch (std::toupper(static_cast<unsigned char>(suffix.front()))) {
+        case 'B':
+            break;
+        case 'K':
+            shift = 10;
+            break;
+        case 'M':
+            shift = 20;
+            break;
+        case 'G':
+            shift = 30;
+            break;
+        default:
+            return std::nullopt;
+        }
+    } else if (!suffix.empty()) {
+        return std::nullopt;
+    }
+    if (value > (std::numeric_limits<size_t>::max() >> shift)) {
+        return std::nullopt;
+    }
+    return static_cast<size_t>(value) << shift;
+}
+
+} // namespace psi::test
+
+#ifdef PSI_TEST_HEAP_TRACKING
+
+// Replacing the global allocation functions here is enough: this translation unit is always linked
+// together with TestLib, which references MemoryTracker.
+
+void *operator new(std::size_t size)
+{
+    void *p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    psi::test::on_alloc(psi::test::usable_size(p));
+    return p;
+}
+
+void *operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    void *p = std::malloc(size ? size : 1);
+    if (p) {
+        psi::test::on_alloc(psi::test::usable_size(p));
+    }
+    return p;
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept
+{
+    return ::operator new(size, tag);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    void *p = psi::test::aligned_malloc(size, alignment);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    psi::test::on_alloc(psi::test::aligned_usable_size(p, alignment));
+    return p;
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return ::operator new(size, alignment);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    void *p = psi::test::aligned_malloc(size, alignment);
+    if (p) {
+        psi::test::on_alloc(psi::test::aligned_usable_size(p, alignment));
+    }
+    return p;
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &tag) noexcept
+{
+    return ::operator new(size, alignment, tag);
+}
+
+void operator delete(void *p) noexcept
+{
+    if (p) {
+        psi::test::on_free(psi::test::usable_size(p));
+        std::free(p);
+    }
+}
+
+void operator delete[](void *p) noexcept
+{
+    ::operator delete(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    ::operator delete(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    ::operator delete(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    ::operator delete(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    ::operator delete(p);
+}
+
+void operator delete(void *p, std::align_val_t alignment) noexcept
+{
+    if (p) {
+        psi::test::on_free(psi::test::aligned_usable_size(p, alignment));
+        psi::test::aligned_free(p);
+    }
+}
+
+void operator delete[](void *p, std::align_val_t alignment) noexcept
+{
+    ::operator delete(p, alignment);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t alignment) noexcept
+{
+    ::operator delete(p, alignment);
+}
+
+void operator delete[](void *p, std::size_t, std::align_val_t alignment) noexcept
+{
+    ::operator delete(p, alignment);
+}
+
+void operator delete(void *p, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    ::operator delete(p, alignment);
+}
+
+void operator delete[](void *p, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    ::operator delete(p, alignment);
+}
+
+#endif
@@ -1,8 +1,47 @@
 
 #include "psi/test/psi_mock.h"
 
+#include <cstring>
+
 namespace psi::test {
 
+namespace detail {
+
+size_t find_first_difference(const void *a, const void *b, size_t size) noexcept
+{
+    // memcmp is vectorized by the C library; blocks keep the final byte scan short.
+    static constexpr size_t kBlock = 4096;
+    const auto *pa = static_cast<const unsigned char *>(a);
+    const auto *pb = static_cast<const unsigned char *>(b);
+    size_t offset = 0;
+    while (offset < size) {
+        const size_t block = std::min(kBlock, size - offset);
+        if (std::memcmp(pa + offset, pb + offset, block) != 0) {
+            while (pa[offset] == pb[offset]) {
+                ++offset;
+            }
+            return offset;
+        }
+        offset += block;
+    }
+    return size;
+}
+
+std::string bytes_to_hex(const void *data, size_t size)
+{
+    static constexpr char kDigits[] = "0123456789abcdef";
+    const auto *p = static_cast<const unsigned char *>(data);
+    std::string result;
+    result.reserve(size * 2);
+    for (size_t i = 0; i < size; ++i) {
+        result += kDigits[p[i] >> 4];
+        result += kDigits[p[i] & 0xf];
+    }
+    return result;
+}
+
+} // namespace detail
+
 void MOCK_VERIFY_EXPECTATIONS()
 {
     if (auto ptr = TestLib::fn_expectations()) {
@@ -0,0 +1,294 @@
+#include "psi/test/psi_profile.h"
+
+#include "psi/test/psi_test.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32) && __has_include(<execinfo.h>) && __has_include(<dlfcn.h>)
+#include <cerrno>
+#include <csignal>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <sys/time.h>
+#define PSI_PROFILE_SUPPORTED
+#endif
+
+namespace psi::test {
+
+namespace {
+
+// 16K samples of up to 64 frames (about 8 MB): 16 s of samples at 1 kHz before the drain thread has to run.
+constexpr size_t kRingSlots = 1 << 14;
+constexpr int kMaxFrames = 64;
+// The signal handler itself and the kernel's signal trampoline.
+constexpr int kSkipFrames = 2;
+constexpr auto kDrainInterval = std::chrono::milliseconds(20);
+
+struct Slot {
+    std::atomic<uint32_t> m_ready {0};
+    int m_depth = 0;
+    const TestLib::TestCase *m_test = nullptr;
+    void *m_frames[kMaxFrames];
+};
+
+using Stacks = std::map<std::vector<void *>, size_t>;
+
+struct ProfileState {
+    /// Slots [m_tail, m_head) are claimed by the signal handler; m_ready tells which ones it has finished.
+    std::vector<Slot> m_slots;
+    std::atomic<uint64_t> m_head {0};
+    std::atomic<uint64_t> m_tail {0};
+    std::atomic<size_t> m_dropped {0};
+    std::atomic<bool> m_sampling {false};
+
+    std::mutex m_mutex;
+    std::map<const TestLib::TestCase *, Stacks> m_stacks;
+    size_t m_samples = 0;
+    std::thread m_drain_thread;
+    std::atomic<bool> m_stop_drain {false};
+};
+
+ProfileState *s_state = nullptr;
+
+ProfileState &state()
+{
+    static auto *instance = new ProfileState();
+    return *instance;
+}
+
+/// Moves finished samples from the ring into the aggregated stacks. Caller holds m_mutex.
+void drain(ProfileState &s)
+{
+    auto tail = s.m_tail.load(std::memory_order_relaxed);
+    const auto head = s.m_head.load(std::memory_order_acquire);
+    for (; tail != head; ++tail) {
+        auto &slot = s.m_slots[tail % kRingSlots];
+        if (!slot.m_ready.load(std::memory_order_acquire)) {
+            break; // still being written by a handler
+        }
+        if (slot.m_depth > kSkipFrames) {
+            ++s.m_stacks[slot.m_test][std::vector<void *>(slot.m_frames + kSkipFrames, slot.m_frames + slot.m_depth)];
+            ++s.m_samples;
+        }
+        slot.m_ready.store(0, std::memory_order_relaxed);
+        s.m_tail.store(tail + 1, std::memory_order_release);
+    }
+}
+
+#ifdef PSI_PROFILE_SUPPORTED
+
+/// POSIX does not list backtrace() as async-signal-safe, and the warm-up in start() only covers loading the
+/// unwinder: unwinding still takes locks of the unwinder and the dynamic loader (dl_iterate_phdr) and may call
+/// malloc on some libcs, so a sample that interrupts one of those in the same thread can deadlock. In practice this
+/// is rare enough for a diagnostic tool, which is why the risk is accepted rather than unwinding by hand.
+void on_sigprof(int, siginfo_t *, void *)
+{
+    auto *s = s_state;
+    if (!s || !s->m_sampling.load(std::memory_order_relaxed)) {
+        return;
+    }
+    const int saved_errno = errno;
+    auto head = s->m_head.load(std::memory_order_relaxed);
+    do {
+        if (head - s->m_tail.load(std::memory_order_acquire) >= kRingSlots) {
+            s->m_dropped.fetch_add(1, std::memory_order_relaxed);
+            errno = saved_errno;
+            return;
+        }
+    } while (!s->m_head.compare_exchange_weak(head, head + 1, std::memory_order_acq_rel, std::memory_order_relaxed));
+    auto &slot = s->m_slots[head % kRingSlots];
+    slot.m_test = TestLib::current_running_test();
+    slot.m_depth = ::backtrace(slot.m_frames, kMaxFrames);
+    slot.m_ready.store(1, std::memory_order_release);
+    errno = saved_errno;
+}
+
+bool set_timer(int hz)
+{
+    itimerval timer {};
+    if (hz > 0) {
+        timer.it_interval.tv_usec = std::max(1, 1000000 / hz);
+        timer.it_value = timer.it_interval;
+    }
+    return ::setitimer(ITIMER_PROF, &timer, nullptr) == 0;
+}
+
+/// Function name of a frame, or module+offset when the symbol is not exported. Return addresses point after
+/// the call, so they are looked up one byte earlier.
+std::string frame_name(void *address, bool return_address)
+{
+    const auto *pc = static_cast<const char *>(address) - (return_address ? 1 : 0);
+    Dl_info info {};
+    if (!::dladdr(pc, &info)) {
+        return std::format("0x{:x}", reinterpret_cast<uintptr_t>(address));
+    }
+    if (info.dli_sname) {
+        int status = 0;
+        char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string name = status == 0 && demangled ? demangled : info.dli_sname;
+        std::free(demangled);
+        std::replace(name.begin(), name.end(), ';', ':');
+        return name;
+    }
+    std::string module = info.dli_fname ? info.dli_fname : "?";
+    module = module.substr(module.rfind('/') + 1);
+    return std::format("{}+0x{:x}", module, static_cast<size_t>(pc - static_cast<const char *>(info.dli_fbase)));
+}
+
+#else
+
+std::string frame_name(void *address, bool)
+{
+    return std::format("0x{:x}", reinterpret_cast<uintptr_t>(address));
+}
+
+#endif
+
+} // namespace
+
+bool SamplingProfiler::supported()
+{
+#ifdef PSI_PROFILE_SUPPORTED
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool SamplingProfiler::start(int hz)
+{
+#ifdef PSI_PROFILE_SUPPORTED
+    auto &s = state();
+    std::lock_guard lock(s.m_mutex);
+    if (s.m_sampling.load() || hz <= 0) {
+        return false;
+    }
+    // The first backtrace() loads the unwinder, which is not async-signal-safe; do it here.
+    void *warm_up[4];
+    ::backtrace(warm_up, 4);
+    if (s.m_slots.empty()) {
+        s.m_slots = std::vector<Slot>(kRingSlots);
+    }
+
+    s_state = &s;
+    // The handler stays installed after stop(): a SIGPROF still pending then must not hit the default action,
+    // which terminates the process.
+    struct sigaction action {};
+    action.sa_sigaction = &on_sigprof;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (::sigaction(SIGPROF, &action, nullptr) != 0) {
+        return false;
+    }
+    s.m_sampling.store(true);
+    if (!set_timer(hz)) {
+        s.m_sampling.store(false);
+        return false;
+    }
+    s.m_stop_drain.store(false);
+    s.m_drain_thread = std::thread([&s]() {
+        while (!s.m_stop_drain.load(std::memory_order_relaxed)) {
+            std::this_thread::sleep_for(kDrainInterval);
+            std::lock_guard drain_lock(s.m_mutex);
+            drain(s);
+        }
+    });
+    return true;
+#else
+    static_cast<void>(hz);
+    return false;
+#endif
+}
+
+void SamplingProfiler::stop()
+{
+#ifdef PSI_PROFILE_SUPPORTED
+    auto &s = state();
+    if (!s.m_sampling.load()) {
+        return;
+    }
+    set_timer(0);
+    s.m_sampling.store(false);
+    s.m_stop_drain.store(true);
+    s.m_drain_thread.join();
+    std::lock_guard lock(s.m_mutex);
+    drain(s);
+#endif
+}
+
+bool SamplingProfiler::running()
+{
+    return s_state && s_state->m_sampling.load();
+}
+
+size_t SamplingProfiler::sample_count()
+{
+    auto &s = state();
+    std::lock_guard lock(s.m_mutex);
+    drain(s);
+    return s.m_samples;
+}
+
+size_t SamplingProfiler::dropped_count()
+{
+    return state().m_dropped.load();
+}
+
+bool SamplingProfiler::write(const std::string &path)
+{
+    auto &s = state();
+    std::lock_guard lock(s.m_mutex);
+    drain(s);
+
+    // Test names are looked up now: the samples point at registered tests, which outlive the run.
+    std::map<std::string, std::map<std::string, size_t>> sections;
+    for (const auto &[test, stacks] : s.m_stacks) {
+        const auto test_name = test ? test->m_test_group + "." + test->m_test_name : std::string("(no test)");
+        auto &folded = sections[test_name];
+        for (const auto &[frames, count] : stacks) {
+            std::string line = test_name;
+            // backtrace() lists the innermost frame first; folded stacks start at the root.
+            for (size_t i = frames.size(); i-- > 0;) {
+                line += ';';
+                line += frame_name(frames[i], i > 0);
+            }
+            folded[line] += count;
+        }
+    }
+
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+    for (const auto &[test_name, folded] : sections) {
+        std::vector<std::pair<std::string, size_t>> lines(folded.begin(), folded.end());
+        std::stable_sort(lines.begin(), lines.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+        size_t samples = 0;
+        for (const auto &line : lines) {
+            samples += line.second;
+        }
+        out << "# " << test_name << ": " << samples << " samples\n";
+        for (const auto &[line, count] : lines) {
+            out << line << ' ' << count << '\n';
+        }
+    }
+    if (const auto dropped = s.m_dropped.load()) {
+        out << "# dropped: " << dropped << " samples (ring full)\n";
+    }
+    s.m_stacks.clear();
+    s.m_samples = 0;
+    s.m_dropped.store(0);
+    return static_cast<bool>(out);
+}
+
+} // namespace psi::test
@@ -0,0 +1,677 @@
+#include "psi/test/psi_search.h"
+
+#include <bit>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PSI_SEARCH_SSE2
+#endif
+
+namespace psi::test {
+
+namespace {
+
+using Op = detail::RegexInst::Op;
+
+constexpr int kMaxRepeat = 1000;
+constexpr size_t kMaxProgram = 100000;
+
+/// Position of needle (at least 2 bytes) in haystack at or after `from`, checking its middle only where the
+/// first and last bytes match.
+size_t find_scalar(std::string_view haystack, std::string_view needle, size_t from) noexcept
+{
+    const size_t last = needle.size() - 1;
+    const size_t end = haystack.size() - needle.size();
+    while (from <= end) {
+        const void *p = std::memchr(haystack.data() + from, needle[0], end - from + 1);
+        if (!p) {
+            return std::string_view::npos;
+        }
+        from = static_cast<size_t>(static_cast<const char *>(p) - haystack.data());
+        if (haystack[from + last] == needle[last]
+            && std::memcmp(haystack.data() + from + 1, needle.data() + 1, last - 1) == 0) {
+            return from;
+        }
+        ++from;
+    }
+    return std::string_view::npos;
+}
+
+bool is_word(unsigned char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+struct RegexError {
+    std::string m_what;
+};
+
+/// Parse tree of a pattern; repeats are expanded when the program is emitted.
+struct Node {
+    enum class Kind : uint8_t { empty, byte, byte_class, assertion, concat, alternate, repeat };
+    Kind m_kind = Kind::empty;
+    uint8_t m_byte = 0;
+    Op m_assertion = Op::text_begin;
+    uint32_t m_class = 0;
+    int m_min = 0;
+    int m_max = 0; // -1: unbounded
+    std::vector<size_t> m_children {};
+};
+
+class Compiler
+{
+public:
+    Compiler(std::string_view pattern, std::vector<detail::ByteClass> &classes, std::vector<detail::RegexInst> &program)
+        : m_pattern(pattern)
+        , m_classes(classes)
+        , m_program(program)
+    {
+    }
+
+    /// Compiles the pattern; the first node of the tree is returned for prefix extraction.
+    const Node &compile()
+    {
+        const size_t root = parse_alternation();
+        if (m_pos < m_pattern.size()) {
+            fail("unmatched ')'");
+        }
+        emit(root);
+        push({Op::match});
+        return m_nodes[root];
+    }
+    const Node &node(size_t index) const
+    {
+        return m_nodes[index];
+    }
+
+private:
+    [[noreturn]] void fail(const std::string &what) const
+    {
+        throw RegexError {what + " at offset " + std::to_string(m_pos)};
+    }
+    bool at_end() const
+    {
+        return m_pos >= m_pattern.size();
+    }
+    char peek() const
+    {
+        return m_pattern[m_pos];
+    }
+    size_t add_node(Node node)
+    {
+        m_nodes.push_back(std::move(node));
+        return m_nodes.size() - 1;
+    }
+    size_t byte_node(unsigned char c)
+    {
+        return add_node({.m_kind = Node::Kind::byte, .m_byte = c});
+    }
+    size_t class_node(const detail::ByteClass &cls)
+    {
+        m_classes.push_back(cls);
+        return add_node({.m_kind = Node::Kind::byte_class, .m_class = static_cast<uint32_t>(m_classes.size() - 1)});
+    }
+
+    size_t parse_alternation()
+    {
+        std::vector<size_t> branches {parse_concat()};
+        while (!at_end() && peek() == '|') {
+            ++m_pos;
+            branches.push_back(parse_concat());
+        }
+        return branches.size() == 1 ? branches[0]
+                                    : add_node({.m_kind = Node::Kind::alternate, .m_children = std::move(branches)});
+    }
+
+    size_t parse_concat()
+    {
+        std::vector<size_t> items;
+        while (!at_end() && peek() != '|' && peek() != ')') {
+            items.push_back(parse_repeat());
+        }
+        if (items.size() == 1) {
+            return items[0];
+        }
+        return add_node({.m_kind = items.empty() ? Node::Kind::empty : Node::Kind::concat, .m_children = items});
+    }
+
+    size_t parse_repeat()
+    {
+        size_t atom = parse_atom();
+        while (!at_end()) {
+            int min = 0;
+            int max = -1;
+            const size_t start = m_pos;
+            const char c = peek();
+            if (c == '*') {
+                ++m_pos;
+            } else if (c == '+') {
+                min = 1;
+                ++m_pos;
+            } else if (c == '?') {
+                max = 1;
+                ++m_pos;
+            } else if (c != '{' || !parse_bounds(min, max)) {
+                break;
+            }
+            if (m_nodes[atom].m_kind == Node::Kind::empty) {
+                m_pos = start;
+                fail("nothing to repeat");
+            }
+            if (!at_end() && peek() == '?') {
+                ++m_pos; // lazy: same language, and only whether there is a match is reported
+            }
+            atom = add_node({.m_kind = Node::Kind::repeat, .m_min = min, .m_max = max, .m_children = {atom}});
+        }
+        return atom;
+    }
+
+    /// {m}, {m,} or {m,n}; false (and nothing consumed) when the brace does not start a valid bound, in which
+    /// case it is a literal.
+    bool parse_bounds(int &min, int &max)
+    {
+        size_t pos = m_pos + 1;
+        auto number = [&](int &out) {
+            const size_t begin = pos;
+            long long value = 0;
+            while (pos < m_pattern.size() && m_pattern[pos] >= '0' && m_pattern[pos] <= '9') {
+                value = std::min<long long>(value * 10 + (m_pattern[pos++] - '0'), kMaxRepeat + 1);
+            }
+            out = static_cast<int>(value);
+            return pos > begin;
+        };
+        if (!number(min)) {
+            return false;
+        }
+        max = min;
+        if (pos < m_pattern.size() && m_pattern[pos] == ',') {
+            ++pos;
+            max = -1;
+            if (pos < m_pattern.size() && m_pattern[pos] != '}' && !number(max)) {
+                return false;
+            }
+        }
+        if (pos >= m_pattern.size() || m_pattern[pos] != '}') {
+            return false;
+        }
+        m_pos = pos + 1;
+        if (min > kMaxRepeat || max > kMaxRepeat) {
+            fail("repeat count above " + std::to_string(kMaxRepeat));
+        }
+        if (max != -1 && max < min) {
+            fail("repeat bounds out of order");
+        }
+        return true;
+    }
+
+    size_t parse_atom()
+    {
+        const char c = m_pattern[m_pos++];
+        switch (c) {
+        case '(': {
+            if (m_pattern.substr(m_pos).starts_with("?:")) {
+                m_pos += 2;
+            } else if (!at_end() && peek() == '?') {
+                fail("unsupported group");
+            }
+            const size_t inner = parse_alternation();
+            if (at_end() || peek() != ')') {
+                fail("missing ')'");
+            }
+            ++m_pos;
+            return inner;
+        }
+        case '[':
+            return parse_class();
+        case '.': {
+            detail::ByteClass cls;
+            for (int b = 0; b < 256; ++b) {
+                if (b != '\n') {
+                    cls.add(static_cast<unsigned char>(b));
+                }
+            }
+            return class_node(cls);
+        }
+        case '^':
+            return add_node({.m_kind = Node::Kind::assertion, .m_assertion = Op::text_begin});
+        case '$':
+            return add_node({.m_kind = Node::Kind::assertion, .m_assertion = Op::text_end});
+        case '*':
+        case '+':
+        case '?':
+            --m_pos;
+            fail("nothing to repeat");
+        case '\\':
+            return parse_escape();
+        default:
+            return byte_node(static_cast<unsigned char>(c));
+        }
+    }
+
+    /// Adds the class of a \d \w \s escape (or its complement) to cls; false for other escapes.
+    static bool add_shorthand(char c, detail::ByteClass &cls)
+    {
+        bool (*member)(unsigned char) = nullptr;
+        switch (c | 0x20) {
+        case 'd':
+            member = [](unsigned char b) { return b >= '0' && b <= '9'; };
+            break;
+        case 'w':
+            member = is_word;
+            break;
+        case 's':
+            member = [](unsigned char b) { return b == ' ' || (b >= '\t' && b <= '\r'); };
+            break;
+        default:
+            return false;
+        }
+        const bool negate = c >= 'A' && c <= 'Z';
+        for (int b = 0; b < 256; ++b) {
+            if (member(static_cast<unsigned char>(b)) != negate) {
+                cls.add(static_cast<unsigned char>(b));
+            }
+        }
+        return true;
+    }
+
+    /// The byte of a single-character escape (after the backslash).
+    unsigned char escaped_byte()
+    {
+        if (at_end()) {
+            fail("trailing '\\'");
+        }
+        const char c = m_pattern[m_pos++];
+        switch (c) {
+        case 'n':
+            return '\n';
+        case 't':
+            return '\t';
+        case 'r':
+            return '\r';
+        case 'f':
+            return '\f';
+        case 'v':
+            return '\v';
+        case '0':
+            return '\0';
+        case 'x': {
+            auto hex = [&](char h) -> int {
+                if (h >= '0' && h <= '9') {
+                    return h - '0';
+                }
+                h = static_cast<char>(h | 0x20);
+                return h >= 'a' && h <= 'f' ? h - 'a' + 10 : -1;
+            };
+            const int hi = m_pos < m_pattern.size() ? hex(m_pattern[m_pos]) : -1;
+            const int lo = m_pos + 1 < m_pattern.size() ? hex(m_pattern[m_pos + 1]) : -1;
+            if (hi < 0 || lo < 0) {
+                fail("bad \\x escape");
+            }
+            m_pos += 2;
+            return static_cast<unsigned char>(hi * 16 + lo);
+        }
+        default:
+            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '1' && c <= '9')) {
+                --m_pos;
+                fail(std::string("unsupported escape \\") + c);
+            }
+            return static_cast<unsigned char>(c);
+        }
+    }
+
+    size_t parse_escape()
+    {
+        if (!at_end()) {
+            const char c = peek();
+            if (c == 'b' || c == 'B') {
+                ++m_pos;
+                return add_node({.m_kind = Node::Kind::assertion,
+                                 .m_assertion = c == 'b' ? Op::word_boundary : Op::not_word_boundary});
+            }
+            detail::ByteClass cls;
+            if (add_shorthand(c, cls)) {
+                ++m_pos;
+                return class_node(cls);
+            }
+        }
+        return byte_node(escaped_byte());
+    }
+
+    size_t parse_class()
+    {
+        detail::ByteClass cls;
+        const bool negate = !at_end() && peek() == '^';
+        m_pos += negate;
+        bool first = true;
+        while (true) {
+            if (at_end()) {
+                fail("missing ']'");
+            }
+            char c = m_pattern[m_pos++];
+            if (c == ']' && !first) {
+                break;
+            }
+            first = false;
+            unsigned char lo = static_cast<unsigned char>(c);
+            if (c == '\\') {
+                if (!at_end() && add_shorthand(peek(), cls)) {
+                    ++m_pos;
+                    continue;
+                }
+                if (!at_end() && peek() == 'b') {
+                    ++m_pos;
+                    lo = '\b';
+                } else {
+                    lo = escaped_byte();
+                }
+            }
+            unsigned char hi = lo;
+            if (m_pos + 1 < m_pattern.size() && peek() == '-' && m_pattern[m_pos + 1] != ']') {
+                ++m_pos;
+                c = m_pattern[m_pos++];
+                hi = c == '\\' ? escaped_byte() : static_cast<unsigned char>(c);
+                if (hi < lo) {
+                    fail("class range out of order");
+                }
+            }
+            for (int b = lo; b <= hi; ++b) {
+                cls.add(static_cast<unsigned char>(b));
+            }
+        }
+        if (negate) {
+            for (auto &word : cls.m_bits) {
+                word = ~word;
+            }
+        }
+        return class_node(cls);
+    }
+
+    uint32_t push(detail::RegexInst inst)
+    {
+        if (m_program.size() == kMaxProgram) {
+            throw RegexError {"pattern too large"};
+        }
+        m_program.push_back(inst);
+        return static_cast<uint32_t>(m_program.size() - 1);
+    }
+    uint32_t next_pc() const
+    {
+        return static_cast<uint32_t>(m_program.size());
+    }
+
+    void emit(size_t index)
+    {
+        const Node &n = m_nodes[index];
+        switch (n.m_kind) {
+        case Node::Kind::empty:
+            break;
+        case Node::Kind::byte:
+            push({Op::byte, n.m_byte});
+            break;
+        case Node::Kind::byte_class:
+            push({Op::byte_class, 0, n.m_class});
+            break;
+        case Node::Kind::assertion:
+            push({n.m_assertion});
+            break;
+        case Node::Kind::concat:
+            for (const size_t child : n.m_children) {
+                emit(child);
+            }
+            break;
+        case Node::Kind::alternate: {
+            std::vector<uint32_t> jumps;
+            for (size_t i = 0; i + 1 < n.m_children.size(); ++i) {
+                const uint32_t split = push({Op::split});
+                m_program[split].m_x = next_pc();
+                emit(n.m_children[i]);
+                jumps.push_back(push({Op::jump}));
+                m_program[split].m_y = next_pc();
+            }
+            emit(n.m_children.back());
+            for (const uint32_t jump : jumps) {
+                m_program[jump].m_x = next_pc();
+            }
+            break;
+        }
+        case Node::Kind::repeat: {
+            const size_t child = n.m_children[0];
+            for (int i = 0; i < n.m_min; ++i) {
+                emit(child);
+            }
+            if (n.m_max == -1) {
+                const uint32_t split = push({Op::split});
+                m_program[split].m_x = next_pc();
+                emit(child);
+                push({Op::jump, 0, split});
+                m_program[split].m_y = next_pc();
+            } else {
+                std::vector<uint32_t> splits;
+                for (int i = n.m_min; i < n.m_max; ++i) {
+                    splits.push_back(push({Op::split}));
+                    m_program[splits.back()].m_x = next_pc();
+                    emit(child);
+                }
+                for (const uint32_t split : splits) {
+                    m_program[split].m_y = next_pc();
+                }
+            }
+            break;
+        }
+        }
+    }
+
+    std::string_view m_pattern;
+    size_t m_pos = 0;
+    std::vector<Node> m_nodes;
+    std::vector<detail::ByteClass> &m_classes;
+    std::vector<detail::RegexInst> &m_program;
+};
+
+/// Per-thread thread lists of the VM, reused by every search so a warm search does not allocate.
+struct VmScratch {
+    std::vector<uint32_t> m_current;
+    std::vector<uint32_t> m_next;
+    std::vector<uint32_t> m_stack;
+    /// m_marks[pc] == m_generation: pc is already on the list of the current position.
+    std::vector<uint32_t> m_marks;
+    uint32_t m_generation = 0;
+
+    void prepare(size_t program_size)
+    {
+        if (m_marks.size() < program_size) {
+            m_marks.resize(program_size, 0);
+            m_current.reserve(program_size);
+            m_next.reserve(program_size);
+            m_stack.reserve(program_size);
+        }
+        m_current.clear();
+        m_next.clear();
+    }
+    void next_generation()
+    {
+        if (++m_generation == 0) {
+            std::fill(m_marks.begin(), m_marks.end(), 0);
+            m_generation = 1;
+        }
+    }
+};
+
+thread_local VmScratch s_vm;
+
+} // namespace
+
+size_t find_substring(std::string_view haystack, std::string_view needle) noexcept
+{
+    if (needle.empty()) {
+        return 0;
+    }
+    if (needle.size() > haystack.size()) {
+        return std::string_view::npos;
+    }
+    if (needle.size() == 1) {
+        const void *p = std::memchr(haystack.data(), needle[0], haystack.size());
+        return p ? static_cast<size_t>(static_cast<const char *>(p) - haystack.data()) : std::string_view::npos;
+    }
+    size_t i = 0;
+#ifdef PSI_SEARCH_SSE2
+    // Positions whose first and last bytes both match, 16 at a time; only those are compared in full.
+    const size_t last = needle.size() - 1;
+    const size_t end = haystack.size() - needle.size(); // last possible start
+    const __m128i first_v = _mm_set1_epi8(needle[0]);
+    const __m128i last_v = _mm_set1_epi8(needle[last]);
+    for (; i + 15 <= end; i += 16) {
+        const auto *p = reinterpret_cast<const __m128i *>(haystack.data() + i);
+        const auto *q = reinterpret_cast<const __m128i *>(haystack.data() + i + last);
+        const __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(p), first_v),
+                                         _mm_cmpeq_epi8(_mm_loadu_si128(q), last_v));
+        for (auto mask = static_cast<unsigned>(_mm_movemask_epi8(eq)); mask != 0; mask &= mask - 1) {
+            const size_t at = i + static_cast<size_t>(std::countr_zero(mask));
+            if (std::memcmp(haystack.data() + at + 1, needle.data() + 1, last - 1) == 0) {
+                return at;
+            }
+        }
+    }
+#endif
+    return find_scalar(haystack, needle, i);
+}
+
+Regex::Regex(std::string_view pattern)
+    : m_pattern(pattern)
+{
+    try {
+        Compiler compiler(pattern, m_classes, m_program);
+        const Node &root = compiler.compile();
+        // Literal bytes at the start of the top-level sequence (after a leading ^) begin every match.
+        std::vector<const Node *> items {&root};
+        if (root.m_kind == Node::Kind::concat) {
+            items.clear();
+            for (const size_t child : root.m_children) {
+                items.push_back(&compiler.node(child));
+            }
+        }
+        m_anchored = items[0]->m_kind == Node::Kind::assertion && items[0]->m_assertion == Op::text_begin;
+        for (size_t i = m_anchored ? 1 : 0; i < items.size() && items[i]->m_kind == Node::Kind::byte; ++i) {
+            m_prefix += static_cast<char>(items[i]->m_byte);
+        }
+    } catch (const RegexError &e) {
+        m_error = e.m_what;
+        m_program.clear();
+        m_classes.clear();
+    }
+}
+
+const Regex &Regex::cached(std::string_view pattern)
+{
+    static std::mutex s_mutex;
+    static auto *s_cache = new std::map<std::string, std::unique_ptr<Regex>, std::less<>>();
+    std::lock_guard lock(s_mutex);
+    auto it = s_cache->find(pattern);
+    if (it == s_cache->end()) {
+        it = s_cache->emplace(std::string(pattern), std::make_unique<Regex>(pattern)).first;
+    }
+    return *it->second;
+}
+
+bool Regex::search(std::string_view text) const
+{
+    if (!valid()) {
+        return false;
+    }
+    auto &vm = s_vm;
+    vm.prepare(m_program.size());
+    const auto *bytes = reinterpret_cast<const unsigned char *>(text.data());
+
+    // Follows jumps, splits and assertions from pc at pos, adding the byte-consuming instructions to list.
+    // True when the match instruction is reached.
+    auto add = [&](std::vector<uint32_t> &list, uint32_t start_pc, size_t pos) {
+        vm.m_stack.clear();
+        vm.m_stack.push_back(start_pc);
+        while (!vm.m_stack.empty()) {
+            const uint32_t pc = vm.m_stack.back();
+            vm.m_stack.pop_back();
+            if (vm.m_marks[pc] == vm.m_generation) {
+                continue;
+            }
+            vm.m_marks[pc] = vm.m_generation;
+            const auto &inst = m_program[pc];
+            switch (inst.m_op) {
+            case Op::byte:
+            case Op::byte_class:
+                list.push_back(pc);
+                break;
+            case Op::match:
+                return true;
+            case Op::jump:
+                vm.m_stack.push_back(inst.m_x);
+                break;
+            case Op::split:
+                vm.m_stack.push_back(inst.m_y);
+                vm.m_stack.push_back(inst.m_x);
+                break;
+            case Op::text_begin:
+                if (pos == 0) {
+                    vm.m_stack.push_back(pc + 1);
+                }
+                break;
+            case Op::text_end:
+                if (pos == text.size()) {
+                    vm.m_stack.push_back(pc + 1);
+                }
+                break;
+            case Op::word_boundary:
+            case Op::not_word_boundary: {
+                const bool before = pos > 0 && is_word(bytes[pos - 1]);
+                const bool after = pos < text.size() && is_word(bytes[pos]);
+                if ((before != after) == (inst.m_op == Op::word_boundary)) {
+                    vm.m_stack.push_back(pc + 1);
+                }
+                break;
+            }
+            }
+        }
+        return false;
+    };
+
+    vm.next_generation();
+    for (size_t pos = 0;; ++pos) {
+        if (vm.m_current.empty()) {
+            if (m_anchored && pos > 0) {
+                return false;
+            }
+            if (!m_prefix.empty()) {
+                const size_t at = find_substring(text.substr(pos), m_prefix);
+                if (at == std::string_view::npos) {
+                    return false;
+                }
+                if (at > 0) {
+                    pos += at;
+                    vm.next_generation();
+                }
+            }
+        }
+        if ((!m_anchored || pos == 0) && add(vm.m_current, 0, pos)) {
+            return true;
+        }
+        if (pos == text.size()) {
+            return false;
+        }
+        const unsigned char c = bytes[pos];
+        vm.next_generation();
+        vm.m_next.clear();
+        for (const uint32_t pc : vm.m_current) {
+            const auto &inst = m_program[pc];
+            const bool step = inst.m_op == Op::byte ? inst.m_byte == c : m_classes[inst.m_x].contains(c);
+            if (step && add(vm.m_next, pc + 1, pos + 1)) {
+                return true;
+            }
+        }
+        std::swap(vm.m_current, vm.m_next);
+    }
+}
+
+} // namespace psi::test
@@ -0,0 +1,239 @@
+#include "psi/test/psi_serve.h"
+
+#include "psi/test/psi_test.h"
+#include "psi_socket.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <string_view>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace psi::test {
+
+namespace {
+
+#if !defined(_WIN32)
+
+constexpr std::string_view kExitTrailer = "[PSI-SERVE] exit ";
+
+std::string socket_path(const std::string &address)
+{
+    if (!address.starts_with("unix:") || address.size() == 5) {
+        std::cerr << "[PSI-TEST] unsupported address " << address << ", expected unix:/path" << std::endl;
+        return {};
+    }
+    return address.substr(5);
+}
+
+/// Fills addr for path; false (with a message) if the path does not fit sun_path.
+bool make_address(const std::string &path, sockaddr_un &addr)
+{
+    addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "[PSI-TEST] socket path too long: " << path << std::endl;
+        return false;
+    }
+    path.copy(addr.sun_path, path.size());
+    return true;
+}
+
+/// Request: one argument per line, terminated by an empty line.
+bool read_request(int fd, std::vector<std::string> &args)
+{
+    detail::SocketReader reader(fd);
+    std::string line;
+    while (reader.read_line(line)) {
+        if (line.empty()) {
+            return true;
+        }
+        args.push_back(line);
+    }
+    return false;
+}
+
+int run_request(int client, const std::vector<std::string> &args)
+{
+    for (const auto &arg : args) {
+        if (detail::is_mode_flag(arg)) {
+            detail::write_all(client, std::format("[PSI-TEST] {} cannot be sent to a --psi_serve process\n", arg));
+            return 1;
+        }
+    }
+    std::string program = "psi-serve";
+    std::vector<char *> argv {program.data()};
+    auto kept = args;
+    for (auto &arg : kept) {
+        argv.push_back(arg.data());
+    }
+    const auto opts = TestLib::parse_args(argv);
+    TestLib::reset_test_state();
+
+    std::cout.flush();
+    std::fflush(nullptr);
+    const int saved_out = ::dup(1);
+    const int saved_err = ::dup(2);
+    ::dup2(client, 1);
+    ::dup2(client, 2);
+    const int code = TestLib::run(opts);
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+    ::dup2(saved_out, 1);
+    ::dup2(saved_err, 2);
+    ::close(saved_out);
+    ::close(saved_err);
+    return code;
+}
+
+#endif
+
+} // namespace
+
+#if defined(_WIN32)
+
+int TestServer::serve(const std::string &, size_t)
+{
+    std::cerr << "[PSI-TEST] --psi_serve is not supported on this platform" << std::endl;
+    return 1;
+}
+
+int TestServer::request(const std::string &, const std::vector<std::string> &)
+{
+    std::cerr << "[PSI-TEST] --psi_connect is not supported on this platform" << std::endl;
+    return 1;
+}
+
+#else
+
+int TestServer::serve(const std::string &address, size_t max_requests)
+{
+    const auto path = socket_path(address);
+    sockaddr_un addr;
+    if (path.empty() || !make_address(path, addr)) {
+        return 1;
+    }
+    const int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        std::cerr << "[PSI-TEST] cannot create socket: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    ::unlink(path.c_str()); // stale socket of a previous server
+    if (::bind(listen_fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listen_fd, 8) != 0) {
+        std::cerr << "[PSI-TEST] cannot listen on " << path << ": " << std::strerror(errno) << std::endl;
+        ::close(listen_fd);
+        return 1;
+    }
+    // A client going away mid-run must not kill the server.
+    std::signal(SIGPIPE, SIG_IGN);
+    std::cout << "[PSI-SERVE] listening on unix:" << path << std::endl;
+
+    for (size_t served = 0; max_requests == 0 || served < max_requests;) {
+        const int client = ::accept(listen_fd, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "[PSI-TEST] accept failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        std::vector<std::string> args;
+        if (read_request(client, args)) {
+            const auto start = std::chrono::steady_clock::now();
+            const int code = run_request(client, args);
+            detail::write_all(client, std::format("{}{}\n", kExitTrailer, code));
+            const auto ms =
+                std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+            std::string joined;
+            for (const auto &arg : args) {
+                joined += ' ';
+                joined += arg;
+            }
+            std::cout << std::format("[PSI-SERVE] request{} -> exit {} ({} ms)", joined, code, ms) << std::endl;
+            ++served;
+        }
+        ::close(client);
+    }
+    ::close(listen_fd);
+    ::unlink(path.c_str());
+    return 0;
+}
+
+int TestServer::request(const std::string &address, const std::vector<std::string> &args)
+{
+    const auto path = socket_path(address);
+    sockaddr_un addr;
+    if (path.empty() || !make_address(path, addr)) {
+        return 1;
+    }
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) != 0) {
+        std::cerr << "[PSI-TEST] cannot connect to " << path << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return 1;
+    }
+    std::string request;
+    for (const auto &arg : args) {
+        request += arg;
+        request += '\n';
+    }
+    request += '\n';
+    if (!detail::write_all(fd, request)) {
+        std::cerr << "[PSI-TEST] cannot send request to " << path << std::endl;
+        ::close(fd);
+        return 1;
+    }
+
+    // Output is forwarded line by line so that the exit trailer can be told apart from test output.
+    int code = 1;
+    bool got_trailer = false;
+    std::string pending;
+    char buf[4096];
+    for (;;) {
+        const auto n = ::read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        pending.append(buf, static_cast<size_t>(n));
+        size_t begin = 0;
+        for (auto eol = pending.find('\n'); eol != std::string::npos; eol = pending.find('\n', begin)) {
+            const std::string_view line(pending.data() + begin, eol - begin);
+            if (line.starts_with(kExitTrailer)) {
+                code = std::atoi(std::string(line.substr(kExitTrailer.size())).c_str());
+                got_trailer = true;
+            } else {
+                std::cout << line << '\n';
+            }
+            begin = eol + 1;
+        }
+        pending.erase(0, begin);
+        std::cout.flush();
+    }
+    std::cout << pending << std::flush;
+    ::close(fd);
+    if (!got_trailer) {
+        std::cerr << "[PSI-TEST] connection to " << path << " closed before the run finished" << std::endl;
+    }
+    return code;
+}
+
+#endif
+
+} // namespace psi::test
@@ -0,0 +1,116 @@
+#pragma once
+
+// POSIX socket helpers shared by the resident server and distributed runs.
+
+#if !defined(_WIN32)
+
+#include <cerrno>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace psi::test::detail {
+
+/// Keeps fd out of child processes: a spawned worker holding a copy of the listening socket or of another
+/// worker's connection would keep it open after this process closes it. Returns fd.
+inline int close_on_exec(int fd)
+{
+    if (fd >= 0) {
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    return fd;
+}
+
+inline bool write_all(int fd, std::string_view data)
+{
+    while (!data.empty()) {
+        const auto n = ::write(fd, data.data(), data.size());
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(n));
+    }
+    return true;
+}
+
+/// Flags that make a process a server, client, coordinator or worker, or exit it (--help): arguments a server or
+/// worker receives over a connection must not switch its mode.
+inline bool is_mode_flag(std::string_view arg)
+{
+    for (const std::string_view prefix :
+         {"--psi_serve", "--psi_connect", "--psi_coordinator", "--psi_spawn_workers", "--psi_worker"}) {
+        if (arg.starts_with(prefix)) {
+            return true;
+        }
+    }
+    return arg == "--help" || arg == "-h";
+}
+
+/// Blocking, buffered reads of '\n'-terminated lines and sized payloads.
+class SocketReader
+{
+public:
+    explicit SocketReader(int fd)
+        : m_fd(fd)
+    {
+    }
+
+    /// Next line without its '\n'; false on EOF or error before a complete line.
+    bool read_line(std::string &line)
+    {
+        for (;;) {
+            if (const auto eol = m_buffer.find('\n', m_pos); eol != std::string::npos) {
+                line.assign(m_buffer, m_pos, eol - m_pos);
+                m_pos = eol + 1;
+                return true;
+            }
+            if (!fill()) {
+                return false;
+            }
+        }
+    }
+
+    bool read_bytes(size_t size, std::string &out)
+    {
+        while (m_buffer.size() - m_pos < size) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        out.assign(m_buffer, m_pos, size);
+        m_pos += size;
+        return true;
+    }
+
+private:
+    bool fill()
+    {
+        m_buffer.erase(0, m_pos);
+        m_pos = 0;
+        char buf[4096];
+        for (;;) {
+            const auto n = ::read(m_fd, buf, sizeof(buf));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            m_buffer.append(buf, static_cast<size_t>(n));
+            return true;
+        }
+    }
+
+    int m_fd;
+    std::string m_buffer;
+    size_t m_pos = 0;
+};
+
+} // namespace psi::test::detail
+
+#endif
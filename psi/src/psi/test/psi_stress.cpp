@@ -0,0 +1,165 @@
+#include "psi/test/psi_stress.h"
+
+#include "psi/test/psi_capture.h"
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <format>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace psi::test {
+
+namespace {
+
+uint64_t s_replay_seed = 0;
+
+uint64_t splitmix64(uint64_t x) noexcept
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+struct YieldState {
+    bool m_active = false;
+    uint64_t m_rng = 0;
+};
+
+thread_local YieldState t_yield;
+
+} // namespace
+
+void detail::stress_yield_point() noexcept
+{
+    auto &state = t_yield;
+    if (!state.m_active) {
+        return;
+    }
+    // xorshift64: one in four points yields, one in sixteen spins up to 1023 rounds.
+    state.m_rng ^= state.m_rng << 13;
+    state.m_rng ^= state.m_rng >> 7;
+    state.m_rng ^= state.m_rng << 17;
+    const auto r = state.m_rng;
+    if ((r & 3) == 0) {
+        std::this_thread::yield();
+    } else if ((r & 15) == 1) {
+        for (auto spins = (r >> 8) & 1023; spins > 0; --spins) {
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        }
+    }
+}
+
+void StressRunner::set_replay_seed(uint64_t seed)
+{
+    s_replay_seed = seed;
+}
+
+uint64_t StressRunner::replay_seed()
+{
+    return s_replay_seed;
+}
+
+uint64_t StressRunner::run(size_t threads, uint64_t iterations, Body body, const std::source_location &location)
+{
+    threads = std::max<size_t>(threads, 1);
+    auto *test = TestLib::current_running_test();
+    // A failure is any failure recorded during the iteration, whether or not the test had failed before.
+    auto failure_count = [test]() -> size_t {
+        if (!test) {
+            return 0;
+        }
+        return test->m_test_result.m_failures.size() + test->m_test_result.m_suppressed_failures;
+    };
+    size_t failures_before = failure_count();
+    std::random_device rd;
+    const uint64_t base_seed = (static_cast<uint64_t>(rd()) << 32) | rd();
+
+    // Only the barrier completion writes these; the barrier orders them with the threads' reads.
+    uint64_t iteration = 0;
+    uint64_t seed = 0;
+    bool started = false;
+    bool failed = false;
+    bool stop = false;
+    auto next_iteration = [&]() noexcept {
+        if (started) {
+            const auto failures = failure_count();
+            failed = failures != failures_before;
+            failures_before = failures;
+            if (!failed) {
+                ++iteration;
+            }
+        }
+        started = true;
+        stop = failed || iteration >= iterations;
+        seed = s_replay_seed ? s_replay_seed : splitmix64(base_seed + iteration);
+    };
+    std::barrier sync(static_cast<std::ptrdiff_t>(threads), next_iteration);
+
+    auto worker = [&](size_t thread_index) {
+        for (;;) {
+            sync.arrive_and_wait();
+            if (stop) {
+                break;
+            }
+            const StressContext ctx {thread_index, threads, iteration, seed};
+            t_yield = {true, splitmix64(seed ^ (thread_index + 1) * 0x9e3779b97f4a7c15ull) | 1};
+            try {
+                body(ctx);
+            } catch (const TestLib::AssertionFailure &) {
+                // already recorded by the failing ASSERT_*
+            } catch (const std::exception &e) {
+                if (test) {
+                    test->fail_test(std::format("[PSI-TEST] uncaught exception on stress thread {}: {}",
+                                                thread_index,
+                                                e.what()),
+                                    false,
+                                    location,
+                                    "StressRunner::run");
+                }
+            } catch (...) {
+                if (test) {
+                    test->fail_test(std::format("[PSI-TEST] uncaught exception on stress thread {}", thread_index),
+                                    false,
+                                    location,
+                                    "StressRunner::run");
+                }
+            }
+            t_yield.m_active = false;
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (size_t t = 1; t < threads; ++t) {
+        pool.emplace_back(worker, t);
+    }
+    worker(0);
+    for (auto &thread : pool) {
+        thread.join();
+    }
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const auto ran = failed ? iteration + 1 : iteration;
+    if (failed) {
+        OutputCapture::write_runner(std::format("[  STRESS  ] first failure in iteration {}, seed {:#x} "
+                                                "(replay with --psi_stress_seed={:#x})\n",
+                                                iteration, seed, seed));
+    }
+    OutputCapture::write_runner(std::format("[  STRESS  ] {} iteration{} on {} thread{} in {:.0f} ms "
+                                            "({:.0f} iterations/s)\n",
+                                            ran,
+                                            ran != 1 ? "s" : "",
+                                            threads,
+                                            threads != 1 ? "s" : "",
+                                            elapsed * 1e3,
+                                            elapsed > 0 ? static_cast<double>(ran) / elapsed : 0.0));
+    return ran;
+}
+
+} // namespace psi::test
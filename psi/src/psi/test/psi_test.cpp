@@ -1,17 +1,42 @@
 
 #include "psi/test/psi_test.h"
 
+#include "psi/test/psi_async.h"
+#include "psi/test/psi_bench.h"
+#include "psi/test/psi_cache.h"
+#include "psi/test/psi_capture.h"
+#include "psi/test/psi_clock.h"
+#include "psi/test/psi_distributed.h"
+#include "psi/test/psi_golden.h"
+#include "psi/test/psi_memory.h"
+#include "psi/test/psi_profile.h"
+#include "psi/test/psi_serve.h"
+#include "psi/test/psi_stress.h"
+#include "psi/test/psi_trace.h"
+#include "psi_json.h"
+
 #ifdef _MSC_VER
 #include <crtdbg.h>
 #endif
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <format>
+#include <fstream>
 #include <iostream>
+#include <mutex>
+#include <set>
+#include <tuple>
 
 namespace psi::test {
 
 static bool s_use_color = true;
+static size_t s_max_failures_per_test = 0;
+/// Set by TestLib::run_as: failures are recorded on the scratch test without being printed.
+static thread_local bool s_quiet_failures = false;
 
 struct Color {
     explicit Color(const std::string &code)
@@ -130,7 +155,7 @@ void TestLib::add_test(const TestCase &tc)
     }
 
     tests_ref.m_tests_list.emplace_back(std::vector<TestCase> {tc});
-    tests_ref.m_tests_indices.emplace(tc.m_test_group, tests_ref.m_tests_list.rbegin());
+    tests_ref.m_tests_indices.emplace(tc.m_test_group, &tests_ref.m_tests_list.back());
     ++tests_ref.m_total_tests_number;
 }
 
@@ -139,6 +164,132 @@ TestLib::TestCase *TestLib::current_running_test()
     return m_current_running_test;
 }
 
+size_t TestLib::max_failures_per_test()
+{
+    return s_max_failures_per_test;
+}
+
+void TestLib::set_max_failures_per_test(size_t count)
+{
+    s_max_failures_per_test = count;
+}
+
+void TestLib::run_as(TestCase &test, const std::function<void()> &fn)
+{
+    auto *const previous = m_current_running_test;
+    const bool previous_quiet = s_quiet_failures;
+    m_current_running_test = &test;
+    s_quiet_failures = true;
+    try {
+        fn();
+    } catch (const AssertionFailure &) {
+        // already recorded on test
+    }
+    s_quiet_failures = previous_quiet;
+    m_current_running_test = previous;
+}
+
+/// Heap budgets are silently ineffective without the operator new replacements; say so once per process.
+static void warn_if_heap_untracked(std::string_view budget)
+{
+    static std::atomic<bool> s_warned {false};
+    if (!MemoryTracker::heap_tracking_enabled() && !s_warned.exchange(true)) {
+        std::cerr << std::format("[PSI-TEST] {} has no effect: this build does not track heap usage "
+                                 "(PSI_TEST_HEAP_TRACKING is OFF or AddressSanitizer is on)",
+                                 budget)
+                  << std::endl;
+    }
+}
+
+void TestLib::set_max_test_heap(size_t bytes)
+{
+    if (bytes) {
+        warn_if_heap_untracked("set_max_test_heap");
+    }
+    if (m_current_running_test) {
+        m_current_running_test->m_max_heap_bytes = bytes;
+    }
+}
+
+static std::string format_bytes(double bytes)
+{
+    const double abs_bytes = bytes < 0 ? -bytes : bytes;
+    if (abs_bytes >= 1024.0 * 1024.0) {
+        return std::format("{:.1f} MiB", bytes / (1024.0 * 1024.0));
+    }
+    if (abs_bytes >= 1024.0) {
+        return std::format("{:.1f} KiB", bytes / 1024.0);
+    }
+    return std::format("{} B", static_cast<long long>(bytes));
+}
+
+static void write_json_report(const std::string &path, const auto &filtered, int failed, long long total_ms)
+{
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "[PSI-TEST] cannot write " << path << std::endl;
+        return;
+    }
+    out << std::format("{{\n  \"tests\": {},\n  \"failures\": {},\n  \"disabled\": {},\n  \"time_ms\": {},\n",
+                       filtered.m_total_tests_number,
+                       failed,
+                       filtered.m_disabled_count,
+                       total_ms);
+    out << "  \"testsuites\": [";
+    bool first_group = true;
+    for (const auto &test_idx : filtered.m_tests_indices) {
+        out << (first_group ? "\n" : ",\n");
+        first_group = false;
+        out << std::format("    {{\"name\": \"{}\", \"tests\": {}, \"testsuite\": [",
+                           detail::json_escape(test_idx.first),
+                           test_idx.second->size());
+        bool first_test = true;
+        for (const auto &tc : *test_idx.second) {
+            const auto &r = tc.m_test_result;
+            out << (first_test ? "\n" : ",\n");
+            first_test = false;
+            out << std::format("      {{\"name\": \"{}\", \"failed\": {}, \"cached\": {}, \"time_ms\": {}, "
+                               "\"heap_peak_bytes\": {}, \"rss_delta_bytes\": {}, \"peak_rss_bytes\": {}, \"zones\": [",
+                               detail::json_escape(tc.m_test_name),
+                               r.m_is_failed ? "true" : "false",
+                               r.m_cached ? "true" : "false",
+                               r.m_time_ms,
+                               r.m_heap_peak_bytes,
+                               r.m_rss_delta_bytes,
+                               r.m_peak_rss_bytes);
+            bool first_zone = true;
+            for (const auto &[zone, stats] : r.m_zones) {
+                out << std::format("{}{{\"name\": \"{}\", \"count\": {}, \"total_ns\": {}, \"mean_ns\": {:.1f}, "
+                                   "\"max_ns\": {}}}",
+                                   first_zone ? "" : ", ",
+                                   detail::json_escape(zone),
+                                   stats.m_count,
+                                   stats.m_total_ns,
+                                   stats.mean_ns(),
+                                   stats.m_max_ns);
+                first_zone = false;
+            }
+            out << std::format("], \"suppressed_failures\": {}, \"failures\": [", r.m_suppressed_failures);
+            bool first_failure = true;
+            for (const auto &f : r.m_failures) {
+                out << std::format("{}{{\"file\": \"{}\", \"line\": {}, \"expression\": \"{}\", \"actual\": \"{}\", "
+                                   "\"expected\": \"{}\", \"message\": \"{}\"}}",
+                                   first_failure ? "" : ", ",
+                                   detail::json_escape(f.m_file),
+                                   f.m_line,
+                                   detail::json_escape(f.m_expression),
+                                   detail::json_escape(f.m_actual),
+                                   detail::json_escape(f.m_expected),
+                                   detail::json_escape(f.m_message));
+                first_failure = false;
+            }
+            out << "]}";
+        }
+        out << "\n    ]}";
+    }
+    out << "\n  ]\n}\n";
+}
+
 static bool matches_pattern(const std::string &group, const std::string &name, const std::string &pattern)
 {
     if (pattern.empty() || pattern == "*") {
@@ -227,7 +378,7 @@ TestLib::Tests TestLib::get_filtered_tests(const std::string &filter, bool also_
                 continue;
             }
             result.m_tests_list.emplace_back(std::vector<TestCase> {tc});
-            result.m_tests_indices.emplace(tc.m_test_group, result.m_tests_list.rbegin());
+            result.m_tests_indices.emplace(tc.m_test_group, &result.m_tests_list.back());
             ++result.m_total_tests_number;
         }
     }
@@ -235,23 +386,267 @@ TestLib::Tests TestLib::get_filtered_tests(const std::string &filter, bool also_
     return result;
 }
 
-void TestLib::TestCase::fail_test(const std::string &msg, bool is_assert)
+namespace detail {
+
+std::string_view FailureArena::store(std::string_view s)
+{
+    if (s.empty()) {
+        return {};
+    }
+    char *p = nullptr;
+    if (s.size() > kBlockSize / 4) {
+        // Large values get a block of their own so they don't waste the tail of the current one.
+        m_blocks.push_back(std::make_unique<char[]>(s.size()));
+        p = m_blocks.back().get();
+    } else {
+        if (kBlockSize - m_block_used < s.size()) {
+            m_blocks.push_back(std::make_unique<char[]>(kBlockSize));
+            m_block = m_blocks.back().get();
+            m_block_used = 0;
+        }
+        p = m_block + m_block_used;
+        m_block_used += s.size();
+    }
+    std::memcpy(p, s.data(), s.size());
+    m_bytes_used += s.size();
+    return {p, s.size()};
+}
+
+std::string quote_excerpt(std::string_view text)
+{
+    if (text.size() <= kMaxExcerptBytes) {
+        return "\"" + std::string(text) + "\"";
+    }
+    auto is_continuation = [&text](size_t i) { return (static_cast<unsigned char>(text[i]) & 0xC0) == 0x80; };
+    size_t head = kMaxExcerptBytes / 2;
+    while (head > 0 && is_continuation(head)) {
+        --head;
+    }
+    size_t tail = text.size() - kMaxExcerptBytes / 2;
+    while (tail < text.size() && is_continuation(tail)) {
+        ++tail;
+    }
+    return std::format(
+        "\"{}\" ... \"{}\" ({} bytes)", text.substr(0, head), text.substr(tail), text.size());
+}
+
+} // namespace detail
+
+/// Recorded actual / expected values are clipped to this many bytes; the printed message is not.
+static constexpr size_t kMaxRecordedValue = 256;
+
+/// Interns strings for the whole run; std::set nodes never move, so the views stay valid.
+static std::string_view intern(std::string_view s)
+{
+    static auto *pool = new std::set<std::string, std::less<>>();
+    static std::mutex pool_mutex;
+    std::lock_guard lock(pool_mutex);
+    auto it = pool->find(s);
+    if (it == pool->end()) {
+        it = pool->emplace(s).first;
+    }
+    return *it;
+}
+
+/// The call `assertion(...)` at file:line:column as written in the source, looked up once per location.
+/// GCC reports the column of the call's opening parenthesis and Clang that of its first token, so the call
+/// taken is the first one on the line whose parenthesis is at or after the column (any call when it is 0).
+/// The file is opened by the name the compiler recorded, which is relative to the build directory for
+/// relative compile paths, and is read when the test fails: after an edit the text can belong to another
+/// line. Falls back to just `assertion` when the file cannot be opened or the call is not found.
+static std::string_view source_expression(std::string_view file, int line, int column, std::string_view assertion)
 {
-    m_test_result.m_is_failed = true;
-    std::cout << msg << std::endl;
+    using Key = std::tuple<std::string_view, int, int, std::string_view>;
+    static auto *cache = new std::map<Key, std::string_view>();
+    static std::mutex cache_mutex;
+    {
+        std::lock_guard lock(cache_mutex);
+        if (auto it = cache->find(Key {file, line, column, assertion}); it != cache->end()) {
+            return it->second;
+        }
+    }
+
+    static constexpr int kMaxLines = 6;
+    static constexpr size_t kMaxLength = 200;
+    std::string text;
+    if (std::ifstream in {std::string(file)}) {
+        std::string source_line;
+        for (int i = 1; i < line + kMaxLines && std::getline(in, source_line); ++i) {
+            if (i >= line) {
+                text += source_line;
+                text += ' ';
+            }
+        }
+    }
+    std::string expression(assertion);
+    const auto call_start = std::string(assertion) + "(";
+    auto pos = text.find(call_start);
+    while (pos != std::string::npos && column > 0 && pos + assertion.size() + 1 < static_cast<size_t>(column)) {
+        pos = text.find(call_start, pos + 1);
+    }
+    if (pos != std::string::npos) {
+        int depth = 0;
+        std::string call;
+        bool space = false;
+        for (size_t i = pos; i < text.size() && call.size() < kMaxLength; ++i) {
+            const char c = text[i];
+            if (c == ' ' || c == '\t') {
+                space = !call.empty() && call.back() != '(';
+                continue;
+            }
+            if (space && c != ')' && c != ',') {
+                call += ' ';
+            }
+            space = false;
+            call += c;
+            depth += c == '(' ? 1 : c == ')' ? -1 : 0;
+            if (c == ')' && depth == 0) {
+                expression = call;
+                break;
+            }
+        }
+    }
+    const auto interned = intern(expression);
+    std::lock_guard lock(cache_mutex);
+    cache->emplace(Key {intern(file), line, column, intern(assertion)}, interned);
+    return interned;
+}
+
+static void record_failure(TestLib::TestCase &tc,
+                           const std::string &msg,
+                           bool is_assert,
+                           std::string_view file,
+                           int line,
+                           int column,
+                           std::string_view assertion,
+                           std::string_view actual,
+                           std::string_view expected)
+{
+    // Resolved before locking: the first failure at a location reads its source file.
+    const auto interned_file = file.empty() ? std::string_view() : intern(file);
+    const auto expression = !file.empty()        ? source_expression(interned_file, line, column, assertion)
+                            : !assertion.empty() ? intern(assertion)
+                                                 : std::string_view();
+    // STRESS_TEST bodies fail from several threads at once.
+    static std::mutex failure_mutex;
+    std::unique_lock lock(failure_mutex);
+    auto &result = tc.m_test_result;
+    result.m_is_failed = true;
+    if (s_max_failures_per_test && result.m_failures.size() >= s_max_failures_per_test) {
+        if (result.m_suppressed_failures++ == 0 && !s_quiet_failures) {
+            OutputCapture::write_runner(std::format("[PSI-TEST] {} failures recorded, further failures of this test "
+                                                    "are only counted (--psi_max_failures_per_test)\n",
+                                                    s_max_failures_per_test));
+        }
+    } else {
+        if (!result.m_failure_arena) {
+            result.m_failure_arena = std::make_shared<detail::FailureArena>();
+        }
+        auto &arena = *result.m_failure_arena;
+        TestLib::TestFailure failure;
+        failure.m_line = line;
+        failure.m_file = interned_file;
+        failure.m_expression = expression;
+        failure.m_actual = arena.store(actual.substr(0, kMaxRecordedValue));
+        failure.m_expected = arena.store(expected.substr(0, kMaxRecordedValue));
+        failure.m_message = arena.store(msg);
+        result.m_failures.push_back(failure);
+
+        // Failures bypass --psi_capture_output: they are the runner's output, not the test's.
+        if (!failure.m_file.empty() && !s_quiet_failures) {
+            OutputCapture::write_runner(
+                std::format("{}:{}: Failure in {}\n", failure.m_file, failure.m_line, failure.m_expression));
+        }
+        if (!s_quiet_failures) {
+            OutputCapture::write_runner(msg + "\n");
+        }
+    }
+    lock.unlock();
     if (is_assert) {
-        throw std::runtime_error(msg);
+        throw TestLib::AssertionFailure(msg);
     }
 }
 
+void TestLib::TestCase::fail_test(const std::string &msg, bool is_assert)
+{
+    record_failure(*this, msg, is_assert, {}, 0, 0, {}, {}, {});
+}
+
+void TestLib::TestCase::fail_test(const std::string &msg,
+                                  bool is_assert,
+                                  const std::source_location &location,
+                                  std::string_view assertion,
+                                  std::string_view actual,
+                                  std::string_view expected)
+{
+    record_failure(*this,
+                   msg,
+                   is_assert,
+                   location.file_name(),
+                   static_cast<int>(location.line()),
+                   static_cast<int>(location.column()),
+                   assertion,
+                   actual,
+                   expected);
+}
+
 void TestLib::TestCase::fail_test(const std::wstring &msg, bool is_assert)
 {
-    m_test_result.m_is_failed = true;
-    std::wcout << msg << std::endl;
-    if (is_assert) {
-        /// @todo convert wchar_t* to char*
-        throw std::runtime_error("wchar failed");
+    record_failure(*this, detail::to_utf8(msg), is_assert, {}, 0, 0, {}, {}, {});
+}
+
+/// Failure of the test as a whole, reported at its definition.
+static void fail_at_definition(TestLib::TestCase &test_case, const std::string &msg)
+{
+    test_case.fail_test(msg, false, test_case.m_location, test_case.m_async_fn ? "ASYNC_TEST" : "TEST");
+}
+
+std::string detail::to_utf8(std::wstring_view text)
+{
+    std::string out;
+    out.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        auto cp = static_cast<uint32_t>(text[i]);
+        if constexpr (sizeof(wchar_t) == 2) {
+            if (cp >= 0xd800 && cp < 0xdc00 && i + 1 < text.size()) {
+                const auto low = static_cast<uint32_t>(text[i + 1]);
+                if (low >= 0xdc00 && low < 0xe000) {
+                    cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                    ++i;
+                }
+            }
+        }
+        if ((cp >= 0xd800 && cp < 0xe000) || cp > 0x10ffff) {
+            cp = 0xfffd;
+        }
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xc0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xe0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+        } else {
+            out += static_cast<char>(0xf0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+        }
     }
+    return out;
+}
+
+/// Value of a BYTES[K|M|G] flag that starts at `offset` of arg; a malformed one is added to errors.
+static size_t parse_size_arg(std::string_view arg, size_t offset, std::vector<std::string> &errors)
+{
+    if (const auto bytes = parse_byte_size(arg.substr(offset))) {
+        return *bytes;
+    }
+    errors.push_back(std::format("[PSI-TEST] invalid size in {} (expected BYTES with an optional K, M or G suffix)",
+                                 arg));
+    return 0;
 }
 
 TestLib::CmdOptions TestLib::parse_args(std::span<char *> argv)
@@ -271,7 +666,49 @@ TestLib::CmdOptions TestLib::parse_args(std::span<char *> argv)
                          "  --gtest_also_run_disabled_tests\n"
                          "    Run tests prefixed with DISABLED_ that are skipped by default.\n"
                          "  --gtest_color=(yes|no|auto)\n"
-                         "    Enable/disable colored output.\n";
+                         "    Enable/disable colored output.\n"
+                         "  --gtest_output=json:PATH\n"
+                         "    Write a machine-readable JSON report to PATH.\n"
+                         "  --psi_report_memory\n"
+                         "    Print heap peak and RSS change of every test.\n"
+                         "  --psi_max_test_heap=BYTES[K|M|G]\n"
+                         "    Fail tests whose heap high-water mark exceeds BYTES.\n"
+                         "  --psi_capture_output\n"
+                         "    Capture stdout/stderr of every test, print it only when the test fails.\n"
+                         "  --psi_capture_output_keep=BYTES[K|M|G]\n"
+                         "    Keep the first and last BYTES of long captured output (default 32K).\n"
+                         "  --psi_max_failures_per_test=N\n"
+                         "    Record and print at most N failures per test, count the rest.\n"
+                         "  --psi_stress_seed=SEED\n"
+                         "    Run every STRESS_TEST iteration with SEED to replay a reported failure.\n"
+                         "  --psi_async_timeout=MS\n"
+                         "    Fail async tests running MS ms after their group started (default 60000; 0: never).\n"
+                         "  --psi_serve=unix:PATH\n"
+                         "    Stay resident and run the requests of --psi_connect clients on socket PATH.\n"
+                         "  --psi_connect=unix:PATH\n"
+                         "    Send the other arguments to a --psi_serve process and print its results.\n"
+                         "  --psi_coordinator=HOST:PORT\n"
+                         "    Hand the filtered tests in batches to --psi_worker processes connecting to HOST:PORT.\n"
+                         "  --psi_spawn_workers=N\n"
+                         "    With --psi_coordinator, also start N local worker processes.\n"
+                         "  --psi_worker=HOST:PORT\n"
+                         "    Run the batches of the coordinator at HOST:PORT.\n"
+                         "  --psi_cache_dir=PATH\n"
+                         "    Reuse passing results from the cache in PATH while binary and inputs are unchanged.\n"
+                         "  --psi_no_cache\n"
+                         "    Ignore --psi_cache_dir and run every test.\n"
+                         "  --psi_update_golden\n"
+                         "    Rewrite golden files that differ from the output instead of failing.\n"
+                         "  --psi_trace=PATH\n"
+                         "    Write a Chrome trace-event timeline of the run to PATH.\n"
+                         "  --psi_profile=PATH\n"
+                         "    Sample stacks with SIGPROF and write folded stacks to PATH, one section per test.\n"
+                         "  --psi_profile_hz=N\n"
+                         "    Samples per second of CPU time for --psi_profile (default 1000).\n"
+                         "  --psi_bench_cpus=LIST\n"
+                         "    Pin the run to CPUs in LIST (e.g. 2,3 or 4-7) for stable benchmarks.\n"
+                         "  --psi_bench_high_priority\n"
+                         "    Raise the scheduling priority of the run when permitted.\n";
             std::exit(0);
         } else if (arg == "--gtest_list_tests") {
             opts.list_tests = true;
@@ -286,96 +723,282 @@ TestLib::CmdOptions TestLib::parse_args(std::span<char *> argv)
             } else {
                 opts.filter = gf; // pass through as-is: "Group.*", "Group.Name", "A.B:C.D"
             }
+        } else if (arg.starts_with("--gtest_output=")) {
+            const auto spec = arg.substr(15);
+            if (spec.starts_with("json:")) {
+                opts.output_json = std::string(spec.substr(5));
+            } else {
+                std::cerr << "[PSI-TEST] unsupported output format: " << spec << std::endl;
+            }
+        } else if (arg == "--psi_report_memory") {
+            opts.report_memory = true;
+        } else if (arg.starts_with("--psi_max_test_heap=")) {
+            opts.max_test_heap = parse_size_arg(arg, 20, opts.errors);
+        } else if (arg == "--psi_capture_output") {
+            opts.capture_output = true;
+        } else if (arg.starts_with("--psi_capture_output_keep=")) {
+            opts.capture_output_keep = parse_size_arg(arg, 26, opts.errors);
+        } else if (arg.starts_with("--psi_max_failures_per_test=")) {
+            opts.max_failures_per_test = std::strtoull(std::string(arg.substr(28)).c_str(), nullptr, 10);
+        } else if (arg.starts_with("--psi_async_timeout=")) {
+            opts.async_timeout_ms = std::strtoull(std::string(arg.substr(20)).c_str(), nullptr, 10);
+        } else if (arg.starts_with("--psi_stress_seed=")) {
+            opts.stress_seed = std::strtoull(std::string(arg.substr(18)).c_str(), nullptr, 0);
+        } else if (arg.starts_with("--psi_bench_cpus=")) {
+            opts.bench_cpus = std::string(arg.substr(17));
+        } else if (arg == "--psi_bench_high_priority") {
+            opts.bench_high_priority = true;
+        } else if (arg.starts_with("--psi_serve=")) {
+            opts.serve = std::string(arg.substr(12));
+        } else if (arg.starts_with("--psi_connect=")) {
+            opts.connect = std::string(arg.substr(14));
+        } else if (arg.starts_with("--psi_coordinator=")) {
+            opts.coordinator = std::string(arg.substr(18));
+        } else if (arg.starts_with("--psi_spawn_workers=")) {
+            opts.spawn_workers = std::strtoull(std::string(arg.substr(20)).c_str(), nullptr, 10);
+        } else if (arg.starts_with("--psi_worker=")) {
+            opts.worker = std::string(arg.substr(13));
+        } else if (arg.starts_with("--psi_cache_dir=")) {
+            opts.cache_dir = std::string(arg.substr(16));
+        } else if (arg == "--psi_no_cache") {
+            opts.no_cache = true;
+        } else if (arg == "--psi_update_golden") {
+            opts.update_golden = true;
+        } else if (arg.starts_with("--psi_trace=")) {
+            opts.trace_path = std::string(arg.substr(12));
+        } else if (arg.starts_with("--psi_profile=")) {
+            opts.profile_path = std::string(arg.substr(14));
+        } else if (arg.starts_with("--psi_profile_hz=")) {
+            opts.profile_hz = std::atoi(std::string(arg.substr(17)).c_str());
         } else if (arg.starts_with("--filter=")) {
             opts.filter = std::string(arg.substr(9));
         } else if (arg == "--filter" && i + 1 < argv.size()) {
             opts.filter = argv[++i];
         }
     }
+    if (!opts.connect.empty()) {
+        for (size_t i = 1; i < argv.size(); ++i) {
+            if (!std::string_view(argv[i]).starts_with("--psi_connect=")) {
+                opts.connect_args.emplace_back(argv[i]);
+            }
+        }
+    }
+    if (!opts.coordinator.empty()) {
+        for (size_t i = 1; i < argv.size(); ++i) {
+            const std::string_view arg = argv[i];
+            if (!arg.starts_with("--psi_coordinator=") && !arg.starts_with("--psi_spawn_workers=")) {
+                opts.worker_args.emplace_back(arg);
+            }
+        }
+    }
 
     return opts;
 }
 
-int TestLib::run(const CmdOptions &opts)
+void TestLib::reset_test_state()
 {
-    s_use_color = opts.color;
-    if (opts.list_tests) {
-        const auto &tests_ref = tests();
-        for (const auto &test_idx : tests_ref.m_tests_indices) {
-            std::cout << test_idx.first << ".\n";
-            for (const auto &tc : *test_idx.second) {
-                std::cout << "  " << tc.m_test_name << "\n";
-            }
+    m_current_running_test = nullptr;
+    fn_expectations()->clear();
+    for (auto &test_group : tests().m_tests_list) {
+        for (auto &tc : test_group) {
+            tc.m_fn_expectations.clear();
+            tc.m_test_result = {};
+            tc.m_max_heap_bytes = 0;
         }
-        return 0;
     }
+}
 
-    int failed = 0;
+bool TestLib::run_test_case(TestCase &test_case, const CmdOptions &opts)
+{
+    TraceRecorder::Scope trace_test("test", test_case.m_test_group, test_case.m_test_name);
+    {
+        auto c = GREEN();
+        std::cout << "[ RUN      ]";
+    }
+    std::cout << std::format(" {}.{}", test_case.m_test_group, test_case.m_test_name) << std::endl;
+    m_current_running_test = &test_case;
+    const bool capturing = opts.capture_output && OutputCapture::start(opts.capture_output_keep);
 
+    const auto rss_before = MemoryTracker::rss_bytes();
+    const auto heap_base = MemoryTracker::current_heap_bytes();
+    MemoryTracker::reset_peak();
+    ZoneProfiler::reset();
+    FakeClock::reset();
+    const auto tc_start = std::chrono::high_resolution_clock::now();
     {
+        TraceRecorder::Scope trace_body("phase", "test_body");
+        try {
+            test_case.m_fn();
+        } catch (const AssertionFailure &) {
+            // already recorded by the failing ASSERT_*
+        } catch (const std::exception &e) {
+            fail_at_definition(test_case, std::format("[PSI-TEST] uncaught exception: {}", e.what()));
+        } catch (...) {
+            fail_at_definition(test_case, "[PSI-TEST] uncaught exception of unknown type");
+        }
+    }
+    const auto tc_end = std::chrono::high_resolution_clock::now();
+    const auto tc_time = std::chrono::duration_cast<std::chrono::milliseconds>(tc_end - tc_start).count();
+    {
+        TraceRecorder::Scope trace_verify("phase", "verify_and_clear_expectations");
+        verify_and_clear_expectations(test_case);
+    }
+
+    auto &result = test_case.m_test_result;
+    result.m_time_ms = tc_time;
+    const auto heap_peak = MemoryTracker::peak_heap_bytes();
+    result.m_heap_peak_bytes = heap_peak > heap_base ? heap_peak - heap_base : 0;
+    result.m_rss_delta_bytes = static_cast<int64_t>(MemoryTracker::rss_bytes()) - static_cast<int64_t>(rss_before);
+    result.m_peak_rss_bytes = MemoryTracker::peak_rss_bytes();
+    result.m_zones = ZoneProfiler::snapshot();
+    const auto heap_budget = test_case.m_max_heap_bytes ? test_case.m_max_heap_bytes : opts.max_test_heap;
+    if (heap_budget && result.m_heap_peak_bytes > heap_budget) {
+        fail_at_definition(test_case,
+                           std::format("[PSI-TEST] heap peak ({} bytes) exceeds budget ({} bytes)",
+                                       result.m_heap_peak_bytes,
+                                       heap_budget));
+    }
+    m_current_running_test = nullptr;
+    const auto captured = capturing ? OutputCapture::stop() : std::string();
+    if (result.m_suppressed_failures) {
+        std::cout << std::format("[PSI-TEST] {} more failure{} not reported",
+                                 result.m_suppressed_failures,
+                                 result.m_suppressed_failures != 1 ? "s" : "")
+                  << std::endl;
+    }
+
+    TraceRecorder::Scope trace_report("phase", "report");
+    const auto is_failed = test_case.m_test_result.m_is_failed;
+    if (is_failed && !captured.empty()) {
+        std::cout << "[  OUTPUT  ] captured stdout/stderr:\n" << captured;
+        if (captured.back() != '\n') {
+            std::cout << '\n';
+        }
+        std::cout << "[  OUTPUT  ] end of captured output" << std::endl;
+    }
+    if (is_failed) {
+        auto c = RED();
+        std::cout << "[  FAILED  ]";
+    } else {
         auto c = GREEN();
-        std::cout << "[==========]";
+        std::cout << "[       OK ]";
     }
-    const auto filtered = get_filtered_tests(opts.filter, opts.also_run_disabled);
-    std::cout << std::format(" Running {} test{} from {} test suite{}.",
-                             filtered.m_total_tests_number,
-                             filtered.m_total_tests_number != 1 ? "s" : "",
-                             filtered.m_tests_list.size(),
-                             filtered.m_tests_list.size() != 1 ? "s" : "")
-              << std::endl;
-    const auto total_start = std::chrono::high_resolution_clock::now();
-    for (const auto &test_idx : filtered.m_tests_indices) {
+    if (opts.report_memory || heap_budget) {
+        std::cout << std::format(" {}.{} ({} ms, heap peak {}, rss {}{})",
+                                 test_case.m_test_group,
+                                 test_case.m_test_name,
+                                 tc_time,
+                                 format_bytes(static_cast<double>(result.m_heap_peak_bytes)),
+                                 result.m_rss_delta_bytes < 0 ? "" : "+",
+                                 format_bytes(static_cast<double>(result.m_rss_delta_bytes)))
+                  << std::endl;
+    } else {
+        std::cout << std::format(" {}.{} ({} ms)", test_case.m_test_group, test_case.m_test_name, tc_time)
+                  << std::endl;
+    }
+    ZoneProfiler::print(std::cout, result.m_zones, "[   ZONE   ]");
+    return is_failed;
+}
+
+int TestLib::run_async_tests(const std::vector<TestCase *> &async_tests, const CmdOptions &opts)
+{
+    TraceRecorder::Scope trace_async("phase", "async_tests");
+    // The tests of a group overlap: heap peaks and stdout/stderr cannot be attributed to one of them, so heap
+    // budgets and output capture are not applied.
+    if (opts.max_test_heap || opts.capture_output) {
+        std::cout << "[PSI-TEST] --psi_max_test_heap and --psi_capture_output do not apply to async tests" << std::endl;
+    }
+    for (auto *test_case : async_tests) {
         {
             auto c = GREEN();
-            std::cout << "[----------]";
+            std::cout << "[ RUN      ]";
         }
-        std::cout << std::format(" {} test{} from {}",
-                                 test_idx.second->size(),
-                                 test_idx.second->size() != 1 ? "s" : "",
-                                 test_idx.first) << std::endl;
-        auto &test_group = *test_idx.second;
-        const auto tg_start = std::chrono::high_resolution_clock::now();
-        for (auto &test_case : test_group) {
-            {
-                auto c = GREEN();
-                std::cout << "[ RUN      ]";
-            }
-            std::cout << std::format(" {}.{}", test_case.m_test_group, test_case.m_test_name) << std::endl;
-            m_current_running_test = &test_case;
-
-            const auto tc_start = std::chrono::high_resolution_clock::now();
-            test_case.m_fn();
-            const auto tc_end = std::chrono::high_resolution_clock::now();
-            const auto tc_time = std::chrono::duration_cast<std::chrono::milliseconds>(tc_end - tc_start).count();
-            verify_and_clear_expectations(test_case);
-            m_current_running_test = nullptr;
+        std::cout << std::format(" {}.{} (async)", test_case->m_test_group, test_case->m_test_name) << std::endl;
+    }
 
-            const auto is_failed = test_case.m_test_result.m_is_failed;
-            if (is_failed) {
-                ++failed;
-                auto c = RED();
-                std::cout << "[  FAILED  ]";
-            } else {
-                auto c = GREEN();
-                std::cout << "[       OK ]";
+    int failed = 0;
+    FakeClock::reset();
+    const auto start = std::chrono::high_resolution_clock::now();
+    const auto timeout = std::chrono::milliseconds(opts.async_timeout_ms);
+    AsyncExecutor::run(async_tests, [&](TestCase &test_case, std::exception_ptr error) {
+        try {
+            if (error) {
+                std::rethrow_exception(error);
             }
-            std::cout << std::format(" {}.{} ({} ms)", test_case.m_test_group, test_case.m_test_name, tc_time) << std::endl;
+        } catch (const AssertionFailure &) {
+            // already recorded by the failing ASSERT_*
+        } catch (const std::exception &e) {
+            fail_at_definition(test_case, std::format("[PSI-TEST] uncaught exception: {}", e.what()));
+        } catch (...) {
+            fail_at_definition(test_case, "[PSI-TEST] uncaught exception of unknown type");
         }
-        const auto tg_end = std::chrono::high_resolution_clock::now();
-        const auto tg_time = std::chrono::duration_cast<std::chrono::milliseconds>(tg_end - tg_start).count();
-        {
+        verify_and_clear_expectations(test_case);
+
+        auto &result = test_case.m_test_result;
+        // Tests of the group overlap, so the time is from the group start to this test's completion.
+        result.m_time_ms =
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start)
+                .count();
+        if (result.m_suppressed_failures) {
+            std::cout << std::format("[PSI-TEST] {} more failure{} not reported",
+                                     result.m_suppressed_failures,
+                                     result.m_suppressed_failures != 1 ? "s" : "")
+                      << std::endl;
+        }
+        if (result.m_is_failed) {
+            ++failed;
+            auto c = RED();
+            std::cout << "[  FAILED  ]";
+        } else {
             auto c = GREEN();
-            std::cout << "[----------]";
+            std::cout << "[       OK ]";
         }
-        std::cout << std::format(" {} test{} from {} ({} ms total)",
-                                 test_idx.second->size(),
-                                 test_idx.second->size() != 1 ? "s" : "",
-                                 test_idx.first, tg_time)
-                  << std::endl
+        std::cout << std::format(" {}.{} ({} ms)", test_case.m_test_group, test_case.m_test_name, result.m_time_ms)
                   << std::endl;
+    }, timeout);
+    return failed;
+}
+
+static void apply_run_options(const TestLib::CmdOptions &opts)
+{
+    s_use_color = opts.color;
+    TestLib::set_max_failures_per_test(opts.max_failures_per_test);
+    StressRunner::set_replay_seed(opts.stress_seed);
+    GoldenFile::set_update(opts.update_golden);
+}
+
+bool TestLib::run_named_test(const std::string &full_name, const CmdOptions &opts, bool &failed)
+{
+    for (auto &test_group : tests().m_tests_list) {
+        for (auto &test_case : test_group) {
+            if (test_case.m_test_group + "." + test_case.m_test_name != full_name) {
+                continue;
+            }
+            // Runs the registered test itself: trace events keep views of its names until --psi_worker ships them.
+            apply_run_options(opts);
+            failed = test_case.m_async_fn ? run_async_tests({&test_case}, opts) != 0 : run_test_case(test_case, opts);
+            return true;
+        }
     }
-    const auto total_end = std::chrono::high_resolution_clock::now();
-    const auto total_time = std::chrono::duration_cast<std::chrono::milliseconds>(total_end - total_start).count();
+    return false;
+}
+
+void TestLib::print_run_header(const Tests &filtered)
+{
+    {
+        auto c = GREEN();
+        std::cout << "[==========]";
+    }
+    std::cout << std::format(" Running {} test{} from {} test suite{}.",
+                             filtered.m_total_tests_number,
+                             filtered.m_total_tests_number != 1 ? "s" : "",
+                             filtered.m_tests_list.size(),
+                             filtered.m_tests_list.size() != 1 ? "s" : "")
+              << std::endl;
+}
+
+void TestLib::report_run(const Tests &filtered, int failed, long long total_time, const CmdOptions &opts)
+{
     {
         auto c = GREEN();
         std::cout << "[==========]";
@@ -413,6 +1036,159 @@ int TestLib::run(const CmdOptions &opts)
                                  filtered.m_disabled_count != 1 ? "S" : "");
     }
 
+    if (!opts.output_json.empty()) {
+        write_json_report(opts.output_json, filtered, failed, total_time);
+    }
+    if (!opts.trace_path.empty()) {
+        TraceRecorder::disable();
+        if (!TraceRecorder::write(opts.trace_path)) {
+            std::cerr << "[PSI-TEST] cannot write " << opts.trace_path << std::endl;
+        }
+    }
+    if (!opts.profile_path.empty() && SamplingProfiler::running()) {
+        SamplingProfiler::stop();
+        const auto samples = SamplingProfiler::sample_count();
+        const auto dropped = SamplingProfiler::dropped_count();
+        if (!SamplingProfiler::write(opts.profile_path)) {
+            std::cerr << "[PSI-TEST] cannot write " << opts.profile_path << std::endl;
+        } else {
+            std::cout << std::format("[PSI-TEST] wrote {} profile samples to {}{}\n",
+                                     samples,
+                                     opts.profile_path,
+                                     dropped ? std::format(" ({} dropped)", dropped) : "");
+        }
+    }
+
+}
+
+int TestLib::run(const CmdOptions &opts)
+{
+    if (!opts.errors.empty()) {
+        for (const auto &error : opts.errors) {
+            std::cerr << error << std::endl;
+        }
+        return 1;
+    }
+    if (!opts.connect.empty()) {
+        return TestServer::request(opts.connect, opts.connect_args);
+    }
+    if (!opts.serve.empty()) {
+        return TestServer::serve(opts.serve);
+    }
+    if (!opts.worker.empty()) {
+        return DistributedRunner::work(opts.worker);
+    }
+    apply_run_options(opts);
+    if (!opts.coordinator.empty()) {
+        return DistributedRunner::coordinate(opts);
+    }
+    if (opts.list_tests) {
+        const auto &tests_ref = tests();
+        for (const auto &test_idx : tests_ref.m_tests_indices) {
+            std::cout << test_idx.first << ".\n";
+            for (const auto &tc : *test_idx.second) {
+                std::cout << "  " << tc.m_test_name << "\n";
+            }
+        }
+        return 0;
+    }
+
+    if (opts.max_test_heap) {
+        warn_if_heap_untracked("--psi_max_test_heap");
+    }
+    if (!opts.trace_path.empty()) {
+        TraceRecorder::enable();
+    }
+    if (!opts.profile_path.empty() && !SamplingProfiler::start(opts.profile_hz)) {
+        std::cerr << "[PSI-TEST] cannot start the --psi_profile sampler"
+                  << (SamplingProfiler::supported() ? "" : " (SIGPROF and backtrace() are not available)") << std::endl;
+    }
+    if (!opts.bench_cpus.empty() || opts.bench_high_priority) {
+        stabilize_environment({parse_cpu_list(opts.bench_cpus), opts.bench_high_priority});
+        print_environment_once(std::cout);
+    }
+
+    int failed = 0;
+    // Options that can change a verdict are part of the cache key.
+    const bool use_cache =
+        !opts.cache_dir.empty() && !opts.no_cache &&
+        ResultCache::open(opts.cache_dir,
+                          std::format("max_test_heap={};stress_seed={};async_timeout_ms={}",
+                                      opts.max_test_heap,
+                                      opts.stress_seed,
+                                      opts.async_timeout_ms));
+
+    const auto filtered = [&]() {
+        TraceRecorder::Scope trace_filter("phase", "get_filtered_tests");
+        return get_filtered_tests(opts.filter, opts.also_run_disabled);
+    }();
+    print_run_header(filtered);
+    const auto total_start = std::chrono::high_resolution_clock::now();
+    for (const auto &test_idx : filtered.m_tests_indices) {
+        {
+            auto c = GREEN();
+            std::cout << "[----------]";
+        }
+        std::cout << std::format(" {} test{} from {}",
+                                 test_idx.second->size(),
+                                 test_idx.second->size() != 1 ? "s" : "",
+                                 test_idx.first) << std::endl;
+        TraceRecorder::Scope trace_group("group", test_idx.first);
+        auto &test_group = *test_idx.second;
+        const auto tg_start = std::chrono::high_resolution_clock::now();
+        std::vector<TestCase *> async_tests;
+        std::map<const TestCase *, std::string> cache_keys;
+        for (auto &test_case : test_group) {
+            if (use_cache) {
+                const auto full_name = test_case.m_test_group + "." + test_case.m_test_name;
+                auto key = ResultCache::key(full_name);
+                if (ResultCache::has_pass(key, full_name)) {
+                    {
+                        auto c = GREEN();
+                        std::cout << "[  CACHED  ]";
+                    }
+                    std::cout << " " << full_name << std::endl;
+                    test_case.m_test_result.m_cached = true;
+                    continue;
+                }
+                cache_keys.emplace(&test_case, std::move(key));
+            }
+            if (test_case.m_async_fn) {
+                async_tests.push_back(&test_case);
+            } else if (run_test_case(test_case, opts)) {
+                ++failed;
+            }
+        }
+        if (!async_tests.empty()) {
+            failed += run_async_tests(async_tests, opts);
+        }
+        for (const auto &[test_case, key] : cache_keys) {
+            if (!test_case->m_test_result.m_is_failed) {
+                ResultCache::store_pass(key,
+                                        test_case->m_test_group + "." + test_case->m_test_name,
+                                        test_case->m_test_result.m_time_ms);
+            }
+        }
+        const auto tg_end = std::chrono::high_resolution_clock::now();
+        const auto tg_time = std::chrono::duration_cast<std::chrono::milliseconds>(tg_end - tg_start).count();
+        {
+            auto c = GREEN();
+            std::cout << "[----------]";
+        }
+        std::cout << std::format(" {} test{} from {} ({} ms total)",
+                                 test_idx.second->size(),
+                                 test_idx.second->size() != 1 ? "s" : "",
+                                 test_idx.first, tg_time)
+                  << std::endl
+                  << std::endl;
+    }
+    const auto total_end = std::chrono::high_resolution_clock::now();
+    const auto total_time = std::chrono::duration_cast<std::chrono::milliseconds>(total_end - total_start).count();
+    report_run(filtered, failed, total_time, opts);
+    if (use_cache) {
+        ResultCache::close();
+    }
+    restore_environment();
     return failed;
 }
 
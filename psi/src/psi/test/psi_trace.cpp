@@ -0,0 +1,243 @@
+#include "psi/test/psi_trace.h"
+
+#include "psi_json.h"
+
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define psi_getpid _getpid
+#else
+#include <unistd.h>
+#define psi_getpid getpid
+#endif
+
+namespace psi::test {
+
+namespace {
+
+struct TraceEvent {
+    std::string_view m_category;
+    std::string_view m_name;
+    std::string_view m_name_suffix;
+    int64_t m_start_ns;
+    int64_t m_end_ns;
+};
+
+/// Single-producer ring: the owning thread appends at m_head, take_events_locked() consumes up to it and moves
+/// m_tail, so neither ever frees or clears storage the other may be using.
+struct ThreadBuffer {
+    explicit ThreadBuffer(uint32_t tid, size_t capacity)
+        : m_tid(tid)
+        , m_capacity(capacity)
+        , m_events(capacity)
+    {
+    }
+
+    const uint32_t m_tid;
+    const size_t m_capacity;
+    std::vector<TraceEvent> m_events;
+    std::atomic<uint64_t> m_head {0};
+    std::atomic<uint64_t> m_tail {0};
+    std::atomic<size_t> m_dropped {0};
+    /// Set when the owning thread exits; the buffer is freed once its events are taken.
+    std::atomic<bool> m_orphaned {false};
+};
+
+struct TraceState {
+    std::atomic<bool> m_enabled {false};
+    size_t m_capacity = 0;
+    uint32_t m_next_tid = 1;
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+    /// Events of other processes, already formatted.
+    std::string m_foreign_events;
+    const std::chrono::steady_clock::time_point m_origin = std::chrono::steady_clock::now();
+};
+
+TraceState &state()
+{
+    static auto *instance = new TraceState();
+    return *instance;
+}
+
+/// Registers the thread's buffer with the global list on first use, so that events of finished threads survive
+/// until write(), and hands it over to the list when the thread exits.
+struct ThreadBufferOwner {
+    ThreadBuffer *m_buffer = nullptr;
+
+    ~ThreadBufferOwner()
+    {
+        if (m_buffer) {
+            m_buffer->m_orphaned.store(true, std::memory_order_release);
+        }
+    }
+};
+
+ThreadBuffer &thread_buffer()
+{
+    thread_local ThreadBufferOwner owner;
+    if (!owner.m_buffer) {
+        auto &s = state();
+        std::lock_guard lock(s.m_mutex);
+        auto buffer = std::make_unique<ThreadBuffer>(s.m_next_tid++, s.m_capacity);
+        owner.m_buffer = buffer.get();
+        s.m_buffers.emplace_back(std::move(buffer));
+    }
+    return *owner.m_buffer;
+}
+
+/// Formats and consumes the events of all thread buffers, freeing those of exited threads. Caller holds m_mutex.
+std::string take_events_locked(TraceState &s, int64_t shift_ns)
+{
+    const auto pid = psi_getpid();
+    std::string out;
+    auto separator = [&]() {
+        if (!out.empty()) {
+            out += ",\n";
+        }
+    };
+    std::erase_if(s.m_buffers, [&](const std::unique_ptr<ThreadBuffer> &buffer) {
+        // Once the owner is gone every event it recorded is visible, and nobody writes to the buffer again.
+        const bool orphaned = buffer->m_orphaned.load(std::memory_order_acquire);
+        const auto tail = buffer->m_tail.load(std::memory_order_relaxed);
+        const auto head = buffer->m_head.load(std::memory_order_acquire);
+        const auto dropped = buffer->m_dropped.exchange(0, std::memory_order_relaxed);
+        if (head == tail && !dropped) {
+            return orphaned;
+        }
+        separator();
+        out += std::format(
+            R"({{"name": "thread_name", "ph": "M", "pid": {}, "tid": {}, "args": {{"name": "psi-test thread {}"}}}})",
+            pid,
+            buffer->m_tid,
+            buffer->m_tid);
+        for (auto i = tail; i != head; ++i) {
+            const auto &e = buffer->m_events[i % buffer->m_capacity];
+            separator();
+            std::string name(e.m_name);
+            if (!e.m_name_suffix.empty()) {
+                name += '.';
+                name += e.m_name_suffix;
+            }
+            out += std::format(R"({{"name": "{}", "cat": "{}", "ph": "X", "ts": {:.3f}, "dur": {:.3f}, "pid": {}, "tid": {}}})",
+                               detail::json_escape(name),
+                               detail::json_escape(e.m_category),
+                               static_cast<double>(e.m_start_ns + shift_ns) / 1000.0,
+                               static_cast<double>(e.m_end_ns - e.m_start_ns) / 1000.0,
+                               pid,
+                               buffer->m_tid);
+        }
+        if (dropped) {
+            separator();
+            out += std::format(
+                R"({{"name": "dropped_events", "ph": "C", "ts": 0, "pid": {}, "tid": {}, "args": {{"dropped": {}}}}})",
+                pid,
+                buffer->m_tid,
+                dropped);
+        }
+        // Frees the slots for the owner, which keeps appending while this runs.
+        buffer->m_tail.store(head, std::memory_order_release);
+        return orphaned;
+    });
+    return out;
+}
+
+} // namespace
+
+void TraceRecorder::enable(size_t events_per_thread)
+{
+    auto &s = state();
+    std::lock_guard lock(s.m_mutex);
+    s.m_capacity = events_per_thread;
+    s.m_enabled.store(true, std::memory_order_release);
+}
+
+void TraceRecorder::disable()
+{
+    state().m_enabled.store(false, std::memory_order_release);
+}
+
+bool TraceRecorder::enabled()
+{
+    return state().m_enabled.load(std::memory_order_relaxed);
+}
+
+int64_t TraceRecorder::now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - state().m_origin)
+        .count();
+}
+
+void TraceRecorder::record(std::string_view category, std::string_view name, std::string_view name_suffix,
+                           int64_t start_ns, int64_t end_ns)
+{
+    if (!enabled()) {
+        return;
+    }
+    auto &buffer = thread_buffer();
+    const auto head = buffer.m_head.load(std::memory_order_relaxed);
+    if (head - buffer.m_tail.load(std::memory_order_acquire) == buffer.m_capacity) {
+        buffer.m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer.m_events[head % buffer.m_capacity] = {category, name, name_suffix, start_ns, end_ns};
+    buffer.m_head.store(head + 1, std::memory_order_release);
+}
+
+int64_t TraceRecorder::origin_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(state().m_origin.time_since_epoch()).count();
+}
+
+std::string TraceRecorder::take_events(int64_t shift_ns)
+{
+    auto &s = state();
+    std::lock_guard lock(s.m_mutex);
+    return take_events_locked(s, shift_ns);
+}
+
+void TraceRecorder::add_events(std::string_view events)
+{
+    if (events.empty()) {
+        return;
+    }
+    auto &s = state();
+    std::lock_guard lock(s.m_mutex);
+    if (!s.m_foreign_events.empty()) {
+        s.m_foreign_events += ",\n";
+    }
+    s.m_foreign_events += events;
+}
+
+bool TraceRecorder::write(const std::string &path)
+{
+    auto &s = state();
+    std::lock_guard lock(s.m_mutex);
+
+    auto events = take_events_locked(s, 0);
+    if (!s.m_foreign_events.empty()) {
+        events += events.empty() ? "" : ",\n";
+        events += s.m_foreign_events;
+        s.m_foreign_events.clear();
+    }
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+    out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+    if (!events.empty()) {
+        out << '\n' << events;
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
+
+} // namespace psi::test
@@ -0,0 +1,232 @@
+#include "psi/test/psi_zone.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <vector>
+
+namespace psi::test {
+
+namespace {
+
+struct ZoneEvent {
+    const char *m_name;
+    int64_t m_start_ns;
+    int64_t m_end_ns;
+};
+
+struct ZoneSlot {
+    const char *m_name = nullptr;
+    ZoneStats m_stats;
+};
+
+/// Single-producer ring. The owning thread appends; when the ring is full it folds the pending events
+/// into m_folded under m_drain_lock, which is otherwise taken only by ZoneProfiler::snapshot().
+struct ZoneBuffer {
+    static constexpr size_t kCapacity = 1 << 14;
+    static constexpr size_t kFoldSlots = 128;
+
+    ZoneEvent m_events[kCapacity];
+    std::atomic<uint64_t> m_write {0};
+    std::atomic<uint64_t> m_read {0};
+    std::atomic_flag m_drain_lock;
+    ZoneSlot m_folded[kFoldSlots];
+    std::atomic<uint64_t> m_dropped {0};
+
+    void lock() noexcept
+    {
+        while (m_drain_lock.test_and_set(std::memory_order_acquire)) {
+        }
+    }
+    void unlock() noexcept
+    {
+        m_drain_lock.clear(std::memory_order_release);
+    }
+
+    // Callers hold m_drain_lock.
+    template <typename Sink>
+    void drain(Sink &&sink) noexcept
+    {
+        const auto w = m_write.load(std::memory_order_acquire);
+        for (auto r = m_read.load(std::memory_order_relaxed); r != w; ++r) {
+            sink(m_events[r & (kCapacity - 1)]);
+        }
+        m_read.store(w, std::memory_order_release);
+    }
+
+    void fold() noexcept
+    {
+        lock();
+        drain([this](const ZoneEvent &e) {
+            const auto duration = static_cast<uint64_t>(e.m_end_ns - e.m_start_ns);
+            for (auto &slot : m_folded) {
+                if (!slot.m_name) {
+                    slot.m_name = e.m_name;
+                }
+                if (slot.m_name == e.m_name) {
+                    ++slot.m_stats.m_count;
+                    slot.m_stats.m_total_ns += duration;
+                    slot.m_stats.m_max_ns = std::max(slot.m_stats.m_max_ns, duration);
+                    return;
+                }
+            }
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+        });
+        unlock();
+    }
+};
+
+struct BufferDeleter {
+    void operator()(ZoneBuffer *b) const noexcept
+    {
+        b->~ZoneBuffer();
+        std::free(b);
+    }
+};
+
+using BufferPtr = std::shared_ptr<ZoneBuffer>;
+
+struct ZoneRegistry {
+    std::mutex m_mutex;
+    std::vector<BufferPtr> m_buffers;
+    ZoneReport m_report;
+    uint64_t m_dropped = 0;
+};
+
+ZoneRegistry &registry()
+{
+    static auto *instance = new ZoneRegistry();
+    return *instance;
+}
+
+void merge_into(ZoneStats &to, const ZoneStats &from)
+{
+    to.m_count += from.m_count;
+    to.m_total_ns += from.m_total_ns;
+    to.m_max_ns = std::max(to.m_max_ns, from.m_max_ns);
+}
+
+// Rings are allocated with malloc so that they do not show up in the per-test heap peak.
+ZoneBuffer *thread_buffer()
+{
+    thread_local BufferPtr buffer = []() -> BufferPtr {
+        void *memory = std::malloc(sizeof(ZoneBuffer));
+        if (!memory) {
+            return nullptr;
+        }
+        BufferPtr b(new (memory) ZoneBuffer(), BufferDeleter());
+        auto &r = registry();
+        std::lock_guard lock(r.m_mutex);
+        r.m_buffers.push_back(b);
+        return b;
+    }();
+    return buffer.get();
+}
+
+void drain_all(ZoneRegistry &r)
+{
+    for (auto &buffer : r.m_buffers) {
+        buffer->lock();
+        buffer->drain([&](const ZoneEvent &e) {
+            const auto duration = static_cast<uint64_t>(e.m_end_ns - e.m_start_ns);
+            auto &stats = r.m_report[e.m_name];
+            ++stats.m_count;
+            stats.m_total_ns += duration;
+            stats.m_max_ns = std::max(stats.m_max_ns, duration);
+        });
+        for (auto &slot : buffer->m_folded) {
+            if (!slot.m_name) {
+                break;
+            }
+            merge_into(r.m_report[slot.m_name], slot.m_stats);
+            slot = {};
+        }
+        r.m_dropped += buffer->m_dropped.exchange(0, std::memory_order_relaxed);
+        buffer->unlock();
+    }
+    // Buffers referenced only by the registry belong to finished threads.
+    std::erase_if(r.m_buffers, [](const BufferPtr &b) { return b.use_count() == 1; });
+}
+
+} // namespace
+
+int64_t ZoneProfiler::now_ns() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void ZoneProfiler::record(const char *name, int64_t start_ns, int64_t end_ns) noexcept
+{
+    auto *buffer = thread_buffer();
+    if (!buffer) {
+        return;
+    }
+    auto w = buffer->m_write.load(std::memory_order_relaxed);
+    if (w - buffer->m_read.load(std::memory_order_acquire) >= ZoneBuffer::kCapacity) {
+        buffer->fold();
+    }
+    buffer->m_events[w & (ZoneBuffer::kCapacity - 1)] = {name, start_ns, end_ns};
+    buffer->m_write.store(w + 1, std::memory_order_release);
+}
+
+void ZoneProfiler::reset()
+{
+    auto &r = registry();
+    std::lock_guard lock(r.m_mutex);
+    drain_all(r);
+    r.m_report.clear();
+    r.m_dropped = 0;
+}
+
+ZoneReport ZoneProfiler::snapshot()
+{
+    auto &r = registry();
+    std::lock_guard lock(r.m_mutex);
+    drain_all(r);
+    return r.m_report;
+}
+
+ZoneReport ZoneProfiler::delta(const ZoneReport &after, const ZoneReport &before)
+{
+    ZoneReport result;
+    for (const auto &[name, stats] : after) {
+        auto d = stats;
+        if (auto it = before.find(name); it != before.end()) {
+            d.m_count -= it->second.m_count;
+            d.m_total_ns -= it->second.m_total_ns;
+        }
+        if (d.m_count) {
+            result.emplace(name, d);
+        }
+    }
+    return result;
+}
+
+uint64_t ZoneProfiler::dropped()
+{
+    auto &r = registry();
+    std::lock_guard lock(r.m_mutex);
+    return r.m_dropped;
+}
+
+void ZoneProfiler::print(std::ostream &os, const ZoneReport &report, const std::string &prefix)
+{
+    for (const auto &[name, stats] : report) {
+        os << std::format("{} {}: count={} total={:.3f} us mean={:.1f} ns max={} ns\n",
+                          prefix,
+                          name,
+                          stats.m_count,
+                          static_cast<double>(stats.m_total_ns) / 1000.0,
+                          stats.mean_ns(),
+                          stats.m_max_ns);
+    }
+}
+
+} // namespace psi::test
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "psi/test/psi_async.h"
+#include "psi/test/psi_mock.h"
+#include "psi/test/psi_trace.h"
+
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace psi::test {
+
+static AsyncTask async_add_later(int &value, int delta)
+{
+    co_await async_sleep(std::chrono::milliseconds(1));
+    value += delta;
+}
+
+/// Completes on its own thread, like the callback of an I/O library, and resumes the awaiter with post().
+struct ThreadCompletionAwaiter {
+    std::thread &m_worker;
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> h) const
+    {
+        m_worker = std::thread([h] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            AsyncExecutor::post(h);
+        });
+    }
+    void await_resume() const noexcept {}
+};
+
+static AsyncTask async_complete_on_thread(int &value)
+{
+    std::thread worker;
+    co_await ThreadCompletionAwaiter {worker};
+    worker.join();
+    value = 7;
+}
+
+ASYNC_TEST(AsyncTest, sleep_and_yield)
+{
+    const auto start = std::chrono::steady_clock::now();
+    co_await async_sleep(std::chrono::milliseconds(5));
+    co_await async_yield();
+    EXPECT_TRUE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(5));
+}
+
+ASYNC_TEST(AsyncTest, awaits_future)
+{
+    std::promise<int> promise;
+    std::thread producer([&promise] { promise.set_value(42); });
+    const auto value = co_await async_wait(promise.get_future());
+    producer.join();
+    EXPECT_EQ(value, 42);
+}
+
+ASYNC_TEST(AsyncTest, awaits_nested_task)
+{
+    int value = 1;
+    co_await async_add_later(value, 2);
+    co_await async_add_later(value, 3);
+    EXPECT_EQ(value, 6);
+}
+
+ASYNC_TEST(AsyncTest, keeps_current_test_across_suspensions)
+{
+    const auto *test = TestLib::current_running_test();
+    auto mock = MockedFn<std::function<int(int)>>::create();
+    EXPECT_CALL(mock, 1).WithArgs(7);
+    co_await async_sleep(std::chrono::milliseconds(2));
+    EXPECT_TRUE(TestLib::current_running_test() == test);
+    mock->fn()(7);
+}
+
+ASYNC_TEST(AsyncTest, resumes_from_another_thread)
+{
+    const auto *test = TestLib::current_running_test();
+    std::thread worker;
+    co_await ThreadCompletionAwaiter {worker};
+    worker.join();
+    EXPECT_TRUE(TestLib::current_running_test() == test);
+
+    int value = 0;
+    co_await async_complete_on_thread(value);
+    EXPECT_EQ(value, 7);
+    EXPECT_TRUE(TestLib::current_running_test() == test);
+}
+
+TEST(AsyncExecutor, times_out_hung_tests_and_traces_every_test)
+{
+    TestLib::TestCase hung {"AsyncExecutor", "hung", {}, {}};
+    hung.m_async_fn = []() -> AsyncTask {
+        std::promise<int> never;
+        co_await async_wait(never.get_future());
+    };
+    TestLib::TestCase quick {"AsyncExecutor", "quick", {}, {}};
+    quick.m_async_fn = []() -> AsyncTask { co_return; };
+
+    // Under --psi_trace the run's own events are set aside and handed back for its trace.
+    const bool was_enabled = TraceRecorder::enabled();
+    const auto earlier = TraceRecorder::take_events();
+    TraceRecorder::enable();
+    std::vector<std::string> completed;
+    const auto start = std::chrono::steady_clock::now();
+    TestLib::TestCase scratch;
+    TestLib::run_as(scratch, [&] {
+        const std::vector<TestLib::TestCase *> tests {&hung, &quick};
+        AsyncExecutor::run(
+            tests,
+            [&](TestLib::TestCase &test, std::exception_ptr) { completed.push_back(test.m_test_name); },
+            std::chrono::milliseconds(50));
+    });
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    const auto events = TraceRecorder::take_events();
+    if (!was_enabled) {
+        TraceRecorder::disable();
+    }
+    TraceRecorder::add_events(earlier);
+
+    EXPECT_EQ(completed, std::vector<std::string> {"quick", "hung"});
+    EXPECT_TRUE(elapsed < std::chrono::seconds(10));
+    EXPECT_FALSE(quick.m_test_result.m_is_failed);
+    ASSERT_EQ(hung.m_test_result.m_failures.size(), size_t(1));
+    EXPECT_CONTAINS(std::string(hung.m_test_result.m_failures[0].m_message), "did not finish within 50 ms");
+    EXPECT_CONTAINS(events, R"("name": "AsyncExecutor.hung", "cat": "test", "ph": "X")");
+    EXPECT_CONTAINS(events, R"("name": "AsyncExecutor.quick", "cat": "test", "ph": "X")");
+}
+
+} // namespace psi::test
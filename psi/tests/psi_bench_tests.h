@@ -0,0 +1,253 @@
+#pragma once
+
+#include "psi/test/TestHelper.h"
+#include "psi/test/psi_mock.h"
+
+#include <sstream>
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+namespace psi::test {
+
+TEST(SpinBarrier, releases_all_threads)
+{
+    constexpr int kThreads = 4;
+    SpinBarrier barrier(kThreads);
+    std::atomic<int> passed {0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+        threads.emplace_back([&]() {
+            barrier.arrive_and_wait();
+            passed.fetch_add(1);
+            barrier.arrive_and_wait();
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(passed.load(), kThreads);
+}
+
+TEST(TestHelper, timeFn_threads_fixed_op_count)
+{
+    std::vector<detail::PaddedCounter> counters(2);
+    ThroughputOptions opts;
+    opts.thread_counts = {1, 2};
+    opts.ops_per_thread = 1000;
+    const auto results = TestHelper::timeFn_threads(
+        "counter", [&counters](int t) { ++counters[static_cast<size_t>(t)].m_value; }, opts);
+    ASSERT_EQ(results.size(), 2u);
+    EXPECT_EQ(results[1].m_threads, 2);
+    EXPECT_EQ(results[1].m_ops_per_thread[1], 1000u);
+    EXPECT_EQ(counters[0].m_value, 2000u);
+    EXPECT_EQ(results[0].m_efficiency, 1.0);
+}
+
+TEST(TestHelper, throughput_thread_counts_default)
+{
+    ThroughputOptions opts;
+    opts.max_threads = 6;
+    const auto counts = detail::throughput_thread_counts(opts);
+    EXPECT_EQ(counts, std::vector<int> {1, 2, 4, 6});
+}
+
+TEST(TestHelper, timeFn_cache_reports_warm_and_cold)
+{
+    constexpr int kCopies = 4;
+    std::vector<std::vector<int>> inputs(kCopies, std::vector<int>(4096, 1));
+    CacheOptions opts;
+    opts.flush_bytes = 1 << 20;
+    opts.flush_ranges = {{inputs[0].data(), inputs[0].size() * sizeof(int)}};
+    opts.input_copies = kCopies;
+    std::vector<int> calls(kCopies);
+    const auto result = TestHelper::timeFn_cache(
+        "vector_sum",
+        [&](int copy) {
+            ++calls[static_cast<size_t>(copy)];
+            volatile int sum = 0;
+            for (const auto x : inputs[static_cast<size_t>(copy)]) {
+                sum = sum + x;
+            }
+        },
+        20, opts);
+    EXPECT_EQ(result.m_flush_bytes, size_t(1) << 20);
+    ASSERT_TRUE(result.m_rotated.has_value());
+    EXPECT_EQ(calls, std::vector<int> {1 + 20 + 20 + 1 + 5, 1 + 5, 1 + 5, 1 + 5});
+    EXPECT_TRUE(result.m_warm.m_median_ns <= result.m_warm.m_p90_ns);
+    EXPECT_LE(size_t(64) << 10, last_level_cache_bytes());
+}
+
+TEST(TestHelper, ab_benchmark_detects_faster_b)
+{
+    AbOptions opts;
+    opts.rounds = 15;
+    opts.min_time = std::chrono::milliseconds(1);
+    opts.seed = 42;
+    opts.require_b_faster = true;
+    auto sum = [](int n) {
+        volatile int s = 0;
+        for (int i = 0; i < n; ++i) {
+            s = s + i;
+        }
+    };
+    const auto result = AB_BENCHMARK("sum", [&]() { sum(4000); }, [&]() { sum(100); }, opts);
+    EXPECT_EQ(result.m_a_ns.size(), 15u);
+    EXPECT_EQ(result.m_seed, 42u);
+    EXPECT_TRUE(result.m_significant);
+    EXPECT_TRUE(result.m_ci_low > 1.0 && result.m_ci_low <= result.m_speedup);
+}
+
+TEST(BenchStatistics, mann_whitney_and_median_interval)
+{
+    const std::vector<double> low {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    const std::vector<double> high {11, 12, 13, 14, 15, 16, 17, 18, 19, 20};
+    EXPECT_EQ(detail::mann_whitney_u(low, high).m_u, 0.0);
+    EXPECT_TRUE(detail::mann_whitney_u(low, high).m_p_value < 0.001);
+    EXPECT_EQ(detail::mann_whitney_u(low, low).m_p_value, 1.0);
+    // n = 10 at 95%: the 2nd and 9th order statistics (P(X <= 1) = 0.0107).
+    const auto [ci_low, ci_high] = detail::median_confidence_interval(high, 0.95);
+    EXPECT_EQ(ci_low, 12.0);
+    EXPECT_EQ(ci_high, 19.0);
+}
+
+TEST(BenchRange, ranges_and_product)
+{
+    EXPECT_EQ(BenchRange::dense(1, 7, 3), std::vector<int64_t> {1, 4, 7});
+    EXPECT_EQ(BenchRange::linear(0, 100, 5), std::vector<int64_t> {0, 25, 50, 75, 100});
+    EXPECT_EQ(BenchRange::pow2(8, 100), std::vector<int64_t> {8, 16, 32, 64, 100});
+    const auto p = BenchRange::product({{1, 2}, {10, 20, 30}});
+    ASSERT_EQ(p.size(), 6u);
+    EXPECT_EQ(p[1], std::vector<int64_t> {1, 20});
+    EXPECT_EQ(p[5], std::vector<int64_t> {2, 30});
+}
+
+TEST(BenchRange, fit_complexity_classes)
+{
+    std::vector<int64_t> n;
+    std::vector<double> linear;
+    std::vector<double> quadratic;
+    std::vector<double> constant;
+    for (int64_t v = 1 << 4; v <= 1 << 14; v *= 2) {
+        n.push_back(v);
+        linear.push_back(3.0 * static_cast<double>(v));
+        quadratic.push_back(0.5 * static_cast<double>(v * v));
+        constant.push_back(42.0);
+    }
+    EXPECT_TRUE(fit_complexity(n, linear).m_complexity == Complexity::ON);
+    EXPECT_TRUE(fit_complexity(n, quadratic).m_complexity == Complexity::ON2);
+    EXPECT_TRUE(fit_complexity(n, constant).m_complexity == Complexity::O1);
+    EXPECT_TRUE(fit_complexity(n, linear).m_rms < 0.01);
+}
+
+TEST(TestHelper, timeFn_sweep_setup_is_not_timed)
+{
+    SweepOptions opts;
+    opts.min_time = std::chrono::milliseconds(1);
+    opts.max_complexity = Complexity::ON2;
+    int setups = 0;
+    const auto results = TestHelper::timeFn_sweep(
+        "vector_sum",
+        BenchRange::pow2(64, 1024),
+        [&setups](int64_t n) {
+            ++setups;
+            // Far slower than any measured call: a timed setup would show up in every row.
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            return [v = std::vector<int64_t>(static_cast<size_t>(n), 1)]() {
+                volatile int64_t sum = 0;
+                for (const auto x : v) {
+                    sum = sum + x;
+                }
+            };
+        },
+        opts);
+    EXPECT_EQ(results.size(), 5u);
+    EXPECT_EQ(setups, 5);
+    for (const auto &r : results) {
+        EXPECT_TRUE(r.m_ns_per_call < 1e6);
+    }
+}
+
+TEST(BenchEnvironment, parse_cpu_list)
+{
+    EXPECT_EQ(parse_cpu_list("0,2,4-6"), std::vector<int> {0, 2, 4, 5, 6});
+    EXPECT_TRUE(parse_cpu_list("").empty());
+}
+
+TEST(BenchEnvironment, probe_reports_online_cpus)
+{
+    const auto &env = probe_environment();
+    EXPECT_LE(1, env.m_online_cpus);
+    std::ostringstream os;
+    print_environment(os, env);
+    EXPECT_CONTAINS(os.str(), "[env] cpus=");
+    if (!env.m_high_priority) {
+        EXPECT_CONTAINS(os.str(), "[env] note: normal scheduling priority");
+        EXPECT_TRUE(os.str().find("WARNING: normal scheduling priority") == std::string::npos);
+    }
+}
+
+TEST(BenchEnvironment, printed_once_until_restored)
+{
+    std::ostringstream first;
+    std::ostringstream second;
+    print_environment_once(first);
+    print_environment_once(second);
+    EXPECT_TRUE(second.str().empty());
+    EXPECT_TRUE(first.str().empty() || first.str().starts_with("[env] cpus="));
+    // Every result still gets the one-line summary.
+    std::ostringstream line;
+    print_environment_line(line, "bench");
+    EXPECT_CONTAINS(line.str(), "[bench] env: cpus=");
+    EXPECT_TRUE(line.str().find("[env]") == std::string::npos);
+}
+
+#if defined(__linux__)
+TEST(BenchEnvironment, restore_puts_back_the_priority)
+{
+    if (probe_environment().m_high_priority) {
+        return; // the run itself was stabilized, restoring here would undo it
+    }
+    const int nice = getpriority(PRIO_PROCESS, 0);
+    const auto &env = stabilize_environment({{}, true});
+    EXPECT_TRUE(!env.m_high_priority || getpriority(PRIO_PROCESS, 0) == -10);
+    restore_environment();
+    EXPECT_EQ(getpriority(PRIO_PROCESS, 0), nice);
+    EXPECT_FALSE(probe_environment().m_high_priority);
+    std::ostringstream os;
+    print_environment_once(os);
+    EXPECT_CONTAINS(os.str(), "[env] cpus=");
+}
+#endif
+
+TEST(BenchNoise, chunks_flag_an_unsteady_run)
+{
+    const auto steady = detail::summarize_chunks(500.0, 5, {100.0, 100.0, 100.0, 100.0, 100.0}, 0.05);
+    EXPECT_EQ(steady.m_ns_per_call, 100.0);
+    EXPECT_EQ(steady.m_cv, 0.0);
+    EXPECT_FALSE(steady.m_noisy);
+    const auto unsteady = detail::summarize_chunks(600.0, 5, {100.0, 100.0, 100.0, 100.0, 200.0}, 0.05);
+    EXPECT_TRUE(unsteady.m_noisy);
+    EXPECT_CONTAINS(detail::format_noise(unsteady.m_cv, unsteady.m_noisy), "[NOISY]");
+
+    int calls = 0;
+    auto count = [&calls]() { ++calls; };
+    detail::time_in_chunks(count, 7, 0.05);
+    EXPECT_EQ(calls, 7);
+    EXPECT_EQ(detail::chunk_begin(detail::kNoiseChunks, 7), 7u);
+    const auto cache = detail::summarize_cache_samples({10.0, 10.0, 10.0, 10.0, 10.0, 10.0, 10.0, 10.0, 10.0, 50.0},
+                                                       0.05);
+    EXPECT_EQ(cache.m_mean_ns, 14.0);
+    EXPECT_TRUE(cache.m_noisy);
+}
+
+TEST(BenchEnvironment, summarize_samples_median_and_cv)
+{
+    const auto m = detail::summarize_samples({10.0, 30.0, 20.0});
+    EXPECT_EQ(m.m_ns_per_call, 20.0);
+    EXPECT_EQ(m.m_cv, 0.5);
+    EXPECT_EQ(detail::summarize_samples({5.0, 5.0}).m_cv, 0.0);
+}
+
+} // namespace psi::test
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "psi/test/psi_cache.h"
+#include "psi/test/psi_mock.h"
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <string>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace psi::test {
+
+TEST(ResultCache, hash_hex_is_stable)
+{
+    const std::string a = "the quick brown fox jumps over the lazy dog";
+    EXPECT_EQ(hash_hex(a.data(), a.size()), hash_hex(a.data(), a.size()));
+    EXPECT_TRUE(hash_hex(a.data(), a.size()) != hash_hex(a.data(), a.size() - 1));
+    EXPECT_EQ(hash_hex(a.data(), a.size()).size(), size_t(32));
+}
+
+TEST(ResultCache, key_follows_declared_inputs)
+{
+    if (ResultCache::enabled()) {
+        return; // the run itself uses the cache, leave it alone
+    }
+#if defined(_WIN32)
+    const auto pid = ::_getpid();
+#else
+    const auto pid = ::getpid();
+#endif
+    // Both the cache and the declared input live in a directory of this process, so that concurrent runs and
+    // the working directory do not matter.
+    const auto dir = std::filesystem::temp_directory_path() / std::format("psi_cache_tests.{}", pid);
+    std::filesystem::create_directories(dir);
+    const auto input = (dir / "input.txt").string();
+    const std::string name = "ResultCache.key_follows_declared_inputs";
+    // What PSI_TEST_INPUTS does at startup, once, with a path only known now.
+    static const bool s_declared = (ResultCache::declare_inputs(name, {input.c_str()}), true);
+    static_cast<void>(s_declared);
+    ASSERT_TRUE(ResultCache::open((dir / "cache").string(), {}));
+
+    std::ofstream(input) << "v1";
+    const auto key_v1 = ResultCache::key(name);
+    ResultCache::store_pass(key_v1, name, 12);
+    EXPECT_TRUE(ResultCache::has_pass(key_v1, name));
+    EXPECT_FALSE(ResultCache::has_pass(key_v1, "Other.name"));
+
+    std::ofstream(input) << "v2";
+    const auto key_v2 = ResultCache::key(name);
+    EXPECT_TRUE(key_v1 != key_v2);
+    EXPECT_FALSE(ResultCache::has_pass(key_v2, name));
+
+    ResultCache::close();
+    std::filesystem::remove_all(dir);
+}
+
+} // namespace psi::test
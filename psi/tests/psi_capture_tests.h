@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include "psi/test/psi_capture.h"
+#include "psi/test/psi_mock.h"
+
+namespace psi::test {
+
+TEST(OutputCapture, captures_stdout_and_stderr)
+{
+    // Skipped when the run itself captures (--psi_capture_output): captures do not nest.
+    if (!OutputCapture::start(1024)) {
+        return;
+    }
+    EXPECT_TRUE(OutputCapture::active());
+    std::printf("from printf\n");
+    std::cout << "from cout\n";
+    std::cerr << "from cerr\n";
+    const auto captured = OutputCapture::stop();
+    EXPECT_FALSE(OutputCapture::active());
+    EXPECT_EQ(captured, "from printf\nfrom cout\nfrom cerr\n");
+}
+
+TEST(OutputCapture, keeps_head_and_tail)
+{
+    if (!OutputCapture::start(4)) {
+        return;
+    }
+    std::cout << "head" << std::string(10000, '.') << "tail";
+    const auto captured = OutputCapture::stop();
+    EXPECT_TRUE(captured.starts_with("head\n"));
+    EXPECT_TRUE(captured.ends_with("tail"));
+    EXPECT_CONTAINS(captured, "10000 bytes of output omitted");
+}
+
+TEST(OutputCapture, bounds_long_output_to_head_and_tail)
+{
+    if (!OutputCapture::start(1000)) {
+        return;
+    }
+    // 8 MB in lines of 16 bytes: far more than the pipe holds, so the reader thread has to keep up.
+    for (int i = 0; i < 500000; ++i) {
+        std::printf("line %010d\n", i);
+    }
+    const auto captured = OutputCapture::stop();
+    EXPECT_TRUE(captured.starts_with("line 0000000000\nline 0000000001\n"));
+    EXPECT_TRUE(captured.ends_with("line 0000499999\n"));
+    EXPECT_CONTAINS(captured, "\n[PSI-TEST] ... 7998000 bytes of output omitted ...\n");
+    EXPECT_TRUE(captured.size() < 2100);
+}
+
+TEST(OutputCapture, short_output_is_returned_whole)
+{
+    if (!OutputCapture::start(8)) {
+        return;
+    }
+    std::printf("0123456789abcdef");
+    EXPECT_EQ(OutputCapture::stop(), "0123456789abcdef");
+}
+
+} // namespace psi::test
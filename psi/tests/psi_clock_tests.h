@@ -0,0 +1,55 @@
+#pragma once
+
+#include "psi/test/psi_clock.h"
+#include "psi/test/psi_mock.h"
+
+#include <chrono>
+#include <vector>
+
+namespace psi::test {
+
+TEST(FakeClock, advance_fires_due_timers_in_order)
+{
+    using namespace std::chrono_literals;
+    std::vector<int> fired;
+    std::vector<FakeClock::time_point> fired_at;
+    FakeClock::schedule_after(30ms, [&] { fired.push_back(3); });
+    FakeClock::schedule_after(10ms, [&] {
+        fired.push_back(1);
+        fired_at.push_back(FakeClock::now());
+        FakeClock::schedule_after(5ms, [&] { fired.push_back(2); });
+    });
+    const auto cancelled = FakeClock::schedule_after(20ms, [&] { fired.push_back(-1); });
+    EXPECT_TRUE(FakeClock::cancel(cancelled));
+
+    EXPECT_EQ(FakeClock::advance(25ms), size_t(2));
+    EXPECT_EQ(fired, std::vector<int> {1, 2});
+    EXPECT_TRUE(fired_at.front() == FakeClock::time_point(10ms));
+    EXPECT_TRUE(FakeClock::now() == FakeClock::time_point(25ms));
+    EXPECT_EQ(FakeClock::pending_timers(), size_t(1));
+}
+
+TEST(FakeClock, advance_to_next_deadline)
+{
+    using namespace std::chrono_literals;
+    int calls = 0;
+    FakeClock::schedule_after(1h, [&] { ++calls; });
+    EXPECT_TRUE(FakeClock::advance_to_next());
+    EXPECT_EQ(calls, 1);
+    EXPECT_TRUE(FakeClock::now() == FakeClock::time_point(1h));
+    EXPECT_FALSE(FakeClock::advance_to_next());
+}
+
+TEST(FakeClock, mock_called_after_virtual_delay)
+{
+    using namespace std::chrono_literals;
+    auto on_timeout = MockedFn<std::function<void(int)>>::create();
+    EXPECT_CALL(on_timeout, 1).WithArgs(408);
+    FakeClock::call_after(30s, on_timeout, 408);
+    FakeClock::advance(29s);
+    EXPECT_EQ(on_timeout->get_calls_count(), 0);
+    FakeClock::advance(1s);
+    EXPECT_EQ(on_timeout->get_calls_count(), 1);
+}
+
+} // namespace psi::test
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "psi/test/psi_constexpr.h"
+
+#include <algorithm>
+#include <array>
+#include <string_view>
+
+namespace psi::test {
+
+namespace {
+
+constexpr int triangle(int n)
+{
+    return n * (n + 1) / 2;
+}
+
+} // namespace
+
+CONSTEXPR_TEST(ConstexprTest, checked_at_compile_time_and_runtime)
+{
+    ctx.expect_eq(triangle(4), 10);
+    ctx.expect_ne(triangle(0), 1);
+    std::array<int, 4> values {4, 2, 3, 1};
+    std::sort(values.begin(), values.end());
+    ctx.expect_true(values.front() == 1);
+    ctx.expect_le(values[2], values[3]);
+    ctx.expect_false(std::string_view("abc").empty());
+}
+
+} // namespace psi::test
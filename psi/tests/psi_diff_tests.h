@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+
+#include "psi/test/psi_diff.h"
+#include "psi/test/psi_mock.h"
+
+namespace psi::test {
+
+TEST(Diff, text_hunks_and_summary)
+{
+    std::string a;
+    for (int i = 0; i < 100; ++i) {
+        a += "line " + std::to_string(i) + "\n";
+    }
+    std::string b = a;
+    b.replace(b.find("line 40\n"), 8, "line forty\n");
+    b.erase(b.find("line 90\n"), 8);
+
+    const auto diff = diff_text(a, b);
+    EXPECT_CONTAINS(diff, "first difference at line 41, column 6");
+    EXPECT_CONTAINS(diff, "2 line(s) removed, 1 added");
+    EXPECT_CONTAINS(diff, "@@ -38,7 +38,7 @@");
+    EXPECT_CONTAINS(diff, "\n  -line 40\n  +line forty\n   line 41");
+    EXPECT_CONTAINS(diff, "\n  -line 90\n   line 91");
+    EXPECT_FALSE(diff.find("line 20") != std::string::npos);
+}
+
+TEST(Diff, bytes_window)
+{
+    std::string a(256, '\0');
+    std::string b = a;
+    b[100] = 'Z';
+    EXPECT_TRUE(looks_binary(a));
+
+    const auto diff = diff_bytes(a.data(), a.size(), b.data(), b.size());
+    EXPECT_CONTAINS(diff, "first difference at offset 0x64 (100)");
+    EXPECT_CONTAINS(diff, "1 of 256 compared bytes differ");
+    EXPECT_CONTAINS(diff, "+00000060  00 00 00 00 5a 00");
+    EXPECT_FALSE(diff.find("00000000 ") != std::string::npos);
+}
+
+TEST(Diff, short_values_keep_plain_message)
+{
+    EXPECT_EQ(detail::describe_string_mismatch("abc", "abd"), std::string("abc not equal to abd"));
+    EXPECT_CONTAINS(detail::describe_string_mismatch("a\nb\n", "a\nc\n"), "@@ -1,2 +1,2 @@");
+}
+
+} // namespace psi::test
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "psi/test/psi_distributed.h"
+#include "psi/test/psi_mock.h"
+#include "psi_fork.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace psi::test {
+
+#if !defined(_WIN32)
+
+/// Takes down the worker running it when the coordinator test below asks for it, and passes otherwise.
+TEST(DistributedRunner, crashes_worker_on_request)
+{
+    if (std::getenv("PSI_DISTRIBUTED_TESTS_CRASH")) {
+        std::abort();
+    }
+}
+
+/// Workers spawned by the give-up test below exit before they connect, like a binary that fails at startup.
+inline const bool g_distributed_tests_exit_at_startup = []() {
+    if (std::getenv("PSI_DISTRIBUTED_TESTS_EXIT")) {
+        std::_Exit(3);
+    }
+    return false;
+}();
+
+/// Runs a coordinator in a forked copy of the process with `env_flag` set, so that the workers it spawns (fresh
+/// instances of this binary) inherit it.
+static int run_coordinator(const std::filesystem::path &dir,
+                           const char *env_flag,
+                           const std::vector<std::string> &args,
+                           std::string &log_text)
+{
+    const auto log = (dir / "coordinator.log").string();
+    const auto coordinator =
+        fork_logged(log, [&]() { return ::setenv(env_flag, "1", 1) == 0 ? run_test_lib(args) : -1; });
+    return wait_logged(coordinator, log, log_text);
+}
+
+TEST(DistributedRunner, spawned_workers_requeue_crashes_and_ship_traces)
+{
+    const auto dir = std::filesystem::temp_directory_path() / std::format("psi_distributed_tests.{}", ::getpid());
+    std::filesystem::create_directories(dir);
+    const auto trace = (dir / "trace.json").string();
+
+    std::string coordinator_log;
+    const int status = run_coordinator(
+        dir,
+        "PSI_DISTRIBUTED_TESTS_CRASH",
+        {
+            "--psi_coordinator=127.0.0.1:0",
+            "--psi_spawn_workers=2",
+            "--gtest_filter=BenchEnvironment.parse_cpu_list:DistributedRunner.crashes_worker_on_request",
+            "--gtest_color=no",
+            "--psi_trace=" + trace,
+        },
+        coordinator_log);
+    std::stringstream trace_json;
+    trace_json << std::ifstream(trace).rdbuf();
+    std::filesystem::remove_all(dir);
+
+    ASSERT_TRUE(status >= 0 && WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 1);
+    EXPECT_CONTAINS(coordinator_log, "[PSI-DIST] worker lost, re-queueing");
+    EXPECT_CONTAINS(coordinator_log,
+                    "[  FAILED  ] DistributedRunner.crashes_worker_on_request (lost 2 workers while running it)");
+    EXPECT_CONTAINS(coordinator_log, "[       OK ] BenchEnvironment.parse_cpu_list");
+    EXPECT_CONTAINS(coordinator_log, "1 FAILED TEST");
+    // The passing test ran in a worker, so its event can only have come back over the connection.
+    EXPECT_CONTAINS(trace_json.str(), R"("name": "BenchEnvironment.parse_cpu_list", "cat": "test", "ph": "X")");
+}
+
+TEST(DistributedRunner, gives_up_when_no_spawned_worker_is_left)
+{
+    const auto dir = std::filesystem::temp_directory_path() / std::format("psi_distributed_giveup.{}", ::getpid());
+    std::filesystem::create_directories(dir);
+    std::string coordinator_log;
+    const int status = run_coordinator(dir,
+                                       "PSI_DISTRIBUTED_TESTS_EXIT",
+                                       {
+                                           "--psi_coordinator=127.0.0.1:0",
+                                           "--psi_spawn_workers=2",
+                                           "--gtest_filter=BenchEnvironment.parse_cpu_list",
+                                           "--gtest_color=no",
+                                       },
+                                       coordinator_log);
+    std::filesystem::remove_all(dir);
+
+    ASSERT_TRUE(status >= 0 && WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 1);
+    EXPECT_CONTAINS(coordinator_log, "[PSI-DIST] no workers left after spawning 4, failing 1 remaining test");
+    EXPECT_CONTAINS(coordinator_log, "[  FAILED  ] BenchEnvironment.parse_cpu_list (no worker left to run it)");
+}
+
+#endif
+
+} // namespace psi::test
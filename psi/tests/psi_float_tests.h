@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "psi/test/psi_float.h"
+#include "psi/test/psi_mock.h"
+
+namespace psi::test {
+
+TEST(FloatAssertions, near_and_ulp_scalars)
+{
+    EXPECT_NEAR(1.0, 1.0 + 1e-10, 1e-9);
+    EXPECT_NEAR(2.5f, 2.5f, 0.0);
+    EXPECT_NEAR(0.1f, 0.1, 1e-8);
+    EXPECT_NEAR(1.0, 1, 0.0);
+    EXPECT_FLOAT_ULP_EQ(1.0, std::nextafter(1.0, 2.0), 1);
+    EXPECT_FLOAT_ULP_EQ(0.1f + 0.2f, 0.3f);
+    EXPECT_EQ(detail::ulp_distance(0.0, -0.0), uint64_t(0));
+    EXPECT_EQ(detail::ulp_distance(-std::numeric_limits<float>::denorm_min(), std::numeric_limits<float>::denorm_min()),
+              uint64_t(2));
+}
+
+TEST(FloatAssertions, all_near_on_vectors)
+{
+    std::vector<double> a(1001);
+    std::vector<double> b(1001);
+    for (size_t i = 0; i < a.size(); ++i) {
+        a[i] = std::sin(double(i));
+        b[i] = a[i] * (1.0 + 1e-12);
+    }
+    a[7] = b[7] = std::numeric_limits<double>::quiet_NaN();
+    a[9] = b[9] = -std::numeric_limits<double>::infinity();
+    EXPECT_ALL_NEAR(a, b, 0.0, 1e-11);
+
+    std::vector<float> c(a.begin(), a.end());
+    std::vector<float> d(b.begin(), b.end());
+    EXPECT_ALL_NEAR(c, d, 1e-6);
+}
+
+TEST(FloatAssertions, all_ulp_on_vectors)
+{
+    std::vector<float> a(333);
+    std::vector<float> b(333);
+    for (size_t i = 0; i < a.size(); ++i) {
+        a[i] = float(i) * 0.37f - 50.0f;
+        b[i] = std::nextafter(std::nextafter(a[i], 1e9f), 1e9f);
+    }
+    EXPECT_ALL_ULP(a, b, 2);
+
+    std::vector<double> c(a.begin(), a.end());
+    std::vector<double> d(c);
+    d[100] = std::nextafter(d[100], -1e9);
+    EXPECT_ALL_ULP(c, d, 1);
+}
+
+TEST(FloatAssertions, near_summary_of_failing_inputs)
+{
+    const std::vector<double> a {1.0, 2.0, 3.0, 4.0, 5.0};
+    const std::vector<double> b {1.0, 2.5, 3.0, 7.0, 5.05};
+    const auto s = detail::compare_near(a, b, 0.1, 0.0);
+    EXPECT_EQ(s.m_count, size_t(5));
+    EXPECT_EQ(s.m_failures, size_t(2));
+    EXPECT_EQ(s.m_first_failure, size_t(1));
+    EXPECT_TRUE(s.m_max_abs_error == 3.0);
+    EXPECT_EQ(s.m_max_abs_index, size_t(3));
+    EXPECT_EQ(s.m_nan_mismatches, size_t(0));
+    EXPECT_EQ(s.m_inf_mismatches, size_t(0));
+    const auto message = detail::describe_float_failure("EXPECT_ALL_NEAR", s, a, b);
+    EXPECT_CONTAINS(message, "2 of 5 elements outside abs 0.1");
+    EXPECT_CONTAINS(message, "first at [1]: 2 vs 2.5");
+    EXPECT_CONTAINS(message, "max abs error 3 at [3]: 4 vs 7");
+}
+
+TEST(FloatAssertions, ulp_summary_of_failing_inputs)
+{
+    const std::vector<float> a {1.0f, 2.0f, 3.0f};
+    std::vector<float> b(a);
+    b[1] = std::nextafter(std::nextafter(b[1], 3.0f), 3.0f);
+    b[2] = std::nextafter(b[2], 0.0f);
+    for (int i = 0; i < 9; ++i) {
+        b[2] = std::nextafter(b[2], 0.0f);
+    }
+    const auto s = detail::compare_ulps(a, b, 1);
+    EXPECT_EQ(s.m_failures, size_t(2));
+    EXPECT_EQ(s.m_first_failure, size_t(1));
+    EXPECT_EQ(s.m_max_ulps, uint64_t(10));
+    EXPECT_EQ(s.m_max_ulp_index, size_t(2));
+    const auto message = detail::describe_float_failure("EXPECT_ALL_ULP", s, a, b);
+    EXPECT_CONTAINS(message, "2 of 3 elements outside 1 ulps");
+    EXPECT_CONTAINS(message, "max ulp distance 10 at [2]");
+}
+
+TEST(FloatAssertions, nan_and_infinity_mismatches)
+{
+    constexpr auto nan = std::numeric_limits<double>::quiet_NaN();
+    constexpr auto inf = std::numeric_limits<double>::infinity();
+    const std::vector<double> a {nan, 1.0, inf, nan};
+    const std::vector<double> b {1.0, 1.0, -inf, nan};
+
+    const auto near = detail::compare_near(a, b, 1e300, 0.0);
+    EXPECT_EQ(near.m_failures, size_t(2));
+    EXPECT_EQ(near.m_first_failure, size_t(0));
+    EXPECT_EQ(near.m_nan_mismatches, size_t(1));
+    EXPECT_EQ(near.m_inf_mismatches, size_t(1));
+
+    const auto ulps = detail::compare_ulps(a, b, std::numeric_limits<uint64_t>::max());
+    EXPECT_EQ(ulps.m_failures, size_t(1));
+    EXPECT_EQ(ulps.m_nan_mismatches, size_t(1));
+    EXPECT_EQ(ulps.m_inf_mismatches, size_t(0));
+    const auto strict = detail::compare_ulps(a, b, 0);
+    EXPECT_EQ(strict.m_failures, size_t(2));
+    EXPECT_EQ(strict.m_inf_mismatches, size_t(1));
+
+    const auto message = detail::describe_float_failure("EXPECT_ALL_NEAR", near, a, b);
+    EXPECT_CONTAINS(message, "first at [0]: nan vs 1");
+    EXPECT_CONTAINS(message, "NaN mismatches: 1, Inf mismatches: 1");
+}
+
+TEST(FloatAssertions, near_failure_with_mixed_types)
+{
+    TestLib::TestCase scratch;
+    TestLib::run_as(scratch, [] { EXPECT_NEAR(0.1f, 0.1, 1e-12); });
+    const auto &failures = scratch.m_test_result.m_failures;
+    ASSERT_EQ(failures.size(), size_t(1));
+    EXPECT_CONTAINS(std::string(failures[0].m_message), "[PSI-TEST] EXPECT_NEAR: 1 of 1 elements outside abs 1e-12");
+    EXPECT_TRUE(failures[0].m_expression.starts_with("EXPECT_NEAR"));
+}
+
+} // namespace psi::test
@@ -0,0 +1,75 @@
+#pragma once
+
+// Runs whole TestLib runs (or a server) in a forked copy of the test binary: they must not happen inside the
+// calling test's own run.
+
+#if !defined(_WIN32)
+
+#include "psi/test/psi_test.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace psi::test {
+
+/// Forks a copy of the process that writes its stdout to `log` and exits with child()'s return value.
+/// Returns the child's pid, -1 when fork failed.
+template <typename Fn>
+pid_t fork_logged(const std::string &log, Fn &&child)
+{
+    std::cout.flush();
+    std::fflush(nullptr);
+    const pid_t pid = ::fork();
+    if (pid == 0) {
+        int code = -1;
+        if (std::freopen(log.c_str(), "w", stdout)) {
+            code = child();
+            std::fflush(nullptr);
+        }
+        std::_Exit(code);
+    }
+    return pid;
+}
+
+/// Waits for a fork_logged() child and reads its log into `output`. Returns the waitpid status, -1 when pid is
+/// not a child.
+inline int wait_logged(pid_t pid, const std::string &log, std::string &output)
+{
+    int status = -1;
+    if (pid <= 0 || ::waitpid(pid, &status, 0) != pid) {
+        return -1;
+    }
+    std::stringstream text;
+    text << std::ifstream(log).rdbuf();
+    output = text.str();
+    return status;
+}
+
+/// TestLib::run(TestLib::parse_args(...)) with `args` as the command line.
+inline int run_test_lib(std::vector<std::string> args)
+{
+    std::string program = "psi-tests";
+    std::vector<char *> argv {program.data()};
+    for (auto &arg : args) {
+        argv.push_back(arg.data());
+    }
+    return TestLib::run(TestLib::parse_args(argv));
+}
+
+/// run_test_lib(args) in a forked copy of the process; see wait_logged() for the result.
+inline int run_test_lib_forked(const std::string &log, const std::vector<std::string> &args, std::string &output)
+{
+    return wait_logged(fork_logged(log, [&args]() { return run_test_lib(args); }), log, output);
+}
+
+} // namespace psi::test
+
+#endif
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "psi/test/psi_golden.h"
+#include "psi/test/psi_mock.h"
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace psi::test {
+
+/// Fresh directory of this process for one test's golden files, so concurrent runs do not share them.
+static std::filesystem::path golden_test_dir(const std::string &test)
+{
+#if defined(_WIN32)
+    const auto pid = ::_getpid();
+#else
+    const auto pid = ::getpid();
+#endif
+    const auto dir = std::filesystem::temp_directory_path() / std::format("psi_golden_tests.{}", pid) / test;
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    return dir;
+}
+
+/// Removes the test's directory, and the process's one once it is empty.
+static void remove_golden_test_dir(const std::filesystem::path &dir)
+{
+    std::filesystem::remove_all(dir);
+    std::error_code ec;
+    std::filesystem::remove(dir.parent_path(), ec);
+}
+
+TEST(GoldenFile, matches_string_stream_and_bytes)
+{
+    const auto dir = golden_test_dir("match");
+    const auto path = (dir / "golden.txt").string();
+    std::string text;
+    for (int i = 0; i < 100000; ++i) {
+        text += "line " + std::to_string(i) + "\n";
+    }
+    std::ofstream(path, std::ios::binary) << text;
+
+    EXPECT_MATCHES_GOLDEN(path, text);
+    std::istringstream stream(text);
+    EXPECT_MATCHES_GOLDEN(path, stream);
+    EXPECT_MATCHES_GOLDEN(path, std::as_bytes(std::span(text.data(), text.size())));
+    remove_golden_test_dir(dir);
+}
+
+TEST(GoldenFile, mismatch_reports_first_difference)
+{
+    const auto dir = golden_test_dir("mismatch");
+    const auto path = (dir / "golden.txt").string();
+    std::ofstream(path, std::ios::binary) << "alpha\nbeta\ngamma\n";
+
+    const auto error = detail::check_golden(path, "alpha\nbeta\ndelta\n");
+    EXPECT_CONTAINS(error, "first difference at line 3, column 1 (byte 11)");
+    EXPECT_CONTAINS(error, "-gamma");
+    EXPECT_CONTAINS(error, "+delta");
+    std::istringstream shorter("alpha\nbeta\n");
+    EXPECT_CONTAINS(detail::check_golden(path, shorter), "golden 17 bytes, actual 11 bytes");
+    EXPECT_CONTAINS(detail::check_golden(path + ".missing", "x"), "cannot open golden file");
+    remove_golden_test_dir(dir);
+}
+
+TEST(GoldenFile, update_rewrites_differing_files)
+{
+    if (GoldenFile::update_enabled()) {
+        return; // the run itself updates golden files
+    }
+    const auto dir = golden_test_dir("update");
+    // Update mode creates the missing directory as well.
+    const auto path = (dir / "sub" / "out.txt").string();
+
+    GoldenFile::set_update(true);
+    EXPECT_EQ(detail::check_golden(path, "first"), std::string());
+    std::istringstream second("second");
+    EXPECT_EQ(detail::check_golden(path, second), std::string());
+    GoldenFile::set_update(false);
+
+    EXPECT_MATCHES_GOLDEN(path, "second");
+    remove_golden_test_dir(dir);
+}
+
+} // namespace psi::test
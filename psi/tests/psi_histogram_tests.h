@@ -0,0 +1,71 @@
+#pragma once
+
+#include "psi/test/TestHelper.h"
+#include "psi/test/psi_histogram.h"
+#include "psi/test/psi_mock.h"
+
+namespace psi::test {
+
+TEST(LatencyHistogram, exact_below_linear_range)
+{
+    LatencyHistogram h(7);
+    for (uint64_t v = 1; v <= 100; ++v) {
+        h.record(v);
+    }
+    EXPECT_EQ(h.count(), 100u);
+    EXPECT_EQ(h.min(), 1u);
+    EXPECT_EQ(h.max(), 100u);
+    EXPECT_EQ(h.value_at_percentile(50.0), 50u);
+    EXPECT_EQ(h.value_at_percentile(99.0), 99u);
+    EXPECT_EQ(h.value_at_percentile(100.0), 100u);
+}
+
+TEST(LatencyHistogram, relative_error_is_bounded)
+{
+    LatencyHistogram h(7);
+    const uint64_t value = 123456789;
+    h.record(value);
+    h.record(value + 1);
+    const auto p50 = h.value_at_percentile(50.0);
+    EXPECT_LE(value, p50);
+    EXPECT_LE(p50 - value, value / 64);
+}
+
+TEST(LatencyHistogram, buckets_are_continuous_at_powers_of_two)
+{
+    for (const uint64_t value : {uint64_t(0), uint64_t(127), uint64_t(128), uint64_t(129), uint64_t(255),
+                                 uint64_t(256), (uint64_t(1) << 40) - 1, uint64_t(1) << 40}) {
+        LatencyHistogram h(7);
+        h.record(value);
+        h.record(value);
+        h.record(uint64_t(1) << 62);
+        const auto p50 = h.value_at_percentile(50.0);
+        EXPECT_LE(value, p50);
+        EXPECT_LE(p50 - value, value / 64);
+    }
+}
+
+TEST(LatencyHistogram, merge_combines_samples)
+{
+    LatencyHistogram a(7);
+    LatencyHistogram b(5);
+    for (uint64_t v = 0; v < 1000; ++v) {
+        a.record(v);
+        b.record(v + 1000);
+    }
+    a.merge(b);
+    EXPECT_EQ(a.count(), 2000u);
+    EXPECT_EQ(a.max(), 1999u);
+    EXPECT_LE(a.value_at_percentile(25.0), 520u);
+    EXPECT_LE(1400u, a.value_at_percentile(75.0));
+}
+
+TEST(TestHelper, timeFn_latency_records_every_iteration)
+{
+    int calls = 0;
+    const auto h = TestHelper::timeFn_latency("increment", [&calls]() { ++calls; }, 1000);
+    EXPECT_EQ(calls, 1000);
+    EXPECT_EQ(h.count(), 1000u);
+}
+
+} // namespace psi::test
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "psi/test/psi_memory.h"
+#include "psi/test/psi_mock.h"
+#include "psi_fork.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace psi::test {
+
+TEST(MemoryTracker, parse_byte_size)
+{
+    EXPECT_EQ(parse_byte_size("512").value_or(0), 512u);
+    EXPECT_EQ(parse_byte_size("4K").value_or(0), 4096u);
+    EXPECT_EQ(parse_byte_size("2m").value_or(0), size_t(2) << 20);
+    EXPECT_EQ(parse_byte_size("1G").value_or(0), size_t(1) << 30);
+    EXPECT_EQ(parse_byte_size("0").value_or(1), 0u);
+    for (const auto *malformed : {"", "abc", "K", "-1", " 64K", "64Q", "64KB", "64K ", "99999999999999999999"}) {
+        EXPECT_FALSE(parse_byte_size(malformed).has_value());
+    }
+    EXPECT_FALSE(parse_byte_size("17179869184G").has_value());
+}
+
+TEST(MemoryTracker, malformed_budget_is_rejected)
+{
+    std::string program = "psi-memory-tests";
+    std::string heap = "--psi_max_test_heap=64Q";
+    std::string keep = "--psi_capture_output_keep=1M";
+    std::vector<char *> argv {program.data(), heap.data(), keep.data()};
+    const auto opts = TestLib::parse_args(argv);
+    ASSERT_EQ(opts.errors.size(), 1u);
+    EXPECT_CONTAINS(opts.errors.front(), "invalid size in --psi_max_test_heap=64Q");
+    EXPECT_EQ(opts.capture_output_keep, size_t(1) << 20);
+    // Reported before anything runs.
+    EXPECT_EQ(TestLib::run(opts), 1);
+}
+
+TEST(MemoryTracker, tracks_peak_heap)
+{
+    if (!MemoryTracker::heap_tracking_enabled()) {
+        return;
+    }
+    // The runner measures this test's own peak; the window is left alone.
+    const auto base = MemoryTracker::current_heap_bytes();
+    const auto peak_before = MemoryTracker::peak_heap_bytes();
+    {
+        std::vector<char> buffer(1 << 20);
+        EXPECT_GE(MemoryTracker::current_heap_bytes(), base + (1 << 20));
+    }
+    const auto peak_after = MemoryTracker::peak_heap_bytes();
+    EXPECT_TRUE(peak_after >= base + (1 << 20));
+    EXPECT_TRUE(peak_after >= peak_before);
+    EXPECT_LE(MemoryTracker::current_heap_bytes(), base);
+}
+
+TEST(MemoryTracker, tracks_over_aligned_allocations)
+{
+    if (!MemoryTracker::heap_tracking_enabled()) {
+        return;
+    }
+    struct alignas(256) Block {
+        char m_bytes[256];
+    };
+    const auto base = MemoryTracker::current_heap_bytes();
+    {
+        auto blocks = std::make_unique<Block[]>(4096);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(blocks.get()) % 256, 0u);
+        EXPECT_GE(MemoryTracker::current_heap_bytes(), base + 4096 * sizeof(Block));
+    }
+    EXPECT_LE(MemoryTracker::current_heap_bytes(), base);
+}
+
+TEST(MemoryTracker, heap_budget_not_exceeded)
+{
+    TestLib::set_max_test_heap(size_t(64) << 20);
+    std::vector<char> buffer(1 << 10);
+    EXPECT_EQ(buffer.size(), 1024u);
+}
+
+#if !defined(_WIN32)
+
+TEST(MemoryTracker, heap_budget_exceeded_fails_the_test)
+{
+    if (!MemoryTracker::heap_tracking_enabled()) {
+        return;
+    }
+    const auto dir = std::filesystem::temp_directory_path() / std::format("psi_memory_tests.{}", ::getpid());
+    std::filesystem::create_directories(dir);
+    const auto log = (dir / "run.log").string();
+    const auto report = (dir / "report.json").string();
+
+    // A 64K budget on a test that allocates 1M, run through TestLib::run in a forked copy of the process.
+    std::string run_log;
+    const int status = run_test_lib_forked(log,
+                                           {
+                                               "--gtest_filter=MemoryTracker.tracks_peak_heap",
+                                               "--gtest_color=no",
+                                               "--psi_max_test_heap=64K",
+                                               "--gtest_output=json:" + report,
+                                           },
+                                           run_log);
+    std::stringstream json;
+    json << std::ifstream(report).rdbuf();
+    std::filesystem::remove_all(dir);
+
+    ASSERT_TRUE(status >= 0 && WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 1);
+    // The failure line itself is runner output: under an outer --psi_capture_output the forked run writes it
+    // to the saved stdout rather than the log, so the message is checked in the JSON record.
+    EXPECT_CONTAINS(run_log, "[  FAILED  ] MemoryTracker.tracks_peak_heap");
+    EXPECT_CONTAINS(json.str(), R"("failures": 1,)");
+    EXPECT_CONTAINS(json.str(), R"("message": "[PSI-TEST] heap peak ()");
+    EXPECT_CONTAINS(json.str(), "exceeds budget (65536 bytes)\"}");
+    // Reported at the definition of the test, as no check failed.
+    EXPECT_CONTAINS(json.str(), R"("file": ")");
+    EXPECT_CONTAINS(json.str(), "psi_memory_tests.h\", \"line\": ");
+}
+
+#endif
+
+} // namespace psi::test
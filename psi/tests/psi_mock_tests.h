@@ -3,6 +3,11 @@
 
 #include "psi/test/psi_mock.h"
 
+#include <array>
+#include <span>
+#include <string>
+#include <vector>
+
 namespace psi::test {
 
 TEST(MockedFn, create)
@@ -55,6 +60,86 @@ TEST(psi_mock, EXPECT_EQ_vector_equal)
     EXPECT_EQ(a, b);
 }
 
+TEST(psi_mock, EXPECT_EQ_contiguous_ranges_equal)
+{
+    std::vector<uint32_t> a(100000, 7);
+    std::vector<uint32_t> b(100000, 7);
+    EXPECT_EQ(a, b);
+    std::array<int, 3> arr {1, 2, 3};
+    const int c_arr[3] = {1, 2, 3};
+    EXPECT_EQ(std::span<const int>(arr), c_arr);
+    ASSERT_EQ(std::vector<std::string> {"a", "b"}, std::vector<std::string> {"a", "b"});
+}
+
+TEST(psi_mock, EXPECT_EQ_contiguous_ranges_mismatch)
+{
+    std::vector<uint32_t> a(100000, 7);
+    auto b = a;
+    for (size_t i = 5; i < 25; ++i) {
+        b[i] = 8;
+    }
+    TestLib::TestCase scratch;
+    TestLib::run_as(scratch, [&] { EXPECT_EQ(a, b); });
+
+    const auto &failures = scratch.m_test_result.m_failures;
+    ASSERT_EQ(failures.size(), size_t(1));
+    const auto message = std::string(failures[0].m_message);
+    EXPECT_CONTAINS(message, "20 of 100000 compared elements mismatch, first at index 5");
+    EXPECT_CONTAINS(message, "\n  [5] 7 != 8");
+    EXPECT_CONTAINS(message, "\n  [12] 7 != 8");
+    EXPECT_TRUE(message.find("[13]") == std::string::npos);
+    EXPECT_CONTAINS(message, "\n  ... 12 more");
+    EXPECT_CONTAINS(message, "window [2, 9):\n    arg1: 7, 7, 7, 7, 7, 7, 7\n    arg2: 7, 7, 7, 8, 8, 8, 8");
+    EXPECT_EQ(failures[0].m_actual, "7");
+    EXPECT_EQ(failures[0].m_expected, "8");
+}
+
+TEST(psi_mock, EXPECT_EQ_ranges_size_mismatch)
+{
+    TestLib::TestCase scratch;
+    TestLib::run_as(scratch, [] {
+        EXPECT_EQ(std::vector<std::string> {"a", "b", "c"}, std::vector<std::string> {"a", "x"});
+    });
+
+    const auto &failures = scratch.m_test_result.m_failures;
+    ASSERT_EQ(failures.size(), size_t(1));
+    const auto message = std::string(failures[0].m_message);
+    EXPECT_CONTAINS(message, "ranges differ: sizes 3 and 2");
+    EXPECT_CONTAINS(message, "1 of 2 compared elements mismatch, first at index 1");
+    EXPECT_CONTAINS(message, "[1] \"b\" != \"x\"");
+}
+
+/// Equality ignores m_cached_hash, as types with derived members often do; there is no padding either.
+struct KeyWithCache {
+    int m_key = 0;
+    int m_cached_hash = 0;
+    bool operator==(const KeyWithCache &other) const { return m_key == other.m_key; }
+};
+
+TEST(psi_mock, EXPECT_EQ_ranges_use_the_element_operator)
+{
+    TestLib::TestCase scratch;
+    TestLib::run_as(scratch, [] {
+        const std::vector<KeyWithCache> a {{1, 10}, {2, 20}, {3, 30}};
+        const std::vector<KeyWithCache> b {{1, 0}, {2, 0}, {3, 0}};
+        EXPECT_EQ(a, b);
+        EXPECT_EQ(std::span(a), std::span(b));
+    });
+    EXPECT_FALSE(scratch.m_test_result.m_is_failed);
+    EXPECT_EQ(scratch.m_test_result.m_failures.size(), size_t(0));
+}
+
+TEST(psi_mock, detail_find_first_difference)
+{
+    std::vector<char> a(10000, 'x');
+    std::vector<char> b(10000, 'x');
+    EXPECT_EQ(detail::find_first_difference(a.data(), b.data(), a.size()), a.size());
+    b[8193] = 'y';
+    EXPECT_EQ(detail::find_first_difference(a.data(), b.data(), a.size()), 8193u);
+    EXPECT_EQ(detail::bytes_to_hex("\x01\xab", 2), std::string("01ab"));
+    EXPECT_EQ(detail::to_printable(std::string("s")), std::string("\"s\""));
+}
+
 TEST(psi_mock, EXPECT_EQ_map_equal)
 {
     std::map<int, int> a {{1, 10}, {2, 20}};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "psi/test/psi_mock.h"
+#include "psi/test/psi_profile.h"
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <sstream>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace psi::test {
+
+TEST(SamplingProfiler, tags_samples_with_the_running_test)
+{
+    if (!SamplingProfiler::supported() || SamplingProfiler::running()) {
+        return;
+    }
+    ASSERT_TRUE(SamplingProfiler::start(2000));
+    volatile uint64_t x = 0;
+    const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+    while (std::chrono::steady_clock::now() < end) {
+        x = x + 1;
+    }
+    SamplingProfiler::stop();
+    EXPECT_FALSE(SamplingProfiler::running());
+
+#if defined(_WIN32)
+    const auto pid = ::_getpid();
+#else
+    const auto pid = ::getpid();
+#endif
+    const auto path =
+        (std::filesystem::temp_directory_path() / std::format("psi_profile_tests.{}.folded", pid)).string();
+    ASSERT_TRUE(SamplingProfiler::write(path));
+    std::ifstream in(path);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    std::filesystem::remove(path);
+    EXPECT_CONTAINS(contents.str(), "# SamplingProfiler.tags_samples_with_the_running_test: ");
+    EXPECT_CONTAINS(contents.str(), "\nSamplingProfiler.tags_samples_with_the_running_test;");
+    EXPECT_EQ(SamplingProfiler::sample_count(), 0u);
+}
+
+} // namespace psi::test
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "psi/test/psi_mock.h"
+#include "psi/test/psi_search.h"
+
+#include <random>
+#include <string>
+
+namespace psi::test {
+
+TEST(psi_search, find_substring_agrees_with_find)
+{
+    std::mt19937 rng(7);
+    for (int round = 0; round < 2000; ++round) {
+        std::string haystack(rng() % 80, 'a');
+        for (auto &c : haystack) {
+            c = static_cast<char>('a' + rng() % 3);
+        }
+        std::string needle(1 + rng() % 5, 'a');
+        for (auto &c : needle) {
+            c = static_cast<char>('a' + rng() % 3);
+        }
+        EXPECT_EQ(find_substring(haystack, needle), haystack.find(needle));
+    }
+    EXPECT_EQ(find_substring("abc", ""), size_t(0));
+    EXPECT_EQ(find_substring("ab", "abc"), std::string_view::npos);
+}
+
+TEST(psi_search, regex_syntax)
+{
+    EXPECT_TRUE(Regex("wor").search("hello world"));
+    EXPECT_TRUE(Regex("^hel+o\\s+w.r").search("hello world"));
+    EXPECT_FALSE(Regex("^world").search("hello world"));
+    EXPECT_TRUE(Regex("(?:cat|dog)s?$").search("hot dogs"));
+    EXPECT_TRUE(Regex("id=[0-9a-f]{4,8}\\b").search("id=00ff12 ok"));
+    EXPECT_FALSE(Regex("id=[0-9a-f]{4,8}\\b").search("id=00ff12345 ok"));
+    EXPECT_TRUE(Regex("[^\\d]+\\.$").search("done."));
+    EXPECT_TRUE(Regex("x*").search(""));
+    EXPECT_FALSE(Regex("a(b").valid());
+    EXPECT_FALSE(Regex("*a").valid());
+    EXPECT_FALSE(Regex("a{3,1}").valid());
+}
+
+TEST(psi_search, regex_is_linear)
+{
+    // Exponential for a backtracking engine.
+    const std::string text(20000, 'a');
+    EXPECT_FALSE(Regex::cached("(a*)*b").search(text));
+    EXPECT_TRUE(Regex::cached("(a|aa)+$").search(text));
+    EXPECT_TRUE(&Regex::cached("(a*)*b") == &Regex::cached("(a*)*b"));
+}
+
+TEST(psi_search, EXPECT_MATCHES_REGEX_and_WithArgMatches)
+{
+    EXPECT_MATCHES_REGEX(std::string("2024-01-31 INFO started"), "^\\d{4}-\\d\\d-\\d\\d (INFO|WARN) ");
+
+    auto mock = MockedFn<std::function<void(std::string)>>::create();
+    EXPECT_CALL(mock, 2).WithArgMatches(0, "^user-[0-9]+$").WithArgContains(0, "user");
+    mock->fn()("user-1");
+    mock->fn()("user-42");
+}
+
+TEST(psi_search, failures_quote_an_excerpt_of_long_text)
+{
+    const auto text = "head-" + std::string(100000, 'x') + "-tail";
+    TestLib::TestCase scratch;
+    TestLib::run_as(scratch, [&text] {
+        EXPECT_MATCHES_REGEX(text, "^nothing");
+        EXPECT_CONTAINS(text, "nothing");
+        auto mock = MockedFn<std::function<void(std::string)>>::create();
+        EXPECT_CALL(mock, 1).WithArgMatches(0, "^nothing").WithArgContains(0, "nothing");
+        mock->fn()(text);
+        TestLib::verify_and_clear_expectations();
+    });
+
+    const auto &failures = scratch.m_test_result.m_failures;
+    ASSERT_EQ(failures.size(), size_t(4));
+    for (const auto &failure : failures) {
+        const std::string_view message = failure.m_message;
+        EXPECT_CONTAINS(message, "\"head-xxx");
+        EXPECT_CONTAINS(message, "xxx-tail\" (100010 bytes)");
+        EXPECT_TRUE(message.size() < 2 * detail::kMaxExcerptBytes);
+    }
+    EXPECT_EQ(detail::quote_excerpt("short"), "\"short\"");
+}
+
+} // namespace psi::test
@@ -0,0 +1,248 @@
+// Measures what psi-test itself costs: registration, filtering, the per-test runner overhead on synthetic
+// suites, and the hot operations used inside test bodies. Prints one JSON document with ns per operation.
+//
+//   PSI_BENCH_psi_test [--sizes=1000,10000,100000] [--repetitions=3]
+
+#include "psi/test/psi_mock.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <span>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace psi::test {
+
+namespace {
+
+constexpr int kAssertionsPerTest = 100;
+constexpr int kMockCallsPerTest = 10;
+constexpr size_t kTestsPerGroup = 100;
+constexpr int kMicroOps = 1000000;
+
+enum class SuiteKind { empty, assertions, mocks };
+
+std::string_view kind_name(SuiteKind kind)
+{
+    switch (kind) {
+    case SuiteKind::empty:
+        return "empty";
+    case SuiteKind::assertions:
+        return "assertion_heavy";
+    case SuiteKind::mocks:
+        return "mock_heavy";
+    }
+    return {};
+}
+
+// Keeps the compiler from folding EXPECT_EQ(i, i) away.
+volatile int s_zero = 0;
+
+int opaque(int v)
+{
+    return v + s_zero;
+}
+
+void empty_body() {}
+
+void assertion_body()
+{
+    for (int i = 0; i < kAssertionsPerTest; ++i) {
+        EXPECT_EQ(opaque(i), i);
+    }
+}
+
+void mock_body()
+{
+    auto mock = MockedFn<std::function<int(int)>>::create();
+    EXPECT_CALL(mock, kMockCallsPerTest);
+    const auto fn = mock->fn();
+    for (int i = 0; i < kMockCallsPerTest; ++i) {
+        fn(i);
+    }
+}
+
+/// Swallows the runner's console output, so the run is measured without the terminal.
+class NullBuffer : public std::streambuf
+{
+protected:
+    int overflow(int c) override
+    {
+        return c;
+    }
+    std::streamsize xsputn(const char *, std::streamsize n) override
+    {
+        return n;
+    }
+};
+
+double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+    return static_cast<double>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+struct Measurement {
+    std::string m_name;
+    std::string m_suite;
+    size_t m_tests = 0;
+    double m_ns_per_op = 0.0;
+};
+
+} // namespace
+
+/// Friend of TestLib, for the private filtering and expectation entry points.
+struct SelfBenchmark {
+    /// Registers, filters and runs `tests` synthetic tests of `kind`; best of `repetitions`.
+    static void bench_suite(SuiteKind kind, size_t tests, int repetitions, std::vector<Measurement> &out)
+    {
+        const auto group = [&](size_t i) { return std::format("SelfBench_{}_{}", kind_name(kind), i); };
+        // Two whole groups and two single tests, as in --gtest_filter=A.*:B.*:C.x:D.y
+        const auto pattern_filter = std::format("{}.*:{}.*:{}.test_{}:{}.test_{}", group(0), group(1),
+                                                group(3), 3 * kTestsPerGroup, group(7), 7 * kTestsPerGroup + 1);
+
+        std::vector<TestLib::TestCase> cases;
+        cases.reserve(tests);
+        auto *body = kind == SuiteKind::empty ? &empty_body
+                     : kind == SuiteKind::assertions ? &assertion_body
+                                                     : &mock_body;
+        for (size_t i = 0; i < tests; ++i) {
+            cases.push_back({group(i / kTestsPerGroup), std::format("test_{}", i), body, {}});
+        }
+
+        double add_ns = 1e300;
+        double filter_ns = 1e300;
+        double pattern_filter_ns = 1e300;
+        double run_ns = 1e300;
+        for (int r = 0; r < repetitions; ++r) {
+            TestLib::destroy();
+            auto start = std::chrono::steady_clock::now();
+            for (const auto &tc : cases) {
+                TestLib::add_test(tc);
+            }
+            add_ns = std::min(add_ns, elapsed_ns(start));
+
+            start = std::chrono::steady_clock::now();
+            const auto filtered = TestLib::get_filtered_tests("*");
+            filter_ns = std::min(filter_ns, elapsed_ns(start));
+            if (filtered.m_total_tests_number != tests) {
+                std::cerr << "[PSI-TEST] filter selected " << filtered.m_total_tests_number << " of " << tests
+                          << " tests" << std::endl;
+                std::exit(1);
+            }
+            start = std::chrono::steady_clock::now();
+            TestLib::get_filtered_tests(pattern_filter);
+            pattern_filter_ns = std::min(pattern_filter_ns, elapsed_ns(start));
+
+            NullBuffer null;
+            auto *const saved = std::cout.rdbuf(&null);
+            start = std::chrono::steady_clock::now();
+            const int failed = TestLib::run(TestLib::CmdOptions {.filter = "*", .color = false});
+            run_ns = std::min(run_ns, elapsed_ns(start));
+            std::cout.rdbuf(saved);
+            if (failed != 0) {
+                std::cerr << "[PSI-TEST] synthetic suite failed" << std::endl;
+                std::exit(1);
+            }
+        }
+        TestLib::destroy();
+
+        const auto suite = std::string(kind_name(kind));
+        const auto n = static_cast<double>(tests);
+        out.push_back({"add_test", suite, tests, add_ns / n});
+        out.push_back({"get_filtered_tests", suite, tests, filter_ns / n});
+        out.push_back({"get_filtered_tests_patterns", suite, tests, pattern_filter_ns / n});
+        out.push_back({"run_per_test", suite, tests, run_ns / n});
+    }
+
+    /// Operations used inside test bodies, timed inside a running test.
+    static void bench_operations(std::vector<Measurement> &out)
+    {
+        TestLib::TestCase tc {"SelfBench", "operations", &empty_body, {}};
+        TestLib::m_current_running_test = &tc;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kMicroOps; ++i) {
+            EXPECT_EQ(opaque(i), i);
+        }
+        out.push_back({"passing_assertion", {}, 0, elapsed_ns(start) / kMicroOps});
+
+        auto called = MockedFn<std::function<int(int)>>::create();
+        const auto fn = called->fn();
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kMicroOps; ++i) {
+            fn(i);
+        }
+        out.push_back({"mocked_fn_call", {}, 0, elapsed_ns(start) / kMicroOps});
+
+        auto idle = MockedFn<std::function<int(int)>>::create();
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kMicroOps; ++i) {
+            EXPECT_CALL(idle, 0);
+        }
+        out.push_back({"expect_call_setup", {}, 0, elapsed_ns(start) / kMicroOps});
+
+        start = std::chrono::steady_clock::now();
+        TestLib::verify_expectations(tc);
+        out.push_back({"expectation_verify", {}, 0, elapsed_ns(start) / kMicroOps});
+
+        TestLib::m_current_running_test = nullptr;
+        if (tc.m_test_result.m_is_failed) {
+            std::cerr << "[PSI-TEST] operation benchmark failed" << std::endl;
+            std::exit(1);
+        }
+        tc.m_fn_expectations.clear();
+    }
+};
+
+} // namespace psi::test
+
+int main(int argc, char *argv[])
+{
+    using namespace psi::test;
+
+    std::vector<size_t> sizes {1000, 10000, 100000};
+    int repetitions = 3;
+    for (const std::string_view arg : std::span<char *>(argv, static_cast<size_t>(argc)).subspan(1)) {
+        if (arg.starts_with("--sizes=")) {
+            sizes.clear();
+            for (size_t pos = 8; pos < arg.size();) {
+                const size_t comma = std::min(arg.find(',', pos), arg.size());
+                sizes.push_back(std::strtoull(std::string(arg.substr(pos, comma - pos)).c_str(), nullptr, 10));
+                pos = comma + 1;
+            }
+        } else if (arg.starts_with("--repetitions=")) {
+            repetitions = std::max(1, std::atoi(std::string(arg.substr(14)).c_str()));
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--sizes=1000,10000,100000] [--repetitions=3]" << std::endl;
+            return 1;
+        }
+    }
+
+    TestLib::init();
+    std::vector<Measurement> results;
+    for (const auto kind : {SuiteKind::empty, SuiteKind::assertions, SuiteKind::mocks}) {
+        for (const auto tests : sizes) {
+            SelfBenchmark::bench_suite(kind, tests, repetitions, results);
+        }
+    }
+    SelfBenchmark::bench_operations(results);
+    TestLib::destroy();
+
+    std::cout << "{\n  \"unit\": \"ns/op\",\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto &m = results[i];
+        std::cout << (i == 0 ? "\n" : ",\n") << std::format("    {{\"name\": \"{}\", ", m.m_name);
+        if (!m.m_suite.empty()) {
+            std::cout << std::format("\"suite\": \"{}\", \"tests\": {}, ", m.m_suite, m.m_tests);
+        }
+        std::cout << std::format("\"ns_per_op\": {:.3f}}}", m.m_ns_per_op);
+    }
+    std::cout << "\n  ]\n}" << std::endl;
+    return 0;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "psi/test/psi_mock.h"
+#include "psi/test/psi_serve.h"
+#include "psi_fork.h"
+
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace psi::test {
+
+#if !defined(_WIN32)
+
+/// Sends one request the way --psi_connect does and returns everything the server wrote until it closed the
+/// connection; a server that keeps the connection open fails the read after 10 s instead of hanging the run.
+static std::string serve_request(const std::string &path, const std::vector<std::string> &args)
+{
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    path.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+    int fd = -1;
+    for (int attempt = 0; attempt < 500; ++attempt) {
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (::connect(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) == 0) {
+            break;
+        }
+        ::close(fd);
+        fd = -1;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (fd < 0) {
+        return "cannot connect";
+    }
+    timeval timeout {10, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    std::string request;
+    for (const auto &arg : args) {
+        request += arg + "\n";
+    }
+    request += "\n";
+    static_cast<void>(::write(fd, request.data(), request.size()));
+
+    std::string response;
+    char buf[4096];
+    for (ssize_t n; (n = ::read(fd, buf, sizeof(buf))) != 0;) {
+        if (n < 0) {
+            response += "\n<read timed out>";
+            break;
+        }
+        response.append(buf, static_cast<size_t>(n));
+    }
+    ::close(fd);
+    return response;
+}
+
+TEST(TestServer, serves_consecutive_requests_and_rejects_mode_flags)
+{
+    const auto dir = std::filesystem::temp_directory_path() / std::format("psi_serve_tests.{}", ::getpid());
+    std::filesystem::create_directories(dir);
+    const auto socket = (dir / "server.sock").string();
+    const auto log = (dir / "server.log").string();
+
+    // Each would turn the server into something else, or exit it, if it were honored.
+    const std::vector<std::string> kModeFlags {"--psi_worker=127.0.0.1:1",
+                                               "--psi_coordinator=127.0.0.1:0",
+                                               "--psi_spawn_workers=2",
+                                               "--psi_serve=unix:" + (dir / "other.sock").string(),
+                                               "--psi_connect=unix:" + socket,
+                                               "--help"};
+
+    // The server runs the registered tests through TestLib::run, which must not happen inside this test's
+    // own run: it gets a forked copy of the process.
+    const auto server = fork_logged(log, [&]() {
+        TestServer::serve("unix:" + socket, 2 + kModeFlags.size());
+        return 0;
+    });
+    ASSERT_TRUE(server > 0);
+
+    const std::vector<std::string> filter {"--gtest_filter=BenchEnvironment.parse_cpu_list", "--gtest_color=no"};
+    auto captured = filter;
+    captured.push_back("--psi_capture_output");
+    const auto first = serve_request(socket, captured);
+    const auto second = serve_request(socket, filter);
+    std::vector<std::string> rejected;
+    for (const auto &flag : kModeFlags) {
+        auto with_flag = filter;
+        with_flag.push_back(flag);
+        rejected.push_back(serve_request(socket, with_flag));
+    }
+    std::string server_log;
+    const int status = wait_logged(server, log, server_log);
+    std::filesystem::remove_all(dir);
+
+    for (const auto &response : {first, second}) {
+        EXPECT_CONTAINS(response, "[  PASSED  ] 1 test.");
+        EXPECT_CONTAINS(response, "[PSI-SERVE] exit 0\n");
+        EXPECT_TRUE(response.find("<read timed out>") == std::string::npos);
+    }
+    EXPECT_CONTAINS(server_log, "[PSI-SERVE] request --gtest_filter=BenchEnvironment.parse_cpu_list "
+                                      "--gtest_color=no --psi_capture_output -> exit 0");
+    EXPECT_CONTAINS(server_log, "[PSI-SERVE] request --gtest_filter=BenchEnvironment.parse_cpu_list "
+                                      "--gtest_color=no -> exit 0");
+    for (size_t i = 0; i < kModeFlags.size(); ++i) {
+        EXPECT_CONTAINS(rejected[i], kModeFlags[i] + " cannot be sent to a --psi_serve process\n");
+        EXPECT_CONTAINS(rejected[i], "[PSI-SERVE] exit 1\n");
+        EXPECT_TRUE(rejected[i].find("[==========]") == std::string::npos);
+    }
+    EXPECT_TRUE(status >= 0 && WIFEXITED(status));
+}
+
+#endif
+
+} // namespace psi::test
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "psi/test/psi_capture.h"
+#include "psi/test/psi_mock.h"
+#include "psi/test/psi_stress.h"
+
+#include <atomic>
+#include <format>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace psi::test {
+
+static std::atomic<uint64_t> s_stress_counter {0};
+
+STRESS_TEST(StressTest, atomic_counter_under_yields, 4, 200)
+{
+    const auto before = s_stress_counter.fetch_add(1);
+    PSI_YIELD_POINT();
+    EXPECT_TRUE(s_stress_counter.load() > before);
+    EXPECT_LE(ctx.m_thread_index, ctx.m_threads - 1);
+}
+
+TEST(StressTest, runs_all_iterations_on_all_threads)
+{
+    static std::atomic<uint64_t> calls {0};
+    calls = 0;
+    const auto ran = StressRunner::run(3, 50, [](const StressContext &ctx) {
+        static std::mutex mutex;
+        std::lock_guard lock(mutex);
+        PSI_YIELD_POINT();
+        calls += ctx.m_iteration < 50 ? 1 : 0;
+    });
+    EXPECT_EQ(ran, uint64_t(50));
+    EXPECT_EQ(calls.load(), uint64_t(150));
+}
+
+/// Runs body on one thread with scratch as the running test, so that its failures are recorded there quietly.
+/// Returns the iterations run and the runner's report, which is empty under --psi_capture_output: the report
+/// then bypasses std::cout.
+static std::pair<uint64_t, std::string> run_scratch_stress(TestLib::TestCase &scratch,
+                                                           uint64_t iterations,
+                                                           StressRunner::Body body)
+{
+    std::ostringstream report;
+    auto *const cout_buf = std::cout.rdbuf(report.rdbuf());
+    uint64_t ran = 0;
+    TestLib::run_as(scratch, [&]() { ran = StressRunner::run(1, iterations, body); });
+    std::cout.rdbuf(cout_buf);
+    return {ran, report.str()};
+}
+
+TEST(StressTest, stops_at_first_failure_after_earlier_ones)
+{
+    TestLib::TestCase scratch;
+    TestLib::run_as(scratch, []() { EXPECT_TRUE(false); });
+    ASSERT_TRUE(scratch.m_test_result.m_is_failed);
+
+    const auto [ran, report] =
+        run_scratch_stress(scratch, 10, [](const StressContext &ctx) { EXPECT_TRUE(ctx.m_iteration != 3); });
+    EXPECT_EQ(ran, uint64_t(4));
+    EXPECT_EQ(scratch.m_test_result.m_failures.size(), size_t(2));
+    if (!OutputCapture::active()) {
+        EXPECT_CONTAINS(report, "[  STRESS  ] first failure in iteration 3, seed 0x");
+        EXPECT_CONTAINS(report, "[  STRESS  ] 4 iterations on 1 thread in ");
+    }
+}
+
+TEST(StressTest, replay_seed_repeats_the_reported_seed)
+{
+    static std::vector<uint64_t> s_seeds;
+    s_seeds.clear();
+    const auto previous = StressRunner::replay_seed();
+    StressRunner::set_replay_seed(0);
+    TestLib::TestCase failing;
+    const auto [ran, report] = run_scratch_stress(failing, 10, [](const StressContext &ctx) {
+        s_seeds.push_back(ctx.m_seed);
+        EXPECT_TRUE(ctx.m_iteration < 2);
+    });
+    ASSERT_EQ(s_seeds.size(), size_t(3));
+    EXPECT_EQ(ran, uint64_t(3));
+    EXPECT_TRUE(s_seeds[0] != s_seeds[1]);
+    const auto seed = s_seeds.back();
+    if (!OutputCapture::active()) {
+        EXPECT_CONTAINS(report, std::format("seed {:#x} (replay with --psi_stress_seed={:#x})", seed, seed));
+    }
+
+    // What --psi_stress_seed does: every iteration runs with the reported seed.
+    std::vector<char *> argv {const_cast<char *>("psi"), nullptr};
+    auto seed_arg = std::format("--psi_stress_seed={:#x}", seed);
+    argv[1] = seed_arg.data();
+    EXPECT_EQ(TestLib::parse_args(argv).stress_seed, seed);
+    StressRunner::set_replay_seed(seed);
+    s_seeds.clear();
+    TestLib::TestCase replay;
+    const auto replayed =
+        run_scratch_stress(replay, 5, [](const StressContext &ctx) { s_seeds.push_back(ctx.m_seed); });
+    StressRunner::set_replay_seed(previous);
+    EXPECT_EQ(replayed.first, uint64_t(5));
+    EXPECT_EQ(s_seeds, std::vector<uint64_t>(5, seed));
+    EXPECT_FALSE(replay.m_test_result.m_is_failed);
+}
+
+} // namespace psi::test
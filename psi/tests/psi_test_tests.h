@@ -1,8 +1,12 @@
 
 #pragma once
 
+#include "psi/test/psi_mock.h"
 #include "psi/test/psi_test.h"
 
+#include <fstream>
+#include <string>
+
 namespace psi::test {
 
 TEST(MockedFn, create_not_null)
@@ -42,4 +46,133 @@ TEST(TestLib, fn_expectations_not_null)
     EXPECT_NE(TestLib::fn_expectations(), nullptr);
 }
 
+TEST(TestLib, parse_max_failures_per_test)
+{
+    char program[] = "tests";
+    char flag[] = "--psi_max_failures_per_test=25";
+    char *argv[] = {program, flag};
+    EXPECT_EQ(TestLib::parse_args(argv).max_failures_per_test, size_t(25));
+}
+
+TEST(TestLib, parse_connect_forwards_other_args)
+{
+    char program[] = "tests";
+    char filter[] = "--gtest_filter=Parser.*";
+    char connect[] = "--psi_connect=unix:/tmp/psi.sock";
+    char color[] = "--gtest_color=no";
+    char *argv[] = {program, filter, connect, color};
+    const auto opts = TestLib::parse_args(argv);
+    EXPECT_EQ(opts.connect, std::string("unix:/tmp/psi.sock"));
+    EXPECT_EQ(opts.connect_args, std::vector<std::string> {"--gtest_filter=Parser.*", "--gtest_color=no"});
+}
+
+TEST(TestLib, parse_coordinator_forwards_worker_args)
+{
+    char program[] = "tests";
+    char coordinator[] = "--psi_coordinator=0.0.0.0:7000";
+    char spawn[] = "--psi_spawn_workers=4";
+    char capture[] = "--psi_capture_output";
+    char *argv[] = {program, coordinator, spawn, capture};
+    const auto opts = TestLib::parse_args(argv);
+    EXPECT_EQ(opts.coordinator, std::string("0.0.0.0:7000"));
+    EXPECT_EQ(opts.spawn_workers, size_t(4));
+    EXPECT_EQ(opts.worker_args, std::vector<std::string> {"--psi_capture_output"});
+}
+
+TEST(FailureArena, keeps_stored_strings)
+{
+    detail::FailureArena arena;
+    const std::string large(100 * 1024, 'x');
+    std::vector<std::string_view> views;
+    for (int i = 0; i < 10000; ++i) {
+        views.push_back(arena.store("failure " + std::to_string(i)));
+    }
+    const auto large_view = arena.store(large);
+    views.push_back(arena.store("after"));
+
+    EXPECT_EQ(views[0], "failure 0");
+    EXPECT_EQ(views[9999], "failure 9999");
+    EXPECT_EQ(views.back(), "after");
+    EXPECT_EQ(large_view.size(), large.size());
+    EXPECT_TRUE(arena.store({}).empty());
+}
+
+TEST(TestFailure, records_location_expression_and_values)
+{
+    TestLib::TestCase scratch;
+    const int answer = 41;
+    int line = 0;
+    bool after_assert = false;
+    TestLib::run_as(scratch, [&] {
+        // Two calls on one line: the column tells them apart.
+        line = __LINE__; EXPECT_EQ(answer, 40); EXPECT_EQ(answer + 1, 43);
+        ASSERT_EQ(answer, 0);
+        after_assert = true;
+    });
+
+    const auto &result = scratch.m_test_result;
+    EXPECT_TRUE(result.m_is_failed);
+    EXPECT_FALSE(after_assert);
+    ASSERT_EQ(result.m_failures.size(), size_t(3));
+    const auto &first = result.m_failures[0];
+    EXPECT_TRUE(first.m_file.ends_with("psi_test_tests.h"));
+    EXPECT_EQ(first.m_line, line);
+    // The source is read through the path the compiler recorded; from elsewhere only the name is known.
+    const bool source_readable = static_cast<bool>(std::ifstream(std::string(first.m_file)));
+    EXPECT_EQ(first.m_expression, source_readable ? "EXPECT_EQ(answer, 40)" : "EXPECT_EQ");
+    EXPECT_EQ(first.m_actual, "41");
+    EXPECT_EQ(first.m_expected, "40");
+    EXPECT_EQ(result.m_failures[1].m_line, line);
+    EXPECT_EQ(result.m_failures[1].m_expression, source_readable ? "EXPECT_EQ(answer + 1, 43)" : "EXPECT_EQ");
+    EXPECT_EQ(result.m_failures[1].m_actual, "42");
+    EXPECT_EQ(result.m_failures[2].m_line, line + 1);
+    EXPECT_EQ(result.m_failures[2].m_expression, source_readable ? "ASSERT_EQ(answer, 0)" : "ASSERT_EQ");
+    EXPECT_EQ(result.m_failures[2].m_expected, "0");
+}
+
+TEST(TestFailure, wide_strings_are_recorded_as_utf8)
+{
+    EXPECT_EQ(detail::to_utf8(L"caf\u00e9 \U0001F600"), std::string("caf\xc3\xa9 \xf0\x9f\x98\x80"));
+
+    TestLib::TestCase scratch;
+    int line = 0;
+    bool after_assert = false;
+    TestLib::run_as(scratch, [&] {
+        line = __LINE__; EXPECT_EQ(std::wstring(L"caf\u00e9"), std::wstring(L"cafe"));
+        ASSERT_EQ(std::wstring(L"a"), L"b");
+        after_assert = true;
+    });
+
+    const auto &result = scratch.m_test_result;
+    EXPECT_FALSE(after_assert);
+    ASSERT_EQ(result.m_failures.size(), size_t(2));
+    const auto &first = result.m_failures[0];
+    EXPECT_TRUE(first.m_file.ends_with("psi_test_tests.h"));
+    EXPECT_EQ(first.m_line, line);
+    EXPECT_TRUE(first.m_expression.starts_with("EXPECT_EQ"));
+    EXPECT_EQ(first.m_actual, "caf\xc3\xa9");
+    EXPECT_EQ(first.m_expected, "cafe");
+    EXPECT_EQ(result.m_failures[1].m_line, line + 1);
+    EXPECT_EQ(result.m_failures[1].m_actual, "a");
+}
+
+TEST(TestFailure, max_failures_per_test_counts_the_rest)
+{
+    const auto previous = TestLib::max_failures_per_test();
+    TestLib::set_max_failures_per_test(3);
+    TestLib::TestCase scratch;
+    TestLib::run_as(scratch, [] {
+        for (int i = 0; i < 10; ++i) {
+            EXPECT_EQ(i, -1);
+        }
+    });
+    TestLib::set_max_failures_per_test(previous);
+
+    const auto &result = scratch.m_test_result;
+    EXPECT_TRUE(result.m_is_failed);
+    ASSERT_EQ(result.m_failures.size(), size_t(3));
+    EXPECT_EQ(result.m_suppressed_failures, size_t(7));
+    EXPECT_EQ(result.m_failures[2].m_actual, "2");
+}
+
 } // namespace psi::test
@@ -1,2 +1,20 @@
+#include "psi_async_tests.h"
+#include "psi_bench_tests.h"
+#include "psi_cache_tests.h"
+#include "psi_capture_tests.h"
+#include "psi_clock_tests.h"
+#include "psi_constexpr_tests.h"
+#include "psi_diff_tests.h"
+#include "psi_distributed_tests.h"
+#include "psi_float_tests.h"
+#include "psi_golden_tests.h"
+#include "psi_histogram_tests.h"
+#include "psi_memory_tests.h"
 #include "psi_mock_tests.h"
+#include "psi_profile_tests.h"
+#include "psi_search_tests.h"
+#include "psi_serve_tests.h"
+#include "psi_stress_tests.h"
 #include "psi_test_tests.h"
+#include "psi_trace_tests.h"
+#include "psi_zone_tests.h"
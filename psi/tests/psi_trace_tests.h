@@ -0,0 +1,131 @@
+#pragma once
+
+#include "psi/test/psi_mock.h"
+#include "psi/test/psi_trace.h"
+
+#include <atomic>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace psi::test {
+
+TEST(TraceRecorder, now_ns_is_monotonic)
+{
+    const auto t1 = TraceRecorder::now_ns();
+    const auto t2 = TraceRecorder::now_ns();
+    EXPECT_LE(t1, t2);
+}
+
+static size_t count_events(const std::string &events, std::string_view name)
+{
+    const auto needle = std::format(R"({{"name": "{}", )", name);
+    size_t count = 0;
+    for (auto pos = events.find(needle); pos != std::string::npos; pos = events.find(needle, pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+TEST(TraceRecorder, scope_records_only_when_enabled)
+{
+    // Under --psi_trace the run's own events are set aside and handed back for its trace.
+    const bool was_enabled = TraceRecorder::enabled();
+    const auto earlier = TraceRecorder::take_events();
+    TraceRecorder::disable();
+    {
+        TraceRecorder::Scope scope("test", "disabled_scope");
+    }
+    const auto while_disabled = TraceRecorder::take_events();
+    TraceRecorder::enable();
+    {
+        TraceRecorder::Scope scope("test", "enabled_scope");
+    }
+    const auto while_enabled = TraceRecorder::take_events();
+    if (!was_enabled) {
+        TraceRecorder::disable();
+    }
+    TraceRecorder::add_events(earlier);
+
+    EXPECT_EQ(count_events(while_disabled, "disabled_scope"), 0u);
+    EXPECT_EQ(count_events(while_enabled, "disabled_scope"), 0u);
+    EXPECT_EQ(count_events(while_enabled, "enabled_scope"), 1u);
+}
+
+TEST(TraceRecorder, take_events_while_other_threads_record)
+{
+    constexpr size_t kEvents = 20000;
+    const bool was_enabled = TraceRecorder::enabled();
+    const auto earlier = TraceRecorder::take_events();
+    TraceRecorder::enable();
+    std::atomic<bool> done {false};
+    std::thread recorder([&done]() {
+        for (size_t i = 0; i < kEvents; ++i) {
+            TraceRecorder::record("test", "concurrent_event", {}, 0, 1);
+        }
+        done.store(true);
+    });
+    // The recorder keeps appending to its buffer while it is drained; the exited thread's buffer is freed.
+    std::string taken;
+    while (!done.load()) {
+        taken += TraceRecorder::take_events();
+    }
+    recorder.join();
+    taken += TraceRecorder::take_events();
+    if (!was_enabled) {
+        TraceRecorder::disable();
+    }
+    TraceRecorder::add_events(earlier);
+
+    EXPECT_EQ(count_events(taken, "concurrent_event"), kEvents);
+}
+
+TEST(TraceRecorder, write_emits_complete_events_with_pid_and_tid)
+{
+#ifdef _WIN32
+    const auto pid = ::_getpid();
+#else
+    const auto pid = ::getpid();
+#endif
+    // Under --psi_trace the run's own events are set aside and handed back for its trace.
+    const bool was_enabled = TraceRecorder::enabled();
+    const auto earlier = TraceRecorder::take_events();
+    const auto path = (std::filesystem::temp_directory_path() / std::format("psi_trace_tests.{}.json", pid)).string();
+
+    TraceRecorder::enable();
+    {
+        TraceRecorder::Scope scope("test", "recorded_scope", "suffix");
+    }
+    const bool written = TraceRecorder::write(path);
+    if (!was_enabled) {
+        TraceRecorder::disable();
+    }
+    TraceRecorder::add_events(earlier);
+    std::stringstream json;
+    json << std::ifstream(path).rdbuf();
+    std::filesystem::remove(path);
+
+    ASSERT_TRUE(written);
+    EXPECT_EQ(TraceRecorder::enabled(), was_enabled);
+    const auto text = json.str();
+    const auto event = text.find(R"({"name": "recorded_scope.suffix", "cat": "test", "ph": "X", "ts": )");
+    ASSERT_TRUE(event != std::string::npos);
+    const auto line = text.substr(event, text.find('\n', event) - event);
+    const auto pid_tid = std::format(R"("pid": {}, "tid": )", pid);
+    EXPECT_CONTAINS(line, pid_tid);
+    ASSERT_TRUE(line.find(pid_tid) != std::string::npos);
+    const auto tid = std::stoi(line.substr(line.find(pid_tid) + pid_tid.size()));
+    EXPECT_TRUE(tid >= 1);
+    // The thread that recorded it is named by a metadata event.
+    EXPECT_CONTAINS(text, std::format(R"({{"name": "thread_name", "ph": "M", "pid": {}, "tid": {}, )", pid, tid));
+}
+
+} // namespace psi::test
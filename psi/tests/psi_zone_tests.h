@@ -0,0 +1,64 @@
+#pragma once
+
+#include "psi/test/TestHelper.h"
+#include "psi/test/psi_mock.h"
+#include "psi/test/psi_zone.h"
+
+#include <thread>
+
+namespace psi::test {
+
+static int zoned_work(int n)
+{
+    PSI_ZONE("zoned_work");
+    int sum = 0;
+    for (int i = 0; i < n; ++i) {
+        sum += i;
+    }
+    return sum;
+}
+
+TEST(ZoneProfiler, aggregates_zone_calls)
+{
+    ZoneProfiler::reset();
+    for (int i = 0; i < 100; ++i) {
+        zoned_work(i);
+    }
+    const auto report = ZoneProfiler::snapshot();
+#ifdef PSI_ENABLE_ZONES
+    ASSERT_EQ(report.count("zoned_work"), 1u);
+    EXPECT_EQ(report.at("zoned_work").m_count, 100u);
+    EXPECT_LE(report.at("zoned_work").m_max_ns, report.at("zoned_work").m_total_ns);
+#else
+    EXPECT_TRUE(report.empty());
+#endif
+}
+
+TEST(ZoneProfiler, collects_other_threads)
+{
+    ZoneProfiler::reset();
+    std::thread worker([]() {
+        for (int i = 0; i < 20000; ++i) {
+            zoned_work(1);
+        }
+    });
+    worker.join();
+    const auto report = ZoneProfiler::snapshot();
+#ifdef PSI_ENABLE_ZONES
+    EXPECT_EQ(report.at("zoned_work").m_count + ZoneProfiler::dropped(), 20000u);
+#else
+    EXPECT_TRUE(report.empty());
+#endif
+}
+
+TEST(ZoneProfiler, delta_between_snapshots)
+{
+    ZoneReport before {{"a", {2, 20, 15}}};
+    ZoneReport after {{"a", {5, 50, 15}}, {"b", {1, 3, 3}}};
+    const auto d = ZoneProfiler::delta(after, before);
+    EXPECT_EQ(d.at("a").m_count, 3u);
+    EXPECT_EQ(d.at("a").m_total_ns, 30u);
+    EXPECT_EQ(d.at("b").m_count, 1u);
+}
+
+} // namespace psi::test